@@ -25,9 +25,10 @@
  * Recommended to create a vector of SensorUnit with at least 4 mPMTs.
  */
 
-static std::vector<SensorUnit> gSensors;   // grobal variable to hold sensor data
-static std::vector<SensorUnit> gPMTsUnits; // global variable to hold PMT units for fitting
-double chi2_1, chi2_2;                     // global variables to hold chi2 values for debugging
+// thread_local: several events are fitted in parallel (one TMinuit per worker, see main.cc)
+static thread_local const std::vector<SensorUnit> *gSensors = nullptr;   // grobal variable to hold sensor data
+static thread_local const std::vector<SensorUnit> *gPMTsUnits = nullptr; // global variable to hold PMT units for fitting
+thread_local double chi2_1, chi2_2;                                      // global variables to hold chi2 values for debugging
 
 static void FcnForMinuit_lightsource(Int_t &, Double_t *, Double_t &fval, Double_t *par, Int_t) {
     // par[0] = x, par[1] = y, par[2] = z, par[3] = t0
@@ -37,7 +38,7 @@ static void FcnForMinuit_lightsource(Int_t &, Double_t *, Double_t &fval, Double
     fval = 0.0;
     chi2_1 = 0.0;
     chi2_2 = 0.0;
-    for (const SensorUnit &s : gSensors) {
+    for (const SensorUnit &s : *gSensors) {
         double dx_x = par[0] - s.posx;
         double dx_y = par[1] - s.posy;
         double dx_z = par[2] - s.posz;
@@ -67,7 +68,7 @@ static void FcnForMinuit_lightsource(Int_t &, Double_t *, Double_t &fval, Double
         // fval += 2 * dir_chi2 + time_chi2; // total chi2
         chi2_1 += dir_chi2; // total chi2
     }
-    for (const SensorUnit &pmt : gPMTsUnits) {
+    for (const SensorUnit &pmt : *gPMTsUnits) {
         double dx_x = par[0] - pmt.posx;
         double dx_y = par[1] - pmt.posy;
         double dx_z = par[2] - pmt.posz;
@@ -85,15 +86,23 @@ static void FcnForMinuit_lightsource(Int_t &, Double_t *, Double_t &fval, Double
     //fval = chi2_2;
 }
 
+std::unique_ptr<TMinuit> CreateLightSourceMinuit() {
+    auto minuit = std::make_unique<TMinuit>(4);
+    minuit->SetFCN(FcnForMinuit_lightsource);
+    minuit->SetPrintLevel(-1);
+    return minuit;
+}
+
 void FitLightSource(const std::vector<SensorUnit> &sensors,
                     const std::vector<SensorUnit> &pmtunits,
+                    TMinuit &minuit,
                     TVector3 &fitted_pos,
                     double &fitted_time,
                     TVector3 &fiterr_pos,
                     double &fiterr_time,
                     double &chi2) {
-    gSensors = sensors;
-    gPMTsUnits = pmtunits;
+    gSensors = &sensors;
+    gPMTsUnits = &pmtunits;
     double last_hit_time = sensors[0].time;
     for (const auto &s : sensors) {
         if (s.time > last_hit_time) {
@@ -101,10 +110,8 @@ void FitLightSource(const std::vector<SensorUnit> &sensors,
         }
     }
 
-    TMinuit minuit(4);
-    minuit.SetFCN(FcnForMinuit_lightsource);
-    minuit.SetPrintLevel(-1);
-
+    // clear the parameters of the previous fit (the TMinuit itself is reused, not reallocated)
+    minuit.mncler();
     minuit.DefineParameter(0, "x", 0.0, 1, -350, 350);
     minuit.DefineParameter(1, "y", 0.0, 1, -400, 400);
     minuit.DefineParameter(2, "z", 0.0, 1, -350, 350);
@@ -128,5 +135,5 @@ void FitLightSource(const std::vector<SensorUnit> &sensors,
     minuit.mnstat(amin, edm, errdef, nvpar, nparx, istat);
     chi2 = amin;
 
-    std::cout << "dirchi2 = " << chi2_1 << " timechi2 = " << chi2_2 << " total chi2 = " << chi2 << std::endl;
+    // std::cout << "dirchi2 = " << chi2_1 << " timechi2 = " << chi2_2 << " total chi2 = " << chi2 << std::endl;
 }
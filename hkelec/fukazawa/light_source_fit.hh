@@ -2,22 +2,36 @@
 #ifndef LIGHT_SOURCE_FIT_HH
 #define LIGHT_SOURCE_FIT_HH
 
+#include "TMinuit.h"
 #include "TVector3.h"
 #include "fittinginput.hh"
+#include <memory>
 #include <vector>
 
+/**
+ * @brief create the TMinuit used by FitLightSource (FCN and print level are set here).
+ * Creating/deleting a TMinuit updates gMinuit and gROOT's list of specials, so create
+ * one per worker on the calling thread before starting the workers (see main.cc).
+ */
+std::unique_ptr<TMinuit> CreateLightSourceMinuit();
+
 /**
  * @brief function to fit the light source position and time using Minuit.
  * @param sensors parameters for the light source fitting (SensorUnit vector)
+ * @param pmtunits 8 cm PMTs used for the time chi2 (SensorUnit vector)
+ * @param minuit minimizer from CreateLightSourceMinuit (reset with mncler and reused for every fit)
  * @param fitted_pos fitted position of the light source (TVector3, in cm)
  * @param fitted_time fitted time of the light source (double, in ns)
  * @param fiterr_pos error of the fitted position (TVector3, in cm)
  * @param fiterr_time error of the fitted time (double, in ns)
  * @param chi2 chi-squared value of the fit (double)
  *
- * only sensors are input parameters.
+ * only sensors and pmtunits are input parameters.
+ * Thread-safe as long as each thread uses its own minuit (call ROOT::EnableThreadSafety() first).
  */
 void FitLightSource(const std::vector<SensorUnit> &sensors,
+                    const std::vector<SensorUnit> &pmtunits,
+                    TMinuit &minuit,
                     TVector3 &fitted_pos,
                     double &fitted_time,
                     TVector3 &fiterr_pos,
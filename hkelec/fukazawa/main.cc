@@ -1,4 +1,9 @@
 // main.cc
+// PMTTree の全イベント (eventNumber) について光源位置をフィットし、1イベント1行で CSV に書く。
+// ファイルは1回だけ開いて全イベントを読み (readData)、イベントごとのフィットは独立なので
+// -j のスレッドで並列に行う。結果は eventNumber 順に書き出す。
+//
+// usage: ./main [-i input (without .root)] [-o output.csv] [-j threads]
 #include "fittinginput.hh"
 #include "light_source_fit.cc"
 #include "light_source_fit.hh"
@@ -7,81 +12,81 @@
 #include "readData.cc"
 #include "readData.hh"
 #include <TFile.h>
+#include <TROOT.h>
 #include <TTree.h>
 #include <TVector3.h>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <fstream>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <random>
 #include <string>
+#include <thread>
+#include <unistd.h>
 #include <vector>
 // #include<bits/stdc++.h>
 
-void writeToCSV(const std::string &filename,
-                const TVector3 &fit,
-                double t_light,
-                const TVector3 &errors,
-                double t_error,
-                double chi2) {
-    std::ofstream ofs;
-    // append モード
-    ofs.open(filename, std::ios::out | std::ios::app);
-    if (!ofs.is_open()) {
-        std::cerr << "Cannot open " << filename << " for writing\n";
-        return;
-    }
-    // ヘッダが無ければここで書く（簡易チェック）
-    static bool header_written = false;
-    if (!header_written) {
-        ofs << "fit_x,fit_y,fit_z,t_light,err_x,err_y,err_z,t_error,chi2\n";
-        header_written = true;
-    }
-    // 書き込み
-    ofs << fit.X() << ',' << fit.Y() << ',' << fit.Z() << ','
-        << t_light << ','
-        << errors.X() << ',' << errors.Y() << ',' << errors.Z() << ','
-        << t_error << ',' << chi2 << '\n';
+const int N_MPMT = sizeof(pmt19orientations) / sizeof(pmt19orientations[0]);
 
-    ofs.close();
+// Fit result of one event
+struct EventResult {
+    int status = 2; // 0: fitted, 2: no data or not enough sensor units
+    TVector3 fit_pos, fiterr_pos;
+    double fit_time = 0, fiterr_time = 0, chi2 = 0;
+    int nmPMT = 0;  // number of mPMTs used for the fit
+    int nPMT = 0;   // number of 8 cm PMTs used for the fit
+};
+
+// Per-worker work buffers and minimizers, cleared (not freed) for each event.
+// Create all workspaces on the main thread before starting the workers: constructing or
+// deleting a TMinuit updates gMinuit and gROOT's list of specials (see reconst/reco/parallelReco.cc).
+struct EventWorkspace {
+    std::vector<std::vector<PMTData>> PMTDataBymPMT = std::vector<std::vector<PMTData>>(N_MPMT); // PMT data keyed by mPMTid
+    std::vector<int> hitmPMTids;         // mPMTids with data in this event
+    std::vector<SensorUnit> sensorUnits; // Vector to store fitted sensor units
+    std::vector<SensorUnit> PMTsUnits;   // Vector to store 3-inch PMTs
+    std::unique_ptr<TMinuit> positionMinuit = CreatePositionMinuit();       // direction fit of each mPMT
+    std::unique_ptr<TMinuit> lightSourceMinuit = CreateLightSourceMinuit(); // light source fit of the event
+};
 
-    std::cout << "fit_x,fit_y,fit_z,t_light,err_x,err_y,err_z,t_error,chi2" << std::endl;
-    std::cout << fit.X() << ',' << fit.Y() << ',' << fit.Z() << ',' << t_light << ',' << errors.X() << ',' << errors.Y() << ',' << errors.Z() << ',' << t_error << ',' << chi2 << std::endl;
+void writeCSVHeader(std::ofstream &ofs) {
+    ofs << "fit_x,fit_y,fit_z,t_light,err_x,err_y,err_z,t_error,chi2,eventNumber,n_mPMT,n_PMT\n";
 }
 
-int main() {
-    std::string inputfilename = "/home/fukazawa/disk3/workdir_1/MCprod/e-/results/mom350/sub/e-25-all";
-    std::string outputcsvfile = "/home/fukazawa/disk3/hoge.csv";
+void writeToCSV(std::ofstream &ofs, int eventNumber, const EventResult &res) {
+    ofs << res.fit_pos.X() << ',' << res.fit_pos.Y() << ',' << res.fit_pos.Z() << ','
+        << res.fit_time << ','
+        << res.fiterr_pos.X() << ',' << res.fiterr_pos.Y() << ',' << res.fiterr_pos.Z() << ','
+        << res.fiterr_time << ',' << res.chi2 << ','
+        << eventNumber << ',' << res.nmPMT << ',' << res.nPMT << '\n';
+}
 
-    std::map<int, std::vector<PMTData>> PMTDataMap; // Map to store PMT data keyed by mPMTid
-    int status = readData(inputfilename, PMTDataMap);
-    if (status == 1) {
-        std::cout << "Error reading data for event " << std::endl;
-        return 1; // Skip this event if there was an error
-    }
-    if (status == 2) {
-        std::cout << "No data for event " << std::endl;
-        return 2;
-    }
-    if (status == 3) {
-        std::cout << "all data was read " << std::endl;
-        return 3;
+// Fit one event (hits[0] ... hits[nHits - 1]). Thread-safe: uses only ws and res.
+void fitEvent(const PMTData *hits, size_t nHits, EventWorkspace &ws, EventResult &res) {
+    res = EventResult();
+
+    // group hits by mPMTid (reset of the previous event keeps the capacity)
+    for (int id : ws.hitmPMTids) ws.PMTDataBymPMT[id].clear();
+    ws.hitmPMTids.clear();
+    ws.sensorUnits.clear();
+    ws.PMTsUnits.clear();
+    for (size_t i = 0; i < nHits; ++i) {
+        int id = hits[i].mPMTid;
+        if (id < 0 || id >= N_MPMT) continue;
+        if (ws.PMTDataBymPMT[id].empty()) ws.hitmPMTids.push_back(id);
+        ws.PMTDataBymPMT[id].push_back(hits[i]);
     }
-    // std::cout << "Data read successfully." << std::endl;
-    //  Perform fitting for each mPMTid
-    std::cout << "PMTDataMap size: " << PMTDataMap.size() << std::endl;
-    int usePMTnum = 0;
+    if (ws.hitmPMTids.empty()) return; // No data for event
+    std::sort(ws.hitmPMTids.begin(), ws.hitmPMTids.end());
 
-    std::vector<SensorUnit> sensorUnits; // Vector to store fitted sensor units
-    std::vector<SensorUnit> PMTsUnits;   // Vector to store 3-inch PMTs
+    //  Perform fitting for each mPMTid
     SensorUnit sensorUnit;
     SensorUnit PMTsUnit;
-    for (const auto &pair : PMTDataMap) {
-        int mPMTid = pair.first;
-        const std::vector<PMTData> &pmtData = pair.second;
-        if (pmtData.empty()) {
-            std::cout << "\nNo data for mPMTid: " << mPMTid << std::endl;
-            continue;
-        }
+    for (int mPMTid : ws.hitmPMTids) {
+        const std::vector<PMTData> &pmtData = ws.PMTDataBymPMT[mPMTid];
 
         // filter and grouping 8 cm PMT data in 1 mPMT
         std::vector<PMTData> pmtdata_use = findExpandedGroups(pmtData, 5, 3, 0.5, 6); // Optional: filter or group data
@@ -96,39 +101,33 @@ int main() {
             PMTsUnit.posz = pmtdata_use[PMT_i].z;    // PMT z position
             PMTsUnit.time = pmtdata_use[PMT_i].t;    // PMT time
             PMTsUnit.L = pmtdata_use[PMT_i].L;
-            PMTsUnit.sigma_time = 1;       // PMT time
-            PMTsUnits.push_back(PMTsUnit); // Add PMT unit to the vector
+            PMTsUnit.sigma_time = 1;          // PMT time
+            ws.PMTsUnits.push_back(PMTsUnit); // Add PMT unit to the vector
         }
 
-        // std::cout << "\nFitting data for mPMTid: " << mPMTid << ", Number of PMTs: " << pmtdata_use.size() << std::endl;
-
         double fit_theta, fit_phi, err_theta, err_phi;
-        FitPosition(pmtdata_use, fit_theta, fit_phi, err_theta, err_phi);
+        FitPosition(pmtdata_use, *ws.positionMinuit, fit_theta, fit_phi, err_theta, err_phi);
         double errby_phi = err_phi * sin(fit_theta);
-        std::cout << "error angle is " << err_theta << " , " << err_phi << std::endl;
+        // std::cout << "error angle is " << err_theta << " , " << err_phi << std::endl;
         double timesum = 0;
         for (const auto &pmt : pmtdata_use) {
             timesum += pmt.t;
         }
 
-        int target_mPMTid = mPMTid;
         double ori_x, ori_y, ori_z;
         ori_x = pmt19orientations[mPMTid][0];
         ori_y = pmt19orientations[mPMTid][1];
         ori_z = pmt19orientations[mPMTid][2];
-        // std::cout << "{" << ori_x << ", " << ori_y << ", " << ori_z << "}," << std::endl;
 
         double phi0_x, phi0_y, phi0_z;
         phi0_x = pmt1orientations[mPMTid][0];
         phi0_y = pmt1orientations[mPMTid][1];
         phi0_z = pmt1orientations[mPMTid][2];
-        // std::cout << " {" << phi0_x << ", " << phi0_y << ", " << phi0_z << "}," << std::endl;
 
         double phi90_x, phi90_y, phi90_z;
         phi90_x = pmt4orientations[mPMTid][0];
         phi90_y = pmt4orientations[mPMTid][1];
         phi90_z = pmt4orientations[mPMTid][2];
-        // std::cout << " {" << phi90_x << ", " << phi90_y << ", " << phi90_z << "}," << std::endl;
 
         double fit_ori = cos(fit_theta);                  // ori方向成分
         double fit_phi0 = sin(fit_theta) * cos(fit_phi);  // phi0方向成分
@@ -149,45 +148,88 @@ int main() {
         // sensorUnit.sigma_sintheta = sqrt(err_theta * err_theta + errby_phi * errby_phi);
         sensorUnit.sigma_sintheta = err_theta; // Assuming sigma_sintheta is the error in theta
         sensorUnit.sigma_time = 1;
-        sensorUnits.push_back(sensorUnit);
-        usePMTnum++;
+        ws.sensorUnits.push_back(sensorUnit);
     }
-    std::cout << "Fitting " << sensorUnits.size() << " mPMTs." << std::endl;
-    std::cout << "Using " << usePMTnum << " PMTs for fitting." << std::endl;
+    res.nmPMT = ws.sensorUnits.size();
+    res.nPMT = ws.PMTsUnits.size();
 
     // Skip event if not enough number of PMTs hit
-    if (sensorUnits.size() < 4) {
-        // std::cout << "Not enough sensor units for fitting. Skipping event " << ev << std::endl;
-        PMTDataMap.clear();  // Clear PMT data map for the next event
-        PMTsUnits.clear();   // Clear PMT units for the next event
-        sensorUnits.clear(); // Clear sensor units for the next event
-        return 2;            // Skip this event if no sensor units were created
+    if (ws.sensorUnits.size() < 4) {
+        return;
     }
 
     // fitting with light_source_fit
-    TVector3 fit_pos, fiterr_pos;
-    double fit_time, fiterr_time, chi2;
-    FitLightSource(sensorUnits, PMTsUnits, fit_pos, fit_time, fiterr_pos, fiterr_time, chi2);
-
-    // std::cout << "\nTotal time taken: " << duration.count() * 1000 << " ms." << std::endl;
-    // std::cout << "Fitted position: (" << fit_pos.X() << ", " << fit_pos.Y() << ", " << fit_pos.Z() << ")" << std::endl;
-    // std::cout << "Fitted time: " << fit_time << " ns" << std::endl;
-    // std::cout << "Position error: (" << fiterr_pos.X() << ", " << fiterr_pos.Y() << ", " << fiterr_pos.Z() << ")" << std::endl;
-    // std::cout << "Time error: " << fiterr_time << " ns" << std::endl;
-    // std::cout << "Chi2: " << chi2 << std::endl;
-    // std::cout << "Chi2/NDF: " << chi2 / (2 * sensorUnits.size() - 4) << std::endl;
-
-    writeToCSV(
-        outputcsvfile,
-        fit_pos,
-        fit_time,
-        fiterr_pos,
-        fiterr_time,
-        chi2);
-
-    PMTDataMap.clear();  // Clear PMT data map for the next event
-    PMTsUnits.clear();   // Clear PMT units for the next event
-    sensorUnits.clear(); // Clear sensor units for the next event
+    FitLightSource(ws.sensorUnits, ws.PMTsUnits, *ws.lightSourceMinuit, res.fit_pos, res.fit_time, res.fiterr_pos, res.fiterr_time, res.chi2);
+    res.status = 0;
+}
+
+int main(int argc, char **argv) {
+    std::string inputfilename = "/home/fukazawa/disk3/workdir_1/MCprod/e-/results/mom350/sub/e-25-all";
+    std::string outputcsvfile = "/home/fukazawa/disk3/hoge.csv";
+    int nThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    int opt;
+    while ((opt = getopt(argc, argv, "i:o:j:h")) != -1) {
+        switch (opt) {
+        case 'i': inputfilename = optarg; break;
+        case 'o': outputcsvfile = optarg; break;
+        case 'j': nThreads = std::max(1, std::stoi(optarg)); break;
+        default:
+            std::cout << "usage: " << argv[0] << " [-i input (without .root)] [-o output.csv] [-j threads]" << std::endl;
+            return (opt == 'h') ? 0 : 1;
+        }
+    }
+
+    // read all events with a single file open
+    EventList events;
+    int status = readData(inputfilename, events);
+    if (status == 1) {
+        std::cout << "Error reading data" << std::endl;
+        return 1;
+    }
+    if (status == 2) {
+        std::cout << "No data on the used mPMTs" << std::endl;
+        return 2;
+    }
+
+    std::ofstream ofs(outputcsvfile, std::ios::out | std::ios::trunc);
+    if (!ofs.is_open()) {
+        std::cerr << "Cannot open " << outputcsvfile << " for writing\n";
+        return 1;
+    }
+    writeCSVHeader(ofs);
+
+    // fit events in parallel; events are handed out by a shared counter.
+    // each worker reuses its own workspace (buffers and two TMinuit), created here on the main thread
+    auto start = std::chrono::steady_clock::now();
+    nThreads = std::min<size_t>(nThreads, std::max<size_t>(events.size(), 1));
+    if (nThreads > 1) ROOT::EnableThreadSafety();
+    std::vector<EventWorkspace> workspaces(nThreads);
+    std::vector<EventResult> results(events.size());
+    std::atomic<size_t> next(0);
+    auto worker = [&](int w) {
+        EventWorkspace &ws = workspaces[w];
+        for (size_t ev = next++; ev < events.size(); ev = next++) {
+            fitEvent(events.eventHits(ev), events.nHits(ev), ws, results[ev]);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nThreads; ++i) threads.emplace_back(worker, i);
+    worker(0);
+    for (auto &th : threads) th.join();
+    std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+    // write in eventNumber order
+    int nFitted = 0;
+    for (size_t ev = 0; ev < events.size(); ++ev) {
+        if (results[ev].status != 0) continue;
+        writeToCSV(ofs, events.eventNumber[ev], results[ev]);
+        nFitted++;
+    }
+    ofs.close();
 
+    std::cout << "Fitted " << nFitted << " / " << events.size() << " events (" << nThreads << " threads, "
+              << duration.count() << " s, " << events.size() / std::max(duration.count(), 1e-9) << " events/s)" << std::endl;
+    std::cout << "output: " << outputcsvfile << std::endl;
     return 0;
 }
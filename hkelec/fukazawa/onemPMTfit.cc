@@ -37,7 +37,8 @@ static TFile *outputrootfile;
 static TTree *outputtree;
 
 // Prepare a vector to store PMT data
-static std::vector<PMTData> g_pmtData;
+// thread_local: several events are fitted in parallel (one TMinuit per worker, see main.cc)
+static thread_local std::vector<PMTData> g_pmtData;
 
 // 2つのベクトルがなす角を計算する関数
 double CalculateAngle(double x1, double y1, double z1, double x2, double y2, double z2) {
@@ -252,12 +253,18 @@ static void FcnForMinuit(Int_t &npar, Double_t *grad, Double_t &fval, Double_t *
     fval = CalculateError(par); // Compute the residual sum of squares
 }
 
-int fitting(double &fit_theta, double &fit_phi, double &err_theta, double &err_phi,
-            double &minimized) {
-    TMinuit minuit(4);// rを増やすなら+1
+std::unique_ptr<TMinuit> CreatePositionMinuit() {
+    auto minuit = std::make_unique<TMinuit>(4);// rを増やすなら+1
     // Set FCN function (fit function)
-    minuit.SetFCN(FcnForMinuit);// Set the function to be minimized
-    minuit.SetPrintLevel(-1);// Suppress output
+    minuit->SetFCN(FcnForMinuit);// Set the function to be minimized
+    minuit->SetPrintLevel(-1);// Suppress output
+    return minuit;
+}
+
+int fitting(TMinuit &minuit, double &fit_theta, double &fit_phi, double &err_theta, double &err_phi,
+            double &minimized) {
+    // 前のフィットのパラメータを消去して使い回す (TMinuit の生成・破棄はしない)
+    minuit.mncler();
 
     double maxL = 0;
     for (const auto &pmt : g_pmtData) {
@@ -287,12 +294,12 @@ int fitting(double &fit_theta, double &fit_phi, double &err_theta, double &err_p
     minimized = fval;
     // std::cout << "minimized is " << minimized << std::endl;
 
-    minuit.Clear();
     return status;// あんまりいらないかも
 }
 
 // Function to perform the fitting process
 void FitPosition(std::vector<PMTData> &pmtData,
+                 TMinuit &minuit,
                  double &fit_theta,
                  double &fit_phi,
                  double &err_theta,
@@ -305,7 +312,7 @@ void FitPosition(std::vector<PMTData> &pmtData,
     }
 
     double minimized = 0;
-    int status = fitting(fit_theta, fit_phi, err_theta, err_phi, minimized);
+    int status = fitting(minuit, fit_theta, fit_phi, err_theta, err_phi, minimized);
     if (status != 0) {
          std::cout << "Fitting failed with status: " << status << std::endl;
         return;
@@ -375,6 +382,7 @@ int onemPMTfit() {
     PMTData data;
     int data_now = 0;
     int hit_PMT = 0;
+    std::unique_ptr<TMinuit> minuit = CreatePositionMinuit();
     for (int ev = 0; ev < 1000; ev++) {
         hit_PMT = 0;
         for (Long64_t i = data_now; i < nEntries; ++i) {
@@ -410,7 +418,7 @@ int onemPMTfit() {
             g_pmtData = findExpandedGroups(g_pmtData, 5, 3, 0.5, 6);
             double fit_theta, fit_phi;
             double err_theta, err_phi;
-            FitPosition(g_pmtData, fit_theta, fit_phi, err_theta, err_phi);
+            FitPosition(g_pmtData, *minuit, fit_theta, fit_phi, err_theta, err_phi);
         }
         g_pmtData.clear();
     }
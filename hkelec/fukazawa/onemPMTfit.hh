@@ -3,13 +3,18 @@
 #define ONE_MPMT_FIT_HH
 #include "fittinginput.hh"
 #include "fstream"
+#include <TMinuit.h>
+#include <memory>
 int onemPMTfit(const std::string &inputfilename);
 std::vector<PMTData> findExpandedGroups(const std::vector<PMTData> &pmtData,
                                         double tau,
                                         int n,
                                         double expand_before,
                                         double expand_after);
+// TMinuit for FitPosition (create on the calling thread, one per worker; see CreateLightSourceMinuit)
+std::unique_ptr<TMinuit> CreatePositionMinuit();
 void FitPosition(std::vector<PMTData> &pmtData, // defined in fittinginput.hh
+                 TMinuit &minuit,                // from CreatePositionMinuit, reused for every fit
                  double &fit_theta,
                  double &fit_phi,
                  double &err_theta,
@@ -1,32 +1,43 @@
 // readData.cc
 #include "readData.hh"
+#include "TBranch.h"
 #include "TFile.h"
 #include "TTree.h"
 #include "fittinginput.hh"
+#include <algorithm>
 #include <iostream>
 #include <map>
 #include <string>
 #include <vector>
 
-int readData(std::string &inputfilename,  std::map<int, std::vector<PMTData>> &PMTDataMap) {
-    int ev=0;
-    int firstentry=0;
-    int lastentry; 
-    int eventNumber=0;
+bool isUsedmPMT(int mPMTid) {
+    // use mPMT id is {338, 339,340, 346, 347,348, 354,355,356}; the case of the data 30-4-all center is 40,40
+    return mPMTid == 338 || mPMTid == 339 || mPMTid == 340 || mPMTid == 346 || mPMTid == 347 || mPMTid == 348 || mPMTid == 354 || mPMTid == 355 || mPMTid == 356;
+    // use uPMT id is {330, 331,332,339, 340,341, 347, 348,349}
+    // return mPMTid == 330 || mPMTid == 331 || mPMTid == 332 || mPMTid == 339 || mPMTid == 340 || mPMTid == 341 || mPMTid == 347 || mPMTid == 348 || mPMTid == 349;
+    // return mPMTid > 317;
+}
+
+int readData(const std::string &inputfilename, EventList &events) {
+    events.eventNumber.clear();
+    events.begin.clear();
+    events.hits.clear();
+
     TFile *file = TFile::Open((inputfilename + ".root").c_str());
-	std::cout << "open file "<<file<<std::endl;
     if (!file || file->IsZombie()) {
-        std::cout << "Error: Cannot open file pmtdata.root" << std::endl;
+        std::cout << "Error: Cannot open file " << inputfilename << ".root" << std::endl;
         return 1;
     }
 
     TTree *tree = dynamic_cast<TTree *>(file->Get("PMTTree"));
     if (!tree) {
         std::cout << "Error: Cannot find TTree 'PMTTree' in file." << std::endl;
+        file->Close();
         return 1;
     }
 
     // ブランチ変数の定義
+    int eventNumber = 0;
     int tubeid, mPMTid, mPMT_pmtid;
     double x, y, z, L, t, ori_x, ori_y, ori_z, center_x, center_y, center_z;
     tree->SetBranchAddress("eventNumber", &eventNumber);
@@ -44,58 +55,76 @@ int readData(std::string &inputfilename,  std::map<int, std::vector<PMTData>> &P
     tree->SetBranchAddress("center_x", &center_x);
     tree->SetBranchAddress("center_y", &center_y);
     tree->SetBranchAddress("center_z", &center_z);
+    // 全エントリーで読むのは eventNumber と mPMTid だけ (残りは使う mPMT のヒットのときだけ読む)
+    TBranch *bEventNumber = tree->GetBranch("eventNumber");
+    TBranch *bmPMTid = tree->GetBranch("mPMTid");
 
-    std::cout << "branch is read" << std::endl;
     Long64_t nEntries = tree->GetEntries();
     if (nEntries == 0) {
         std::cout << "Error: No entries in TTree." << std::endl;
+        file->Close();
         return 1;
     }
-    tree->GetEntry(nEntries - 1);
-    int eventNumber_max = eventNumber + 1;
-    if (ev >= eventNumber_max) {
-        std::cout << "all event is readed, eventNumber_max is " << eventNumber_max << std::endl;
-        return 3;
-    }
-    PMTData data;
-    for (Long64_t i =0 ; i < nEntries; ++i) {
+
+    // 1回の走査で全イベントを読む
+    std::vector<int> hitEvent;   // events.hits の各ヒットの eventNumber
+    std::vector<int> allEvents;  // ヒットの無いイベントも含めた eventNumber
+    PMTData data = {};
+    for (Long64_t i = 0; i < nEntries; ++i) {
+        bEventNumber->GetEntry(i);
+        bmPMTid->GetEntry(i);
+        if (allEvents.empty() || allEvents.back() != eventNumber) allEvents.push_back(eventNumber);
+        if (!isUsedmPMT(mPMTid)) continue;
         tree->GetEntry(i);
-        // use mPMT id is {338, 339,340, 346, 347,348, 354,355,356}; the case of the data 30-4-all center is 40,40
-        if (eventNumber == ev && (mPMTid == 338 || mPMTid == 339 || mPMTid == 340 || mPMTid == 346 || mPMTid == 347 || mPMTid == 348 || mPMTid == 354 || mPMTid == 355 || mPMTid == 356)) {
-            // use uPMT id is {330, 331,332,339, 340,341, 347, 348,349}
-            // if (eventNumber == ev && (mPMTid == 330 || mPMTid == 331 || mPMTid == 332 || mPMTid == 339 || mPMTid == 340 || mPMTid == 341 || mPMTid == 347 || mPMTid == 348 || mPMTid == 349)) {
-            // if (eventNumber == ev && mPMTid > 317) {
-            //  if (eventNumber == ev) {
-            data.tubeid = tubeid;
-            data.mPMTid = mPMTid;
-            data.mPMT_pmtid = mPMT_pmtid;
-            data.t = t;
-            data.x = x;
-            data.y = y;
-            data.z = z;
-            data.L = L;
-            data.ori_x = ori_x;
-            data.ori_y = ori_y;
-            data.ori_z = ori_z;
-            data.center_x = center_x;
-            data.center_y = center_y;
-            data.center_z = center_z;
-            PMTDataMap[mPMTid].push_back(data);
-        }
-        if (eventNumber > ev) {
-			lastentry = i;
-            break;
-        }
+        data.tubeid = tubeid;
+        data.mPMTid = mPMTid;
+        data.mPMT_pmtid = mPMT_pmtid;
+        data.t = t;
+        data.x = x;
+        data.y = y;
+        data.z = z;
+        data.L = L;
+        data.ori_x = ori_x;
+        data.ori_y = ori_y;
+        data.ori_z = ori_z;
+        data.center_x = center_x;
+        data.center_y = center_y;
+        data.center_z = center_z;
+        events.hits.push_back(data);
+        hitEvent.push_back(eventNumber);
     }
-    // PMTDataMap[i]が空かどうかを確認
-    for (const auto &pair : PMTDataMap) {
-        if (pair.second.empty()) {
-            std::cout << "No data for mPMTid: " << pair.first << std::endl;
+    file->Close();
+
+    // 通常はエントリーが eventNumber 順に並んでいるが、そうでなければヒットを並べ替える (イベント内の順序は保つ)
+    std::sort(allEvents.begin(), allEvents.end());
+    allEvents.erase(std::unique(allEvents.begin(), allEvents.end()), allEvents.end());
+    if (!std::is_sorted(hitEvent.begin(), hitEvent.end())) {
+        std::vector<size_t> order(hitEvent.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return hitEvent[a] < hitEvent[b]; });
+        std::vector<PMTData> sorted(order.size());
+        std::vector<int> sortedEvent(order.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            sorted[i] = events.hits[order[i]];
+            sortedEvent[i] = hitEvent[order[i]];
         }
+        events.hits.swap(sorted);
+        hitEvent.swap(sortedEvent);
     }
-    std::cout << "PMTDataMap size: " << PMTDataMap.size() << std::endl;
-	file->Close();
-	if(PMTDataMap.size() == 0) return 2;
+
+    // イベントごとのヒットの範囲
+    events.eventNumber = allEvents;
+    events.begin.resize(allEvents.size() + 1);
+    size_t h = 0;
+    for (size_t e = 0; e < allEvents.size(); ++e) {
+        events.begin[e] = h;
+        while (h < hitEvent.size() && hitEvent[h] == allEvents[e]) ++h;
+    }
+    events.begin[allEvents.size()] = h;
+
+    std::cout << "read " << nEntries << " entries, " << events.size() << " events, "
+              << events.hits.size() << " hits on the used mPMTs" << std::endl;
+    if (events.hits.empty()) return 2;
     return 0;
 }
 
@@ -4,14 +4,37 @@
 #include "fittinginput.hh"
 #include <map>
 #include <string>
+#include <vector>
 /**
- * @brief Read PMT data from a ROOT file and store it in a map.
+ * @brief Hits of all events in PMTTree, stored in one array ordered by eventNumber.
+ *
+ * Hits of event i are hits[begin[i]] ... hits[begin[i + 1] - 1] (begin has size() + 1 entries).
+ * Events without any hit on the used mPMTs are kept with an empty range.
+ */
+struct EventList {
+    std::vector<int> eventNumber; // eventNumber of each event (ascending)
+    std::vector<size_t> begin;    // offset of the first hit of each event in hits
+    std::vector<PMTData> hits;    // hits on the used mPMTs
+
+    size_t size() const { return eventNumber.size(); }
+    size_t nHits(size_t i) const { return begin[i + 1] - begin[i]; }
+    const PMTData *eventHits(size_t i) const { return hits.data() + begin[i]; }
+};
+/**
+ * @brief mPMTs used for the fit (the case of the data 30-4-all, center is 40,40)
+ */
+bool isUsedmPMT(int mPMTid);
+/**
+ * @brief Read PMT data of all events from a ROOT file in one pass.
+ *
+ * Only the eventNumber and mPMTid branches are read for every entry; the other branches are read
+ * only for hits on the used mPMTs (isUsedmPMT).
  *
  * @param inputfilename The name of the input file (without extension).
- * @param PMTDataMap A map to store PMT data, keyed by mPMTid.
- * @return int Returns 0 on success, 1 on failure.
+ * @param events Hits of all events, grouped by eventNumber.
+ * @return int Returns 0 on success, 1 on failure, 2 if no hit is on the used mPMTs.
  */
-int readData(std::string &inputfilename, std::map<int, std::vector<PMTData>> &PMTDataMap);
+int readData(const std::string &inputfilename, EventList &events);
 /**
  * @brief Find PMT orientation of target PMT.
  */
@@ -8,15 +8,17 @@ CUSTOM_LIB_PATH="/home/hkpd/hkelec/DiscreteSoftware/build/lib"
 # 実行ファイル名
 EXECUTABLE_NAME="./eventtree2hist"
 
-# 引数のチェック: 入力ファイルと出力ファイル、計2つ必要
-if [ "$#" -ne 2 ]; then
-    echo "Usage: $0 <input_file.root> <output_file.root>"
+# 引数のチェック: 入力ファイルと出力ファイル (最後の2つ)。その前のオプションは eventtree2hist にそのまま渡す
+if [ "$#" -lt 2 ]; then
+    echo "Usage: $0 [options] <input_file.root> <output_file.root>"
     echo "例: $0 data/input.root output/hists.root"
+    echo "例 (2パス処理の結果と照合): $0 --verify data/input.root output/hists.root"
+    echo "オプション一覧: ${EXECUTABLE_NAME} -h"
     exit 1
 fi
 
-INPUT_FILE=$1
-OUTPUT_FILE=$2
+INPUT_FILE="${@: -2:1}"
+OUTPUT_FILE="${@: -1}"
 
 # --- 2. 環境変数の設定 ---
 
@@ -49,7 +51,7 @@ echo "入力ファイル: $INPUT_FILE"
 echo "出力ファイル: $OUTPUT_FILE"
 
 # 実行ファイルを実行し、成功/失敗メッセージを表示
-${EXECUTABLE_NAME} "$INPUT_FILE" "$OUTPUT_FILE"
+${EXECUTABLE_NAME} "$@"
 
 if [ $? -eq 0 ]; then
     echo ""
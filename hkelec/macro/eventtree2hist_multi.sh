@@ -15,15 +15,18 @@ EXECUTABLE_PATH="${SCRIPT_DIR}/eventtree2hist"
 
 # --- 2. 引数の検証 ---
 
-# 引数のチェック: 対象ディレクトリ、計1つ必要
-if [ "$#" -ne 1 ]; then
-    echo "Usage: $0 <target_directory>"
+# 引数のチェック: 対象ディレクトリ (必須) とスレッド数 (省略可, 0 = 全コア)
+if [ "$#" -lt 1 ] || [ "$#" -gt 2 ]; then
+    echo "Usage: $0 <target_directory> [n_threads]"
     echo "例: $0 /home/hkpd/hkelec/DiscreteSoftware/data/20251009/100pe"
     echo "例 (相対パス): $0 ../data/20251009/100pe"
+    echo "例 (8スレッド): $0 ../data/20251009/100pe 8"
     exit 1
 fi
 
 TARGET_DIR=$1
+# スレッド数 (ファイル単位で並列に処理し、余ったスレッドで各ファイル内のエントリー範囲を並列化)
+N_THREADS=${2:-0}
 
 # 指定された引数がディレクトリか確認
 if [ ! -d "$TARGET_DIR" ]; then
@@ -65,33 +68,27 @@ echo ""
 echo "--- 4. ディレクトリ内の複数ファイルの解析を実行します ---"
 echo "対象ディレクトリ: $TARGET_DIR"
 
-# 指定されたディレクトリ内の *eventtree.root ファイルをループ処理
-for INPUT_FILE in "$TARGET_DIR"/*eventtree.root; do
-    
-    # マッチするファイルが一つもなかった場合の処理
-    if [ ! -f "$INPUT_FILE" ]; then
-        echo "警告: 対象ディレクトリ内に *eventtree.root ファイルが見つかりませんでした。"
-        break
-    fi
+# 指定されたディレクトリ内の *eventtree.root ファイルを集める
+shopt -s nullglob
+INPUT_FILES=("$TARGET_DIR"/*eventtree.root)
+shopt -u nullglob
 
-    # 出力ファイル名を生成 (eventtree.root -> eventhist.root)
-    OUTPUT_FILE="${INPUT_FILE/eventtree.root/eventhist.root}"
-
-    echo ""
-    echo "------------------------------------------------------------"
-    echo "-> 処理中: $INPUT_FILE"
-    echo "   出力先: $OUTPUT_FILE"
-    echo "------------------------------------------------------------"
+# マッチするファイルが一つもなかった場合の処理
+if [ "${#INPUT_FILES[@]}" -eq 0 ]; then
+    echo "警告: 対象ディレクトリ内に *eventtree.root ファイルが見つかりませんでした。"
+    exit 0
+fi
 
-    # 実行ファイルをフルパスで指定して実行
-    "${EXECUTABLE_PATH}" "$INPUT_FILE" "$OUTPUT_FILE"
+echo "対象ファイル数: ${#INPUT_FILES[@]} (スレッド数: ${N_THREADS}, 0 = 全コア)"
 
-    if [ $? -eq 0 ]; then
-        echo "🎉 正常に完了しました。"
-    else
-        echo "⚠️ このファイルの処理中にエラーが発生しました。"
-    fi
-done
+# 全ファイルを1回の実行でまとめて処理 (出力: eventtree.root -> eventhist.root)
+"${EXECUTABLE_PATH}" -j "$N_THREADS" --multi "${INPUT_FILES[@]}"
 
-echo ""
-echo "✅ 全てのファイルの処理が完了しました。"
+if [ $? -eq 0 ]; then
+    echo ""
+    echo "✅ 全てのファイルの処理が完了しました。"
+else
+    echo ""
+    echo "⚠️ 一部のファイルの処理中にエラーが発生しました。上のログを確認してください。"
+    exit 1
+fi
@@ -0,0 +1,76 @@
+#!/bin/bash
+
+# eventtree2hist の出力設定 (列の型・圧縮・バスケットサイズ) ごとに
+# processed_hits のサイズ (bytes/hit) と読み戻しのスループットを比較するスクリプト
+# 各設定で eventtree2hist --report-io を実行し、"IO report" の行を集めて表示します。
+
+# --- 1. 変数の定義 ---
+
+SCRIPT_DIR=$(cd "$(dirname "$0")" && pwd)
+CUSTOM_LIB_PATH="/home/hkpd/hkelec/DiscreteSoftware/build/lib"
+EXECUTABLE_PATH="${SCRIPT_DIR}/eventtree2hist"
+
+# --- 2. 引数の検証 ---
+
+if [ "$#" -lt 1 ] || [ "$#" -gt 2 ]; then
+    echo "Usage: $0 <input_eventtree.root> [work_dir]"
+    echo "例: $0 ../data/20251009/100pe/LDhkelec_xxx_eventtree.root"
+    echo "    (出力は work_dir (デフォルト: /tmp/eventtree2hist_bench) に設定ごとに作られます)"
+    exit 1
+fi
+
+INPUT_FILE=$1
+WORK_DIR=${2:-/tmp/eventtree2hist_bench}
+
+if [ ! -f "$INPUT_FILE" ]; then
+    echo "エラー: 入力ファイル '$INPUT_FILE' が見つかりません。"
+    exit 1
+fi
+mkdir -p "$WORK_DIR"
+
+export LD_LIBRARY_PATH=${CUSTOM_LIB_PATH}:$LD_LIBRARY_PATH
+
+if ! make -C "${SCRIPT_DIR}"; then
+    echo "❌ コンパイル失敗。スクリプトを終了します。"
+    exit 1
+fi
+
+# --- 3. 比較する設定 (名前 と eventtree2hist のオプション) ---
+
+SETTINGS=(
+    "double_default|--precision double"
+    "compact_zlib|--precision compact --compress zlib"
+    "compact_lz4|--precision compact --compress lz4 --basket-kb 256"
+    "compact_zstd|--precision compact --compress zstd --basket-kb 256"
+    "float16_zstd|--precision float16 --compress zstd:9 --basket-kb 256"
+    "compact_lzma|--precision compact --compress lzma"
+)
+
+SUMMARY=()
+for entry in "${SETTINGS[@]}"; do
+    NAME=${entry%%|*}
+    OPTIONS=${entry#*|}
+    OUTPUT_FILE="${WORK_DIR}/${NAME}_eventhist.root"
+    echo ""
+    echo "--- ${NAME}: ${OPTIONS} ---"
+    # shellcheck disable=SC2086
+    LOG=$("${EXECUTABLE_PATH}" ${OPTIONS} --report-io "$INPUT_FILE" "$OUTPUT_FILE")
+    if [ $? -ne 0 ]; then
+        echo "⚠️ ${NAME} の実行に失敗しました。"
+        continue
+    fi
+    while IFS= read -r line; do
+        SUMMARY+=("${NAME}: ${line}")
+    done < <(echo "$LOG" | grep "^IO report")
+    echo "$LOG" | grep -E "^IO report|^File size|^Warning"
+done
+
+# --- 4. まとめ ---
+
+echo ""
+echo "======================================================================"
+echo "  出力設定ごとのサイズと読み戻しスループット"
+echo "======================================================================"
+for line in "${SUMMARY[@]}"; do
+    echo "$line"
+done
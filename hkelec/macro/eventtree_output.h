@@ -0,0 +1,134 @@
+/*
+ * id: eventtree_output.h
+ * Place: ~/hkelec/DiscreteSoftware/Analysis/macro/
+ * Last Edit: 2026-10-18 Gemini
+ *
+ * 概要: eventtree2hist の出力 TTree (processed_hits / processed_events) の書き込み設定
+ * (列の型 = 精度, 圧縮アルゴリズム, バスケットサイズ, AutoFlush) と、
+ * 設定した型で値を保持する TypedColumn を定義したヘッダーファイル。
+ * hgain/lgain/tot/tdc_diff は整数値 (ADC/TDC カウント)、ch は 1 バイトに収まるので、
+ * compact 以上では整数型で保存する (値が整数型で表せない場合は件数を数えて警告する)。
+ * コンパイル不要 (ヘッダーファイル)
+ */
+#ifndef EVENTTREE_OUTPUT_H
+#define EVENTTREE_OUTPUT_H
+
+#include <Compression.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+// 出力の精度
+// Double : 全て double (従来と同じ)
+// Compact: ch = UChar_t, hgain/lgain/tot = Short_t, tdc_diff = Int_t, time_diff = double (可逆)
+// Float  : Compact + time_diff = float (ns 単位で相対 6e-8 の丸め)
+// Float16: Compact + time_diff = Float16_t (仮数 12 bit, 1000 ns で 0.25 ns 程度の丸め。最小サイズ)
+enum class OutputPrecision { Double, Compact, Float, Float16 };
+
+// 出力 TTree の書き込み設定 (--precision, --compress, --basket-kb, --auto-flush, --report-io)
+struct OutputFormat {
+    OutputPrecision precision = OutputPrecision::Double;
+    int compression = -1;  // ROOT の圧縮設定 (アルゴリズム * 100 + レベル)。-1 でファイルのデフォルト
+    int basket_kb = 0;     // ブランチごとのバスケットサイズ (kB)。0 で ROOT のデフォルト (32 kB)
+    long auto_flush = 0;   // >0: エントリー数, <0: バイト数ごとにクラスターを区切る。0 で ROOT のデフォルト (-30 MB)
+    bool report = false;   // 書き込み後にサイズ (bytes/hit) と読み戻しのスループットを表示する
+
+    // "double", "compact", "float", "float16"
+    bool SetPrecision(const std::string& name) {
+        if (name == "double") precision = OutputPrecision::Double;
+        else if (name == "compact") precision = OutputPrecision::Compact;
+        else if (name == "float") precision = OutputPrecision::Float;
+        else if (name == "float16") precision = OutputPrecision::Float16;
+        else return false;
+        return true;
+    }
+
+    // "zlib", "lzma", "lz4", "zstd" (レベル省略時は ROOT の推奨値), "zstd:9" のようにレベル指定, "none" で無圧縮
+    bool SetCompression(const std::string& spec) {
+        std::string algo = spec;
+        int level = -1;
+        size_t colon = spec.find(':');
+        if (colon != std::string::npos) {
+            algo = spec.substr(0, colon);
+            char* end = nullptr;
+            level = static_cast<int>(std::strtol(spec.c_str() + colon + 1, &end, 10));
+            if (*end != '\0' || level < 0 || level > 9) return false;
+        }
+        if (algo == "none") { compression = 0; return true; }
+        ROOT::RCompressionSetting::EAlgorithm::EValues a;
+        int default_level;
+        if (algo == "zlib") { a = ROOT::RCompressionSetting::EAlgorithm::kZLIB; default_level = 1; }
+        else if (algo == "lzma") { a = ROOT::RCompressionSetting::EAlgorithm::kLZMA; default_level = 7; }
+        else if (algo == "lz4") { a = ROOT::RCompressionSetting::EAlgorithm::kLZ4; default_level = 4; }
+        else if (algo == "zstd") { a = ROOT::RCompressionSetting::EAlgorithm::kZSTD; default_level = 5; }
+        else return false;
+        compression = ROOT::CompressionSettings(a, level < 0 ? default_level : level);
+        return true;
+    }
+
+    // 表示用の短い説明 (例: "compact, zstd:5, basket 256 kB")
+    std::string Describe() const {
+        static const char* prec[] = {"double", "compact", "float", "float16"};
+        static const char* algo[] = {"default", "zlib", "lzma", "old", "lz4", "zstd"};
+        std::string s = prec[static_cast<int>(precision)];
+        if (compression < 0) s += ", compression default";
+        else if (compression == 0) s += ", no compression";
+        else {
+            int a = compression / 100;
+            s += std::string(", ") + ((a >= 0 && a <= 5) ? algo[a] : "?") + ":" + std::to_string(compression % 100);
+        }
+        if (basket_kb > 0) s += ", basket " + std::to_string(basket_kb) + " kB";
+        if (auto_flush != 0) s += ", auto-flush " + std::to_string(auto_flush);
+        return s;
+    }
+};
+
+/**
+ * @brief 1列分の出力バッファ (型は ROOT のリーフ型の1文字: D, F, f, I, s, b)
+ * size 要素の配列として確保するので、スカラーのブランチにも可変長配列のブランチにも使える。
+ * 値は double で受け取り、列の型に変換して格納する。
+ */
+class TypedColumn {
+public:
+    TypedColumn(char type, int size) : type_(type), storage_(size > 0 ? size : 1), n_lossy_(0) {}
+
+    char Type() const { return type_; }
+    void* Data() { return storage_.data(); }
+
+    // i 番目の要素に v を格納する。整数型で元の値に戻らない (端数・範囲外) 場合は n_lossy を数える
+    // (float / Float16_t は丸める前提で選ぶ型なので数えない)
+    void Set(int i, double v) {
+        switch (type_) {
+            case 'D': Store<double>(i, v); break;
+            case 'F':
+            case 'f': Store<float>(i, static_cast<float>(v)); break; // Float16_t もメモリ上は float
+            case 'I': StoreInt<int>(i, v); break;
+            case 's': StoreInt<short>(i, v); break;
+            case 'b': StoreInt<unsigned char>(i, v); break;
+        }
+    }
+
+    long GetNLossy() const { return n_lossy_; }
+
+private:
+    char type_;
+    std::vector<double> storage_; // 8 バイト境界に揃えるため double で確保する
+    long n_lossy_;
+
+    template <class T>
+    void Store(int i, T v) { reinterpret_cast<T*>(storage_.data())[i] = v; }
+
+    template <class T>
+    void StoreInt(int i, double v) {
+        double lo = std::numeric_limits<T>::min(), hi = std::numeric_limits<T>::max();
+        double r = std::round(v);
+        if (r != v || v < lo || v > hi) n_lossy_++;
+        Store<T>(i, static_cast<T>(std::min(std::max(r, lo), hi)));
+    }
+};
+
+#endif // EVENTTREE_OUTPUT_H
@@ -0,0 +1,113 @@
+/*
+ * id: eventtree_reader.h
+ * Place: ~/hkelec/DiscreteSoftware/Analysis/macro/
+ * Last Edit: 2026-10-18 Gemini
+ *
+ * 概要: eventtree.root の 'event' TTree (NormalHits / TriggerHits = std::vector<Hit>) から
+ * eventtree2hist が使う Hit のメンバー (channel, time, tdc, hgain, lgain, tot) だけを読む EventReader。
+ * Member モード (デフォルト): 分割保存されたメンバーのサブブランチ (NormalHits.time など) を
+ *   TTreeReaderArray で直接読む。Hit オブジェクトを作らず、使わないメンバーのバスケットも展開しない。
+ *   TriggerHits で条件を満たさないイベントでは NormalHits を読まない (TTreeReader は触れた時に読む)。
+ * Object モード (--object-read): 従来どおり std::vector<Hit> を SetBranchAddress で丸ごと読む。
+ * 入力が分割保存されていない (サブブランチが無い) 場合は自動で Object モードになる。
+ * コンパイル不要 (ヘッダーファイル)
+ */
+#ifndef EVENTTREE_READER_H
+#define EVENTTREE_READER_H
+
+#include <TTree.h>
+#include <TTreeReader.h>
+#include <TTreeReaderArray.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "RootInterface/Hit.h"
+
+// eventtree2hist が使う1ヒット分の値
+struct HitData {
+    int channel;
+    double time;  // s
+    double tdc;
+    double hgain, lgain, tot;
+};
+
+enum class ReadMode { Member, Object };
+
+class EventReader {
+public:
+    EventReader(TTree* tree, ReadMode mode) : tree_(tree), mode_(mode) {
+        if (mode_ == ReadMode::Member && !(HasMembers("NormalHits") && HasMembers("TriggerHits"))) {
+            mode_ = ReadMode::Object;
+            fell_back_ = true;
+        }
+        if (mode_ == ReadMode::Member) {
+            reader_ = std::make_unique<TTreeReader>(tree_);
+            hits_ = std::make_unique<MemberArrays>(*reader_, "NormalHits");
+            trig_ = std::make_unique<MemberArrays>(*reader_, "TriggerHits");
+        } else {
+            tree_->SetBranchAddress("NormalHits", &v_hit_);
+            tree_->SetBranchAddress("TriggerHits", &v_trig_);
+        }
+    }
+
+    ReadMode Mode() const { return mode_; }
+    // Member モードを指定したがサブブランチが無く Object モードになったか
+    bool FellBack() const { return fell_back_; }
+    const char* ModeName() const { return mode_ == ReadMode::Member ? "member" : "object"; }
+    long GetEntries() const { return tree_->GetEntries(); }
+
+    // entry 番目のイベントに移る (Member モードではブランチは値に触れた時に読まれる)
+    void Load(long entry) {
+        if (reader_) reader_->SetEntry(entry);
+        else tree_->GetEntry(entry);
+    }
+
+    size_t NHits() const { return reader_ ? hits_->channel.GetSize() : v_hit_->size(); }
+    size_t NTrig() const { return reader_ ? trig_->channel.GetSize() : v_trig_->size(); }
+    HitData GetHit(size_t i) const { return reader_ ? hits_->At(i) : FromHit((*v_hit_)[i]); }
+    HitData GetTrig(size_t i) const { return reader_ ? trig_->At(i) : FromHit((*v_trig_)[i]); }
+
+private:
+    // 1つの std::vector<Hit> ブランチのメンバーごとの配列 (型は Hit のメンバーの型に合わせる)
+    struct MemberArrays {
+        TTreeReaderArray<decltype(Hit::channel)> channel;
+        TTreeReaderArray<decltype(Hit::time)> time;
+        TTreeReaderArray<decltype(Hit::tdc)> tdc;
+        TTreeReaderArray<decltype(Hit::hgain)> hgain;
+        TTreeReaderArray<decltype(Hit::lgain)> lgain;
+        TTreeReaderArray<decltype(Hit::tot)> tot;
+
+        MemberArrays(TTreeReader& r, const std::string& b)
+            : channel(r, (b + ".channel").c_str()), time(r, (b + ".time").c_str()), tdc(r, (b + ".tdc").c_str()),
+              hgain(r, (b + ".hgain").c_str()), lgain(r, (b + ".lgain").c_str()), tot(r, (b + ".tot").c_str()) {}
+
+        HitData At(size_t i) {
+            return HitData{static_cast<int>(channel[i]), static_cast<double>(time[i]), static_cast<double>(tdc[i]),
+                           static_cast<double>(hgain[i]), static_cast<double>(lgain[i]), static_cast<double>(tot[i])};
+        }
+    };
+
+    static HitData FromHit(const Hit& h) {
+        return HitData{static_cast<int>(h.channel), static_cast<double>(h.time), static_cast<double>(h.tdc),
+                       static_cast<double>(h.hgain), static_cast<double>(h.lgain), static_cast<double>(h.tot)};
+    }
+
+    // branch が分割保存されていて、必要なメンバーのサブブランチが全てあるか
+    bool HasMembers(const std::string& branch) const {
+        for (const char* m : {"channel", "time", "tdc", "hgain", "lgain", "tot"}) {
+            if (!tree_->GetBranch((branch + "." + m).c_str())) return false;
+        }
+        return true;
+    }
+
+    TTree* tree_;
+    ReadMode mode_;
+    bool fell_back_ = false;
+    std::vector<Hit>* v_hit_ = nullptr;
+    std::vector<Hit>* v_trig_ = nullptr;
+    std::unique_ptr<TTreeReader> reader_;
+    std::unique_ptr<MemberArrays> hits_, trig_;
+};
+
+#endif // EVENTTREE_READER_H
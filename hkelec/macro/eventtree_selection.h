@@ -0,0 +1,415 @@
+/*
+ * id: eventtree_selection.h
+ * Place: ~/hkelec/DiscreteSoftware/Analysis/macro/
+ * Last Edit: 2026-10-18 Gemini
+ *
+ * 概要: eventtree2hist のヒット選択 (トリガー条件とチャンネルごとの時間窓) の設定と、
+ * それを1本の判定表にまとめた CompiledSelection を定義したヘッダーファイル。
+ * これまで eventtree2hist1.0〜4.0.C に分かれていた選択の違い (トリガー閾値, 窓の幅,
+ * チャンネル共通/個別のピーク) は全てこの設定で表せる。
+ * 設定ファイルは "key = value" の行 (# 以降はコメント)。チャンネル個別の上書きは "ch3.half_width_ns = 10" の形。
+ * 時間は設定では ns、内部 (time_diff の比較) では s で扱う。ns → s の変換は x / 1e9
+ * (丸めが1回だけなので 8 / 1e9 は 8.0e-9 と完全に一致する)。
+ * コンパイル不要 (ヘッダーファイル)
+ */
+#ifndef EVENTTREE_SELECTION_H
+#define EVENTTREE_SELECTION_H
+
+#include "TF1.h"
+#include "TH1D.h"
+#include "TMath.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// 時間窓の決め方
+// Peak : プレスキャンの最大ビン中心 ± half_width_ns
+// Sigma: プレスキャンのピークをガウスフィットし、mean ± k_sigma * sigma (max_half_width_ns で上限)
+// Fixed: low_ns 〜 high_ns の固定窓
+// None : 時間窓なし (全ヒットを採用)
+enum class WindowMode { Peak, Sigma, Fixed, None };
+
+// 1チャンネル分の窓の規則
+struct WindowRule {
+    WindowMode mode = WindowMode::Peak;
+    double half_width_ns = 8.0;
+    double k_sigma = 3.0;
+    double low_ns = 0.0;
+    double high_ns = 0.0;
+    bool enabled = true; // false: このチャンネルのヒットは全て捨てる
+};
+
+inline const char* window_mode_name(WindowMode m) {
+    switch (m) {
+        case WindowMode::Peak: return "peak";
+        case WindowMode::Sigma: return "sigma";
+        case WindowMode::Fixed: return "fixed";
+        case WindowMode::None: return "none";
+    }
+    return "?";
+}
+
+// 文字列 → double (全体が数値でなければ false)
+inline bool parse_double(const std::string& s, double& v) {
+    std::istringstream iss(s);
+    iss >> v;
+    return !iss.fail() && (iss >> std::ws).eof();
+}
+
+// 窓の規則に key = value を1つ適用する (不明なキーなら false)
+inline bool set_window_key(WindowRule& r, const std::string& key, const std::string& value, std::string& err) {
+    double v = 0;
+    if (key == "window") {
+        if (value == "peak") r.mode = WindowMode::Peak;
+        else if (value == "sigma") r.mode = WindowMode::Sigma;
+        else if (value == "fixed") r.mode = WindowMode::Fixed;
+        else if (value == "none") r.mode = WindowMode::None;
+        else { err = "window must be peak, sigma, fixed or none: " + value; return false; }
+        return true;
+    }
+    if (key == "enable") {
+        if (value == "1" || value == "true" || value == "on") r.enabled = true;
+        else if (value == "0" || value == "false" || value == "off") r.enabled = false;
+        else { err = "enable must be 0 or 1: " + value; return false; }
+        return true;
+    }
+    if (key != "half_width_ns" && key != "k_sigma" && key != "low_ns" && key != "high_ns") {
+        err = "unknown key: " + key;
+        return false;
+    }
+    if (!parse_double(value, v)) { err = "not a number: " + key + " = " + value; return false; }
+    if (key == "half_width_ns") r.half_width_ns = v;
+    else if (key == "k_sigma") r.k_sigma = v;
+    else if (key == "low_ns") { r.low_ns = v; r.mode = WindowMode::Fixed; }
+    else if (key == "high_ns") { r.high_ns = v; r.mode = WindowMode::Fixed; }
+    return true;
+}
+
+/**
+ * @brief ヒット選択の設定 (デフォルトは従来の eventtree2hist と同じ)
+ */
+struct SelectionConfig {
+    int trigger_ch = -1;              // -1: TriggerHits の先頭, >=0: TriggerHits のうちこのチャンネルの最初のヒット
+    bool trigger_cut = true;          // false: トリガーの hgain を見ない
+    double trigger_threshold = 800.0; // トリガーの hgain >= この値のイベントのみ採用
+    double prescan_min_ns = 0.0;      // プレスキャンの範囲 (min < time_diff < max)
+    double prescan_max_ns = 1000.0;
+    double prescan_bin_ns = 1.0;      // プレスキャンのビン幅
+    bool global_peak = false;         // true: 全チャンネルをまとめた1つのプレスキャンでピークを決める
+    double min_entries = 10;          // これ未満のエントリーのプレスキャンはピーク探索に使わない (そのチャンネルは捨てる)
+    double fit_range_ns = 5.0;        // sigma モード: ピーク ± この範囲をガウスフィット
+    double max_half_width_ns = 50.0;  // sigma モード: 窓の片側幅の上限
+    WindowRule def;                   // チャンネル共通の窓の規則
+    std::map<int, std::vector<std::pair<std::string, std::string>>> ch_keys; // チャンネル個別の上書き (設定順)
+
+    // key = value を1つ適用する (チャンネル個別は "ch<N>.<key>")
+    bool Set(const std::string& key, const std::string& value, std::string& err) {
+        if (key.size() > 2 && key.compare(0, 2, "ch") == 0 && key.find('.') != std::string::npos) {
+            size_t dot = key.find('.');
+            double ch = 0;
+            if (!parse_double(key.substr(2, dot - 2), ch) || ch < 0) { err = "bad channel key: " + key; return false; }
+            WindowRule probe;
+            if (!set_window_key(probe, key.substr(dot + 1), value, err)) return false;
+            ch_keys[static_cast<int>(ch)].emplace_back(key.substr(dot + 1), value);
+            return true;
+        }
+        if (key == "trigger_threshold" && value == "off") { trigger_cut = false; return true; }
+        if (key == "peak_scope") {
+            if (value == "channel") global_peak = false;
+            else if (value == "global") global_peak = true;
+            else { err = "peak_scope must be channel or global: " + value; return false; }
+            return true;
+        }
+        if (key == "window" || key == "half_width_ns" || key == "k_sigma" || key == "low_ns" ||
+            key == "high_ns" || key == "enable") {
+            return set_window_key(def, key, value, err);
+        }
+
+        double v = 0;
+        if (!parse_double(value, v)) { err = "not a number: " + key + " = " + value; return false; }
+        if (key == "trigger_ch") trigger_ch = static_cast<int>(v);
+        else if (key == "trigger_threshold") { trigger_threshold = v; trigger_cut = true; }
+        else if (key == "prescan_min_ns") prescan_min_ns = v;
+        else if (key == "prescan_max_ns") prescan_max_ns = v;
+        else if (key == "prescan_bin_ns") prescan_bin_ns = v;
+        else if (key == "min_entries") min_entries = v;
+        else if (key == "fit_range_ns") fit_range_ns = v;
+        else if (key == "max_half_width_ns") max_half_width_ns = v;
+        else { err = "unknown key: " + key; return false; }
+        return true;
+    }
+
+    // "key=value" の形の文字列を適用する (--set 用)
+    bool SetAssignment(const std::string& assignment, std::string& err) {
+        size_t eq = assignment.find('=');
+        if (eq == std::string::npos) { err = "expected key=value: " + assignment; return false; }
+        return Set(trim(assignment.substr(0, eq)), trim(assignment.substr(eq + 1)), err);
+    }
+
+    // 設定ファイルを読む
+    bool Load(const std::string& filename, std::string& err) {
+        std::ifstream in(filename);
+        if (!in) { err = "cannot open " + filename; return false; }
+        std::string line;
+        int lineno = 0;
+        while (std::getline(in, line)) {
+            lineno++;
+            size_t hash = line.find('#');
+            if (hash != std::string::npos) line.resize(hash);
+            line = trim(line);
+            if (line.empty()) continue;
+            if (!SetAssignment(line, err)) {
+                err = filename + ":" + std::to_string(lineno) + ": " + err;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // チャンネル ch に適用される窓の規則
+    WindowRule RuleFor(int ch) const {
+        WindowRule r = def;
+        auto it = ch_keys.find(ch);
+        if (it != ch_keys.end()) {
+            std::string err;
+            for (auto const& [k, v] : it->second) set_window_key(r, k, v, err);
+        }
+        return r;
+    }
+
+    // プレスキャン (ピーク探索) が必要か
+    bool NeedsPrescan() const {
+        auto needs = [](const WindowRule& r) {
+            return r.enabled && (r.mode == WindowMode::Peak || r.mode == WindowMode::Sigma);
+        };
+        if (needs(def)) return true;
+        for (auto const& [ch, keys] : ch_keys) if (needs(RuleFor(ch))) return true;
+        return false;
+    }
+
+    /**
+     * @brief 最終的な時間窓に入りうる time_diff の範囲 [low, high] (s)
+     * 1パス処理はこの範囲のヒットだけをバッファする。
+     * ピークはプレスキャン範囲内のビン中心なので、Peak の窓はプレスキャン範囲 ± half_width_ns に収まる。
+     * Sigma の窓の中心はフィットの mean (ピーク ± fit_range_ns の内側) で片側幅は max_half_width_ns 以下、
+     * フィットが失敗した時はピーク ± half_width_ns なので、max(max_half_width_ns, half_width_ns) + fit_range_ns だけ広げる。
+     */
+    void CandidateRange(double& low, double& high) const {
+        const double inf = std::numeric_limits<double>::infinity();
+        low = inf;
+        high = -inf;
+        auto extend = [&](const WindowRule& r) {
+            if (!r.enabled) return;
+            switch (r.mode) {
+                case WindowMode::None:
+                    low = -inf;
+                    high = inf;
+                    break;
+                case WindowMode::Fixed:
+                    low = std::min(low, r.low_ns / 1e9);
+                    high = std::max(high, r.high_ns / 1e9);
+                    break;
+                case WindowMode::Peak:
+                case WindowMode::Sigma: {
+                    double hw = (r.mode == WindowMode::Peak)
+                                  ? r.half_width_ns
+                                  : std::max(max_half_width_ns, r.half_width_ns) + fit_range_ns;
+                    low = std::min(low, (prescan_min_ns - hw) / 1e9);
+                    high = std::max(high, (prescan_max_ns + hw) / 1e9);
+                    break;
+                }
+            }
+        };
+        extend(def);
+        for (auto const& [ch, keys] : ch_keys) extend(RuleFor(ch));
+    }
+
+    // 設定の要約を表示する
+    void Print(std::ostream& os) const {
+        os << "Selection: trigger ";
+        if (trigger_ch < 0) os << "TriggerHits[0]";
+        else os << "TriggerHits ch " << trigger_ch;
+        if (trigger_cut) os << ", hgain >= " << trigger_threshold;
+        os << " | prescan (" << prescan_min_ns << ", " << prescan_max_ns << ") ns, bin " << prescan_bin_ns << " ns"
+           << (global_peak ? ", global peak" : ", per-channel peak") << std::endl;
+        os << "  default window: " << describe(def) << std::endl;
+        for (auto const& [ch, keys] : ch_keys) {
+            os << "  ch " << ch << " window: " << describe(RuleFor(ch)) << std::endl;
+        }
+    }
+
+    static std::string trim(const std::string& s) {
+        size_t b = s.find_first_not_of(" \t\r\n");
+        if (b == std::string::npos) return "";
+        size_t e = s.find_last_not_of(" \t\r\n");
+        return s.substr(b, e - b + 1);
+    }
+
+    static std::string describe(const WindowRule& r) {
+        std::ostringstream oss;
+        if (!r.enabled) return "disabled";
+        oss << window_mode_name(r.mode);
+        if (r.mode == WindowMode::Peak) oss << " +- " << r.half_width_ns << " ns";
+        else if (r.mode == WindowMode::Sigma) oss << " +- " << r.k_sigma << " sigma";
+        else if (r.mode == WindowMode::Fixed) oss << " [" << r.low_ns << ", " << r.high_ns << "] ns";
+        return oss.str();
+    }
+};
+
+/**
+ * @brief イベントループで評価する判定表 (チャンネル番号で直接引く平坦な配列)
+ * プレスキャンから窓が決まった後に SelectionConfig から作る。
+ * 表に無いチャンネルには other_* を使う (共通ピークや固定窓・窓なしの場合に採用される)。
+ */
+struct CompiledSelection {
+    std::vector<char> accept;  // 0: このチャンネルは捨てる
+    std::vector<double> low;   // s
+    std::vector<double> high;  // s
+    bool accept_other = false;
+    double other_low = 0, other_high = 0;
+
+    bool Accept(int ch, double time_diff) const {
+        if (ch >= 0 && ch < static_cast<int>(accept.size())) {
+            return accept[ch] && !(time_diff < low[ch] || time_diff > high[ch]);
+        }
+        return accept_other && !(time_diff < other_low || time_diff > other_high);
+    }
+
+    bool operator==(const CompiledSelection& o) const {
+        return accept == o.accept && low == o.low && high == o.high && accept_other == o.accept_other &&
+               other_low == o.other_low && other_high == o.other_high;
+    }
+    bool operator!=(const CompiledSelection& o) const { return !(*this == o); }
+};
+
+/**
+ * @brief プレスキャンのピークをガウスフィットして (mean, sigma) を ns で返す
+ * フィットは ns 単位のコピーで行う (s 単位だとパラメータが 1e-9 程度になり MINUIT の刻み幅に合わない)。
+ * @return 成功したら true
+ */
+inline bool fit_prescan_peak(const TH1D* hist, double peak_s, double fit_range_ns, double& mean_ns, double& sigma_ns) {
+    int nb = hist->GetNbinsX();
+    const TAxis* ax = hist->GetXaxis();
+    TH1D h_ns("h_prescan_ns", "", nb, ax->GetXmin() * 1e9, ax->GetXmax() * 1e9);
+    h_ns.SetDirectory(nullptr);
+    for (int b = 1; b <= nb; ++b) h_ns.SetBinContent(b, hist->GetBinContent(b));
+
+    double peak_ns = peak_s * 1e9;
+    double lo = peak_ns - fit_range_ns, hi = peak_ns + fit_range_ns;
+    TF1 f("f_prescan_gaus", [](double* x, double* p) {
+        double u = (x[0] - p[1]) / p[2];
+        return p[0] * std::exp(-0.5 * u * u);
+    }, lo, hi, 3);
+    f.SetParameters(hist->GetMaximum(), peak_ns, std::max(fit_range_ns / 3.0, 0.1));
+    int status = h_ns.Fit(&f, "QN0R");
+    mean_ns = f.GetParameter(1);
+    sigma_ns = std::fabs(f.GetParameter(2));
+    return status == 0 && sigma_ns > 0 && std::isfinite(mean_ns) && mean_ns > lo && mean_ns < hi;
+}
+
+/**
+ * @brief プレスキャンから各チャンネルの窓を決め、判定表を作る
+ * @param prescan_hists キー: チャンネル番号 (global_peak の場合は -1 の1つだけ)
+ */
+inline CompiledSelection compile_selection(const SelectionConfig& sel, const std::map<int, TH1D*>& prescan_hists,
+                                           std::ostream& log, bool verbose_all) {
+    CompiledSelection cs;
+    const double inf = std::numeric_limits<double>::infinity();
+
+    // 窓の規則とプレスキャンから [low, high] (s) を決める。採用できなければ false
+    // 共通ピークではチャンネルごとに同じ行が並ぶので、表示は個別設定のあるチャンネルと残り (-1) の分だけにする
+    auto label = [](int ch) { return (ch < 0) ? std::string("Other channels") : "Channel " + std::to_string(ch); };
+    auto resolve = [&](int ch, const WindowRule& r, const TH1D* hist, double& low, double& high) {
+        bool verbose = verbose_all && !(sel.global_peak && ch >= 0 && !sel.ch_keys.count(ch));
+        if (!r.enabled) return false;
+        if (r.mode == WindowMode::None) { low = -inf; high = inf; return true; }
+        if (r.mode == WindowMode::Fixed) { low = r.low_ns / 1e9; high = r.high_ns / 1e9; return true; }
+
+        if (!hist) return false;
+        // データが少なすぎるプレスキャン (10未満) は破棄する仕様
+        if (hist->GetEntries() < sel.min_entries) {
+            if (verbose) log << label(ch) << ": Not enough entries (" << hist->GetEntries() << "). Skipping." << std::endl;
+            return false;
+        }
+        int peak_bin = hist->GetMaximumBin();
+        double time_peak = hist->GetXaxis()->GetBinCenter(peak_bin);
+
+        if (r.mode == WindowMode::Sigma) {
+            double mean_ns = 0, sigma_ns = 0;
+            if (fit_prescan_peak(hist, time_peak, sel.fit_range_ns, mean_ns, sigma_ns)) {
+                double hw_ns = std::min(r.k_sigma * sigma_ns, sel.max_half_width_ns);
+                low = (mean_ns - hw_ns) / 1e9;
+                high = (mean_ns + hw_ns) / 1e9;
+                if (verbose) {
+                    log << label(ch) << ": Fit mean=" << mean_ns << " ns, sigma=" << sigma_ns
+                        << " ns, Window=[" << low * 1e9 << ", " << high * 1e9 << "] ns" << std::endl;
+                }
+                return true;
+            }
+            if (verbose) log << label(ch) << ": Gaussian fit failed, using peak +- " << r.half_width_ns << " ns" << std::endl;
+        }
+
+        // ピーク値からカット範囲を決定 (ピーク ± half_width)
+        low = time_peak - r.half_width_ns / 1e9;
+        high = time_peak + r.half_width_ns / 1e9;
+        if (verbose) {
+            log << label(ch) << ": Peak=" << time_peak * 1e9
+                << " ns, Window=[" << low * 1e9 << ", " << high * 1e9 << "] ns" << std::endl;
+        }
+        return true;
+    };
+
+    if (verbose_all) log << "\n--- Calculating Time Cuts per Channel ---" << std::endl;
+
+    // 表に載せるチャンネル: プレスキャンのあるチャンネルと個別設定のあるチャンネル
+    int max_ch = -1;
+    for (auto const& [ch, hist] : prescan_hists) max_ch = std::max(max_ch, ch);
+    for (auto const& [ch, keys] : sel.ch_keys) max_ch = std::max(max_ch, ch);
+    cs.accept.assign(max_ch + 1, 0);
+    cs.low.assign(max_ch + 1, 0.0);
+    cs.high.assign(max_ch + 1, 0.0);
+
+    const TH1D* global_hist = nullptr;
+    if (sel.global_peak) {
+        auto it = prescan_hists.find(-1);
+        if (it != prescan_hists.end()) global_hist = it->second;
+    }
+
+    for (int ch = 0; ch <= max_ch; ++ch) {
+        bool listed = prescan_hists.count(ch) || sel.ch_keys.count(ch);
+        if (!listed && !sel.global_peak) continue;
+        const TH1D* hist = global_hist;
+        if (!sel.global_peak) {
+            auto it = prescan_hists.find(ch);
+            hist = (it != prescan_hists.end()) ? it->second : nullptr;
+        }
+        double lo = 0, hi = 0;
+        if (listed && resolve(ch, sel.RuleFor(ch), hist, lo, hi)) {
+            cs.accept[ch] = 1;
+            cs.low[ch] = lo;
+            cs.high[ch] = hi;
+        } else if (!listed) {
+            // 共通ピークで、表の途中にある未登場チャンネル: 共通の窓を使う
+            if (resolve(ch, sel.def, hist, lo, hi)) {
+                cs.accept[ch] = 1;
+                cs.low[ch] = lo;
+                cs.high[ch] = hi;
+            }
+        }
+    }
+
+    // 表に無いチャンネル (プレスキャン範囲にヒットが無かったもの)
+    // チャンネル別ピークではピークが無いので捨てる (従来と同じ)
+    if (sel.global_peak || sel.def.mode == WindowMode::None || sel.def.mode == WindowMode::Fixed) {
+        cs.accept_other = resolve(-1, sel.def, global_hist, cs.other_low, cs.other_high);
+    }
+    return cs;
+}
+
+#endif // EVENTTREE_SELECTION_H
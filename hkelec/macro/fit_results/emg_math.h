@@ -0,0 +1,144 @@
+/*
+ * id: emg_math.h
+ * Place: ~/hkelec/DiscreteSoftware/Analysis/macro/fit_results/
+ * Last Edit: 2026-10-18 Gemini
+ *
+ * 概要: EMG (hist_fit_engine.h の EMG 関数) の最大値の位置 (mode) と半値全幅 (FWHM)、
+ * およびそれらの (μ, σ, λ) での微分 (誤差伝播用)。TF1::GetMaximumX / GetX や数値微分を使わない。
+ * 標準化した変数 z = (x - μ)/σ では、EMG の形は k = λσ だけで決まる:
+ *   ln f = const - k z + ln erfc(u),  u = (k - z)/√2
+ * mode は d(ln f)/dz = -k + R(u) = 0 (R(u) = √(2/π) / erfcx(u) は単調増加) の解 u* から z* = k - √2 u*、
+ * FWHM は ln f(z) = ln f(z*) - ln 2 の左右の解 z1, z2 から σ (z2 - z1)。
+ * どちらも1変数の Newton 法 (二分法で保護) で解き、k での微分は陰関数の微分で解析的に求める。
+ * γ (面積) は mode と FWHM に効かないので、微分は 0。
+ * コンパイル不要 (ヘッダーファイル)
+ */
+#ifndef EMG_MATH_H
+#define EMG_MATH_H
+
+#include <cmath>
+
+// exp(z²) erfc(z)。z が大きいところは漸近展開 (z = 20 で相対誤差 3e-12)
+inline double erfcx(double z) {
+    if (z < 20) return std::exp(z * z) * std::erfc(z);
+    double iz2 = 1.0 / (z * z);
+    return (1 - 0.5 * iz2 * (1 - 1.5 * iz2 * (1 - 2.5 * iz2 * (1 - 3.5 * iz2)))) / (z * std::sqrt(M_PI));
+}
+
+// ln erfc(u) (u が大きくても -u² + ln erfcx(u) でアンダーフローしない)
+inline double emg_log_erfc(double u) {
+    return (u < 0) ? std::log(std::erfc(u)) : std::log(erfcx(u)) - u * u;
+}
+
+// R(u) = √(2/π) / erfcx(u) = -d ln erfc(u)/du / √2
+inline double emg_R(double u) {
+    const double c = std::sqrt(2.0 / M_PI);
+    if (u < -25) return c * std::exp(-u * u) / std::erfc(u); // erfcx のオーバーフローを避ける (ほぼ 0)
+    return c / erfcx(u);
+}
+
+// 標準化した EMG (形のパラメータ k) の ln f と、z・k での微分
+struct EmgStd {
+    double k;
+    double LogF(double z) const { double u = (k - z) / std::sqrt(2.0); return -k * z + emg_log_erfc(u); }
+    double DzLogF(double z) const { return -k + emg_R((k - z) / std::sqrt(2.0)); }
+    double DkLogF(double z) const { return -z - emg_R((k - z) / std::sqrt(2.0)); }
+};
+
+// mode と FWHM、その (μ, σ, λ) での微分 (d_mode[0] = ∂mode/∂μ, [1] = ∂/∂σ, [2] = ∂/∂λ)
+struct EmgShape {
+    bool ok = false;
+    double mode = 0, fwhm = 0;
+    double d_mode[3] = {0, 0, 0};
+    double d_fwhm[3] = {0, 0, 0};
+};
+
+/**
+ * @brief f(x) = target の根を [lo, hi] (f(lo), f(hi) で符号が違う) で探す (Newton 法, 外れたら二分法)
+ * df は f の微分。
+ */
+template <class F, class DF>
+inline double emg_solve(F f, DF df, double lo, double hi) {
+    double flo = f(lo);
+    double x = 0.5 * (lo + hi);
+    for (int it = 0; it < 100; ++it) {
+        double fx = f(x);
+        if (fx == 0) return x;
+        if ((fx < 0) == (flo < 0)) { lo = x; flo = fx; } else { hi = x; }
+        double d = df(x);
+        double xn = (d != 0) ? x - fx / d : 0.5 * (lo + hi);
+        if (!(xn > lo && xn < hi)) xn = 0.5 * (lo + hi);
+        if (std::abs(xn - x) <= 1e-13 * (1 + std::abs(x))) return xn;
+        x = xn;
+    }
+    return x;
+}
+
+/**
+ * @brief EMG の mode と FWHM (と微分) を計算する
+ * @param mu, sigma, lambda hist_fit_engine.h の EMG のパラメータ 0, 2, 3 (σ > 0, λ > 0)
+ */
+inline EmgShape emg_shape(double mu, double sigma, double lambda) {
+    EmgShape s;
+    if (!(sigma > 0) || !(lambda > 0)) return s;
+    const double sq2 = std::sqrt(2.0);
+    EmgStd e{lambda * sigma};
+    double k = e.k;
+
+    // mode: R(u*) = k。R(u) > √2 u なので u* < k/√2、下側は R がほぼ 0 になる所まで
+    double u_hi = k / sq2, u_lo = u_hi - 1;
+    while (emg_R(u_lo) > k && u_lo > -40) u_lo -= 2 * (u_hi - u_lo);
+    auto dR = [](double u) { double r = emg_R(u); return r * (std::sqrt(2.0) * r - 2 * u); };
+    double u_star = emg_solve([&](double u) { return emg_R(u) - k; }, dR, u_lo, u_hi);
+    double z_star = k - sq2 * u_star;
+
+    // 半値: ln f(z) - ln f(z*) + ln 2 = 0 を mode の左右で解く
+    double log_half = e.LogF(z_star) - std::log(2.0);
+    auto h = [&](double z) { return e.LogF(z) - log_half; };
+    auto dh = [&](double z) { return e.DzLogF(z); };
+    auto bracket = [&](double dir) {
+        double step = 1;
+        while (h(z_star + dir * step) > 0 && step < 1e6) step *= 2;
+        return z_star + dir * step;
+    };
+    double z1 = emg_solve(h, dh, bracket(-1), z_star);
+    double z2 = emg_solve(h, dh, z_star, bracket(+1));
+
+    // k での微分 (陰関数の微分)
+    // mode: dz*/dk = 1 + 1/(R(√2u - R)) (= -∂²lnf/∂z∂k / ∂²lnf/∂z²)
+    double r = emg_R(u_star);
+    double dz_star = 1 + 1 / (r * (sq2 * u_star - r));
+    // 半値の点: dz_i/dk = -(∂lnf/∂k(z_i) - ∂lnf/∂k(z*)) / ∂lnf/∂z(z_i)  (∂lnf/∂z(z*) = 0)
+    double dk_star = e.DkLogF(z_star);
+    double dz1 = -(e.DkLogF(z1) - dk_star) / e.DzLogF(z1);
+    double dz2 = -(e.DkLogF(z2) - dk_star) / e.DzLogF(z2);
+    double w = z2 - z1, dw = dz2 - dz1;
+    if (!std::isfinite(z_star) || !std::isfinite(w) || !std::isfinite(dz_star) || !std::isfinite(dw)) return s;
+
+    // x = μ + σ z(k), k = λσ
+    s.mode = mu + sigma * z_star;
+    s.fwhm = sigma * w;
+    s.d_mode[0] = 1;
+    s.d_mode[1] = z_star + sigma * lambda * dz_star;
+    s.d_mode[2] = sigma * sigma * dz_star;
+    s.d_fwhm[1] = w + sigma * lambda * dw;
+    s.d_fwhm[2] = sigma * sigma * dw;
+    s.ok = true;
+    return s;
+}
+
+/**
+ * @brief 微分 grad (μ, σ, λ) と共分散行列 cov (cov(i, j) で引けるもの。TMatrixDSym など) から誤差を求める
+ * i_mu, i_sigma, i_lambda は cov の中の μ, σ, λ の添字 (hist_fit_engine.h の EMG は 0, 2, 3)。
+ */
+template <class Cov>
+inline double emg_error(const double grad[3], const Cov& cov, int i_mu = 0, int i_sigma = 2, int i_lambda = 3) {
+    const int idx[3] = {i_mu, i_sigma, i_lambda};
+    double var = 0;
+    for (int a = 0; a < 3; ++a) {
+        for (int b = 0; b < 3; ++b) var += grad[a] * grad[b] * cov(idx[a], idx[b]);
+    }
+    return var > 0 ? std::sqrt(var) : 0.0;
+}
+
+#endif // EMG_MATH_H
@@ -0,0 +1,277 @@
+/*
+ * id: fast_binned_fit.h
+ * Place: ~/hkelec/DiscreteSoftware/Analysis/macro/fit_results/
+ * Last Edit: 2026-10-18 Gemini
+ *
+ * 概要: ガウス / EMG 専用の高速な binned フィッター (TF1 と TH1::Fit を使わない)。
+ * ヒストグラムのビン配列 (ビン中心, 内容) を直接フィットする。
+ * - 目的関数: Poisson 尤度 (Baker-Cousins の尤度比 χ²) または Neyman χ² (TH1::Fit のデフォルトと同じ)
+ * - 最小化: 解析的な微分 (ヤコビアン) を使った Levenberg-Marquardt 法 (Poisson は Fisher スコアリング)
+ * - 初期値: フィット範囲内のモーメント (平均, 標準偏差, 面積) から決める
+ * - 誤差: 最小点での (J^T W J)^-1 の対角成分 (Minuit の HESSE と同じ定義: χ² + 1)
+ * パラメータの制限は各ステップで範囲内に丸める (Minuit の制限付きパラメータに相当)。
+ * TH1::Fit と同様にビン中心で関数を評価し、中心がフィット範囲内のビンだけを使う。
+ * Neyman χ² では内容が 0 のビンを除く (TH1::Fit と同じ)。
+ * EMG の mode と FWHM は emg_math.h で計算する (共分散行列 cov を誤差伝播に使う)。
+ * コンパイル不要 (ヘッダーファイル)
+ */
+#ifndef FAST_BINNED_FIT_H
+#define FAST_BINNED_FIT_H
+
+#include <TH1.h>
+#include "emg_math.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// フィット範囲内のビン (中心と内容)
+struct BinnedData {
+    std::vector<double> x;
+    std::vector<double> n;
+    double width = 1; // 最初のビンの幅 (初期値の面積 → 振幅の換算に使う)
+};
+
+// ビン中心が [xmin, xmax] に入るビンを取り出す
+inline BinnedData binned_range(const TH1& hist, double xmin, double xmax) {
+    BinnedData d;
+    const TAxis* axis = hist.GetXaxis();
+    for (int i = 1; i <= hist.GetNbinsX(); ++i) {
+        double c = axis->GetBinCenter(i);
+        if (c < xmin || c > xmax) continue;
+        if (d.x.empty()) d.width = axis->GetBinWidth(i);
+        d.x.push_back(c);
+        d.n.push_back(hist.GetBinContent(i));
+    }
+    return d;
+}
+
+enum class FitCost { Poisson, Chi2 };
+
+struct FastFitResult {
+    bool valid = false;
+    std::vector<double> par;
+    std::vector<double> err;
+    std::vector<double> cov; // 共分散行列 (NPAR × NPAR, 行優先)
+    double chi2 = 0;  // Chi2: Neyman χ², Poisson: 尤度比 χ² (2 Σ [f - n + n ln(n/f)])
+    int ndf = 0;
+    int n_iter = 0;
+
+    double Cov(int i, int j) const { return cov[i * par.size() + j]; }
+};
+
+// パラメータの制限 (lo < hi のときだけ有効)
+struct ParLimit {
+    double lo = 0, hi = 0;
+    bool Active() const { return lo < hi; }
+};
+
+// --- 1. モデル (値と、各パラメータでの微分 grad を返す) ---
+
+// A exp(-(x-m)²/(2s²))。par: A, mean, sigma (TF1 の "gaus" と同じ)
+struct GausModel {
+    static constexpr int NPAR = 3;
+    double operator()(double x, const double* p, double* grad) const {
+        double s = p[2];
+        if (s == 0) return std::numeric_limits<double>::quiet_NaN();
+        double u = (x - p[1]) / s;
+        double g = std::exp(-0.5 * u * u);
+        double f = p[0] * g;
+        if (grad) {
+            grad[0] = g;
+            grad[1] = f * u / s;
+            grad[2] = f * u * u / s;
+        }
+        return f;
+    }
+};
+
+// hist_fit_engine.h の EMG と同じ式。par: mu, gamma (面積), sigma, lambda (1/tau)
+// f = 0.5 γ λ E erfc(z), E = exp(λ(μ-x) + λ²σ²/2), z = ((μ-x) + λσ²) / (√2 σ)
+// E erfc(z) は z > 0 で exp(-(x-μ)²/(2σ²)) erfcx(z) と書き換え、exp のオーバーフローを避ける
+struct EmgModel {
+    static constexpr int NPAR = 4;
+    double operator()(double x, const double* p, double* grad) const {
+        double mu = p[0], gamma = p[1], s = p[2], lam = p[3];
+        if (s == 0 || lam == 0) return 0;
+        double d = mu - x;
+        double z = (d + lam * s * s) / (std::sqrt(2.0) * s);
+        double G = std::exp(-0.5 * d * d / (s * s)); // E exp(-z²)
+        double T = (z > 0) ? G * erfcx(z) : std::exp(lam * d + 0.5 * lam * lam * s * s) * std::erfc(z); // E erfc(z)
+        double f = 0.5 * gamma * lam * T;
+        if (grad) {
+            const double c = 2.0 / std::sqrt(M_PI); // -d erfc(z)/dz = c exp(-z²)
+            double dz_ds = lam / std::sqrt(2.0) - d / (std::sqrt(2.0) * s * s);
+            grad[0] = 0.5 * gamma * lam * (lam * T - c * G / (std::sqrt(2.0) * s));
+            grad[1] = 0.5 * lam * T;
+            grad[2] = 0.5 * gamma * lam * (lam * lam * s * T - c * G * dz_ds);
+            grad[3] = 0.5 * gamma * (T + lam * T * (d + lam * s * s) - lam * c * G * s / std::sqrt(2.0));
+        }
+        return f;
+    }
+};
+
+// --- 2. Levenberg-Marquardt ---
+
+// N×N の連立方程式 A x = b をピボット選択付きの Gauss-Jordan で解き、inv に A^-1 を入れる (特異なら false)
+template <int N>
+bool solve_small(std::array<std::array<double, N>, N> a, std::array<double, N>& b, std::array<std::array<double, N>, N>* inv = nullptr) {
+    std::array<std::array<double, N>, N> e{};
+    for (int i = 0; i < N; ++i) e[i][i] = 1;
+    for (int col = 0; col < N; ++col) {
+        int piv = col;
+        for (int r = col + 1; r < N; ++r) if (std::abs(a[r][col]) > std::abs(a[piv][col])) piv = r;
+        if (!(std::abs(a[piv][col]) > 0)) return false;
+        std::swap(a[col], a[piv]);
+        std::swap(b[col], b[piv]);
+        std::swap(e[col], e[piv]);
+        double d = a[col][col];
+        for (int k = 0; k < N; ++k) { a[col][k] /= d; e[col][k] /= d; }
+        b[col] /= d;
+        for (int r = 0; r < N; ++r) {
+            if (r == col || a[r][col] == 0) continue;
+            double m = a[r][col];
+            for (int k = 0; k < N; ++k) { a[r][k] -= m * a[col][k]; e[r][k] -= m * e[col][k]; }
+            b[r] -= m * b[col];
+        }
+    }
+    if (inv) *inv = e;
+    return true;
+}
+
+/**
+ * @brief model を data に cost でフィットする
+ * @param init 初期値 (Model::NPAR 個)
+ * @param limits パラメータの制限 (空、または Model::NPAR 個)
+ */
+template <class Model>
+FastFitResult fast_fit(const Model& model, const BinnedData& data, FitCost cost, const std::vector<double>& init,
+                       const std::vector<ParLimit>& limits = {}) {
+    constexpr int NP = Model::NPAR;
+    using Mat = std::array<std::array<double, NP>, NP>;
+    using Vec = std::array<double, NP>;
+
+    FastFitResult res;
+    res.par = init;
+    int n_used = 0;
+    for (double n : data.n) if (cost == FitCost::Poisson || n > 0) n_used++;
+    res.ndf = n_used - NP;
+    if (res.ndf <= 0 || static_cast<int>(init.size()) != NP) return res;
+
+    auto clamp = [&](Vec& p) {
+        for (int j = 0; j < NP && j < static_cast<int>(limits.size()); ++j) {
+            if (limits[j].Active()) p[j] = std::min(std::max(p[j], limits[j].lo), limits[j].hi);
+        }
+    };
+    // 目的関数の値と、正規方程式 (J^T W J, J^T W r) を計算する (不正な値なら inf)
+    auto accumulate = [&](const Vec& p, Mat* A, Vec* b) {
+        const double inf = std::numeric_limits<double>::infinity();
+        double c = 0;
+        if (A) { *A = Mat{}; *b = Vec{}; }
+        double g[NP];
+        for (size_t i = 0; i < data.x.size(); ++i) {
+            double n = data.n[i];
+            if (cost == FitCost::Chi2 && n <= 0) continue;
+            double f = model(data.x[i], p.data(), A ? g : nullptr);
+            if (!std::isfinite(f)) return inf;
+            double w;
+            if (cost == FitCost::Chi2) {
+                w = 1.0 / n;
+                c += w * (n - f) * (n - f);
+            } else {
+                if (f <= 0) {
+                    if (n > 0) return inf;
+                    continue;
+                }
+                w = 1.0 / f;
+                c += 2 * (f - n + (n > 0 ? n * std::log(n / f) : 0));
+            }
+            if (A) {
+                for (int j = 0; j < NP; ++j) {
+                    (*b)[j] += w * (n - f) * g[j];
+                    for (int k = 0; k <= j; ++k) (*A)[j][k] += w * g[j] * g[k];
+                }
+            }
+        }
+        if (A) for (int j = 0; j < NP; ++j) for (int k = 0; k < j; ++k) (*A)[k][j] = (*A)[j][k];
+        return c;
+    };
+
+    Vec p;
+    for (int j = 0; j < NP; ++j) p[j] = init[j];
+    clamp(p);
+    Mat A;
+    Vec b;
+    double c = accumulate(p, &A, &b);
+    if (!std::isfinite(c)) return res;
+
+    double lambda = 1e-3;
+    bool converged = false;
+    for (res.n_iter = 0; res.n_iter < 500 && !converged; ++res.n_iter) {
+        Mat M = A;
+        for (int j = 0; j < NP; ++j) M[j][j] += lambda * (A[j][j] > 0 ? A[j][j] : 1.0);
+        Vec step = b;
+        bool solved = solve_small<NP>(M, step);
+        Vec pn = p;
+        if (solved) {
+            for (int j = 0; j < NP; ++j) pn[j] += step[j];
+            clamp(pn);
+        }
+        double cn = solved ? accumulate(pn, nullptr, nullptr) : std::numeric_limits<double>::infinity();
+        if (cn <= c) {
+            converged = (c - cn) <= 1e-12 * (1 + c);
+            p = pn;
+            c = accumulate(p, &A, &b);
+            lambda = std::max(lambda * 0.1, 1e-12);
+        } else {
+            // これ以上下がらない (最小点の数値精度に達した)
+            if (lambda > 1e10) { converged = true; break; }
+            lambda *= 10;
+        }
+    }
+
+    Mat cov;
+    Vec dummy{};
+    if (!converged || !solve_small<NP>(A, dummy, &cov)) return res;
+    res.par.assign(p.begin(), p.end());
+    res.err.resize(NP);
+    for (int j = 0; j < NP; ++j) res.err[j] = cov[j][j] > 0 ? std::sqrt(cov[j][j]) : 0;
+    res.cov.resize(NP * NP);
+    for (int j = 0; j < NP; ++j) for (int k = 0; k < NP; ++k) res.cov[j * NP + k] = cov[j][k];
+    res.chi2 = c;
+    res.valid = true;
+    return res;
+}
+
+// --- 3. 初期値と便利関数 ---
+
+// ガウスの初期値 (面積, 平均, 標準偏差のモーメントから)。内容が無ければ false
+inline bool seed_gaus(const BinnedData& d, std::vector<double>& p) {
+    double sw = 0, sx = 0, sxx = 0;
+    for (size_t i = 0; i < d.x.size(); ++i) {
+        if (d.n[i] <= 0) continue;
+        sw += d.n[i];
+        sx += d.n[i] * d.x[i];
+        sxx += d.n[i] * d.x[i] * d.x[i];
+    }
+    if (sw <= 0) return false;
+    double mean = sx / sw;
+    double var = sxx / sw - mean * mean;
+    double sigma = var > 0 ? std::sqrt(var) : 0.5 * d.width;
+    p = {sw * d.width / (std::sqrt(2 * M_PI) * sigma), mean, sigma};
+    return true;
+}
+
+// モーメントから初期値を決めてガウスをフィットする (sigma は絶対値で返す)
+inline FastFitResult fast_fit_gaus(const BinnedData& d, FitCost cost) {
+    std::vector<double> p;
+    if (!seed_gaus(d, p)) return FastFitResult();
+    FastFitResult r = fast_fit(GausModel(), d, cost, p);
+    if (r.valid) r.par[2] = std::abs(r.par[2]);
+    return r;
+}
+
+#endif // FAST_BINNED_FIT_H
@@ -0,0 +1,468 @@
+/*
+ * id: fit_result_store.h
+ * Place: ~/hkelec/DiscreteSoftware/Analysis/macro/fit_results/
+ * Last Edit: 2026-10-18 Gemini
+ *
+ * 概要: フィット結果の保存形式 (fit result store) と、下流のツールが共通で使う読み込み。
+ * 1. フィットの種類 (kind: "gaus", "peak", "mean", "time", "charge" など) ごとに1つの表 (FitTable)。
+ *    列には型 (i: 整数, d: 実数, s: 文字列) があり、値は列ごとの配列に持つ。
+ * 2. 表の行は (run, ch, type, voltage, position) で引ける (FitKey)。
+ *    run      : eventhist のファイル名から _eventhist.root を除いたもの
+ *    position : eventhist のあるディレクトリ名 (測定条件・位置ごとのディレクトリ)
+ * 3. ファイル形式 (<run>_<kind>.fitres, フィッターが入力ファイルごとに書く):
+ *      #fitstore version=1 kind=gaus
+ *      #columns run:s,ch:i,type:s,voltage:d,position:s,status:s,entries:d,peak:d,...,root_file:s
+ *      <CSV の行>
+ *    version が FIT_STORE_VERSION より新しいファイルは読まない。
+ * 4. 従来の txt (_gausfit.txt, _mean.txt, _timefit.txt, 各種サマリー, Charge_vs_*.csv) も読める。
+ *    列は1行目のヘッダーの名前で決める (列数による判別はしない)。名前の "(...)" は除く
+ *    ("peak(calc)" -> "peak", "tts(fwhm)" -> "tts")。STRING_COLUMNS 以外の列は実数として読み、読めない値は NaN。
+ *    ヘッダーより値が1つ多い行の行末はヒストグラムファイル名 (root_file) として読む (gausfit の従来の出力)。
+ * コンパイル不要 (ヘッダーファイル)
+ */
+#ifndef FIT_RESULT_STORE_H
+#define FIT_RESULT_STORE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+const int FIT_STORE_VERSION = 1;
+const char* const FIT_STORE_EXT = ".fitres";
+
+// 従来の txt で文字列として読む列
+const std::vector<std::string> STRING_COLUMNS = {"run", "type", "position", "status", "root_file", "key", "method", "graph_type"};
+
+// 表の行を引くキー
+struct FitKey {
+    std::string run;
+    int ch = -1;
+    std::string type;
+    double voltage = -1;
+    std::string position;
+
+    bool operator<(const FitKey& o) const {
+        return std::tie(run, ch, type, voltage, position) < std::tie(o.run, o.ch, o.type, o.voltage, o.position);
+    }
+};
+
+// ファイル名から run 名を作る (ディレクトリと _eventhist.root / .root / _<kind>.fitres / _<suffix>.txt を除く)
+inline std::string fit_store_run_name(const std::string& path) {
+    std::string name = std::filesystem::path(path).filename().string();
+    auto strip = [&](const std::string& suffix) {
+        if (name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+            name.resize(name.size() - suffix.size());
+            return true;
+        }
+        return false;
+    };
+    if (strip("_eventhist.root") || strip(".root")) return name;
+    if (strip(FIT_STORE_EXT) || strip(".txt") || strip(".csv")) {
+        size_t us = name.find_last_of('_');
+        if (us != std::string::npos) name.resize(us);
+    }
+    return name;
+}
+
+// ファイルのあるディレクトリ名 (position)
+inline std::string fit_store_position(const std::string& path) {
+    return std::filesystem::path(path).parent_path().filename().string();
+}
+
+// ファイル名の "<数字>V" から電圧を取る (無ければ -1)
+inline double fit_store_voltage(const std::string& path) {
+    std::smatch match;
+    std::string name = std::filesystem::path(path).filename().string();
+    if (std::regex_search(name, match, std::regex("(\\d+)V"))) return std::stod(match.str(1));
+    return -1.0;
+}
+
+class FitTable {
+public:
+    enum Type { Int = 'i', Double = 'd', String = 's' };
+    struct Column {
+        std::string name;
+        Type type;
+    };
+
+    FitTable() = default;
+    explicit FitTable(const std::string& kind) : kind_(kind) {}
+
+    /**
+     * @brief フィッターが書く表の列を作る: run,ch,type,voltage,position,status,entries,<value_columns>,root_file
+     */
+    static FitTable MakeFitTable(const std::string& kind, const std::vector<std::string>& value_columns) {
+        FitTable t(kind);
+        for (const char* c : {"run", "ch", "type", "voltage", "position", "status", "entries"}) {
+            std::string n = c;
+            t.AddColumn(n, n == "ch" ? Int : (IsStringName(n) ? String : Double));
+        }
+        for (const auto& c : value_columns) t.AddColumn(c, Double);
+        t.AddColumn("root_file", String);
+        return t;
+    }
+
+    // フィッター以外が書く表 (hv_gain_table.h のゲイン表など) の列を作る
+    static FitTable MakeTable(const std::string& kind, const std::vector<Column>& columns) {
+        FitTable t(kind);
+        for (const auto& c : columns) t.AddColumn(c.name, c.type);
+        return t;
+    }
+
+    const std::string& Kind() const { return kind_; }
+    int Version() const { return version_; }
+    size_t Rows() const { return n_rows_; }
+    const std::vector<Column>& Columns() const { return columns_; }
+
+    // 列番号 (無ければ -1)
+    int Col(const std::string& name) const {
+        for (size_t i = 0; i < columns_.size(); ++i) {
+            if (columns_[i].name == name) return static_cast<int>(i);
+        }
+        return -1;
+    }
+    bool Has(const std::string& name) const { return Col(name) >= 0; }
+
+    // 値 (列が無い・文字列の列なら NaN / 空文字列)
+    double Num(size_t row, int col) const {
+        if (col < 0 || columns_[col].type == String) return std::numeric_limits<double>::quiet_NaN();
+        return num_[slot_[col]][row];
+    }
+    double Num(size_t row, const std::string& name) const { return Num(row, Col(name)); }
+    const std::string& Str(size_t row, int col) const {
+        static const std::string empty;
+        if (col < 0 || columns_[col].type != String) return empty;
+        return str_[slot_[col]][row];
+    }
+    const std::string& Str(size_t row, const std::string& name) const { return Str(row, Col(name)); }
+
+    // status 列が無い (従来の txt は成功した結果だけを書く) か "ok" なら true
+    bool IsOk(size_t row) const {
+        int c = Col("status");
+        return c < 0 || Str(row, c) == "ok";
+    }
+
+    FitKey Key(size_t row) const {
+        FitKey k;
+        k.run = Str(row, "run");
+        double ch = Num(row, "ch");
+        k.ch = std::isnan(ch) ? -1 : static_cast<int>(ch);
+        k.type = Str(row, "type");
+        double v = Num(row, "voltage");
+        k.voltage = std::isnan(v) ? -1 : v;
+        k.position = Str(row, "position");
+        return k;
+    }
+
+    // キーの行番号 (無ければ -1)。同じキーが複数あれば後の行
+    long Find(const FitKey& key) const {
+        if (index_rows_ != n_rows_) {
+            index_.clear();
+            for (size_t r = 0; r < n_rows_; ++r) index_[Key(r)] = static_cast<long>(r);
+            index_rows_ = n_rows_;
+        }
+        auto it = index_.find(key);
+        return it == index_.end() ? -1 : it->second;
+    }
+
+    /**
+     * @brief 1行追加する。文字列の列の値は text に、それ以外は num に列名で渡す (無い列は NaN / 空文字列)
+     */
+    void AddRow(const std::map<std::string, double>& num, const std::map<std::string, std::string>& text) {
+        for (size_t c = 0; c < columns_.size(); ++c) {
+            if (columns_[c].type == String) {
+                auto it = text.find(columns_[c].name);
+                str_[slot_[c]].push_back(it == text.end() ? "" : it->second);
+            } else {
+                auto it = num.find(columns_[c].name);
+                num_[slot_[c]].push_back(it == num.end() ? std::numeric_limits<double>::quiet_NaN() : it->second);
+            }
+        }
+        n_rows_++;
+    }
+
+    // 別の表の行を追加する (列は名前で合わせ、こちらに無い列は追加する)
+    void Append(const FitTable& o) {
+        for (const auto& c : o.columns_) {
+            if (!Has(c.name)) AddColumn(c.name, c.type);
+        }
+        for (size_t c = 0; c < columns_.size(); ++c) {
+            int oc = o.Col(columns_[c].name);
+            for (size_t r = 0; r < o.n_rows_; ++r) {
+                if (columns_[c].type == String) str_[slot_[c]].push_back(o.Str(r, oc));
+                else num_[slot_[c]].push_back(o.Num(r, oc));
+            }
+        }
+        n_rows_ += o.n_rows_;
+    }
+
+    bool Write(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out) return false;
+        out << "#fitstore version=" << FIT_STORE_VERSION << " kind=" << kind_ << std::endl;
+        out << "#columns ";
+        for (size_t c = 0; c < columns_.size(); ++c) out << (c ? "," : "") << columns_[c].name << ":" << static_cast<char>(columns_[c].type);
+        out << std::endl;
+        out.precision(std::numeric_limits<double>::max_digits10);
+        for (size_t r = 0; r < n_rows_; ++r) {
+            for (size_t c = 0; c < columns_.size(); ++c) {
+                if (c) out << ",";
+                if (columns_[c].type == String) out << str_[slot_[c]][r];
+                else if (columns_[c].type == Int) out << static_cast<long long>(num_[slot_[c]][r]);
+                else out << num_[slot_[c]][r];
+            }
+            out << "\n";
+        }
+        return static_cast<bool>(out);
+    }
+
+    /**
+     * @brief 表を読む (.fitres、または1行目がヘッダーの従来の txt / csv)
+     * 従来の txt で run / voltage / position の列が無ければ、root_file 列 (無ければ path) のファイル名から補う。
+     * kind は従来の txt の場合の表の種類 (.fitres ではファイルに書かれたものを使う)。
+     */
+    static bool Load(const std::string& path, FitTable& t, const std::string& kind = "") {
+        std::ifstream in(path);
+        if (!in) return false;
+        t = FitTable(kind);
+        std::string line;
+        if (!std::getline(in, line)) return false;
+
+        bool store = line.rfind("#fitstore", 0) == 0;
+        if (store) {
+            std::smatch m;
+            if (std::regex_search(line, m, std::regex("version=(\\d+)"))) t.version_ = std::stoi(m.str(1));
+            if (std::regex_search(line, m, std::regex("kind=(\\S+)"))) t.kind_ = m.str(1);
+            if (t.version_ > FIT_STORE_VERSION) {
+                std::cerr << "エラー: " << path << " は新しい形式 (version " << t.version_ << ") です" << std::endl;
+                return false;
+            }
+            if (!std::getline(in, line) || line.rfind("#columns ", 0) != 0) return false;
+            for (const auto& spec : Split(line.substr(9))) {
+                size_t colon = spec.rfind(':');
+                if (colon == std::string::npos) return false;
+                t.AddColumn(spec.substr(0, colon), static_cast<Type>(spec[colon + 1]));
+            }
+        } else {
+            t.version_ = 0;
+            size_t start = line.find_first_not_of("# ");
+            for (auto name : Split(start == std::string::npos ? "" : line.substr(start))) {
+                name = NormalizeName(name);
+                t.AddColumn(name, IsStringName(name) ? String : Double);
+            }
+            if (t.columns_.empty()) return false;
+        }
+
+        // 従来の txt (gausfit / peakfinder の _gausfit.txt, _mean.txt とそれを cat したサマリー) は
+        // ヘッダーに無いヒストグラムファイル名を行末に書いている: ヘッダーより1つ多い行末の値は root_file として読む
+        const size_t n_header = t.columns_.size();
+        int c_trailing = -1;
+        long n_mismatch = 0;
+        while (std::getline(in, line)) {
+            if (line.empty() || line[0] == '#' || line == "\r") continue;
+            std::vector<std::string> fields = Split(line);
+            if (!store && fields.size() == n_header + 1) {
+                if (c_trailing < 0) {
+                    c_trailing = t.Col("root_file");
+                    if (c_trailing < 0) {
+                        t.AddColumn("root_file", String);
+                        c_trailing = t.Col("root_file");
+                    }
+                }
+                if (static_cast<size_t>(c_trailing) < n_header) n_mismatch++;
+                else fields[c_trailing] = fields[n_header];
+            } else if (fields.size() != n_header) {
+                n_mismatch++;
+            }
+            for (size_t c = 0; c < t.columns_.size(); ++c) {
+                std::string f = c < fields.size() ? Trim(fields[c]) : "";
+                if (c >= n_header && static_cast<int>(c) != c_trailing) f = "";
+                if (t.columns_[c].type == String) t.str_[t.slot_[c]].push_back(f);
+                else t.num_[t.slot_[c]].push_back(ParseNumber(f));
+            }
+            t.n_rows_++;
+        }
+        if (n_mismatch > 0) {
+            std::cerr << "警告: " << path << " の " << n_mismatch << " 行は値の数がヘッダーの列数 (" << n_header
+                      << ") と合いません (足りない値は空、余分な値は読みません)" << std::endl;
+        }
+        if (!store) t.FillLegacyKeys(path);
+        return true;
+    }
+
+private:
+    static bool IsStringName(const std::string& name) {
+        return std::find(STRING_COLUMNS.begin(), STRING_COLUMNS.end(), name) != STRING_COLUMNS.end();
+    }
+
+    static std::string Trim(const std::string& s) {
+        size_t b = s.find_first_not_of(" \t\r");
+        size_t e = s.find_last_not_of(" \t\r");
+        return b == std::string::npos ? "" : s.substr(b, e - b + 1);
+    }
+
+    // "peak(calc)" -> "peak"
+    static std::string NormalizeName(const std::string& s) {
+        std::string n = Trim(s);
+        size_t p = n.find('(');
+        if (p != std::string::npos && p > 0) n = Trim(n.substr(0, p));
+        return n;
+    }
+
+    static std::vector<std::string> Split(const std::string& line) {
+        std::vector<std::string> out;
+        std::stringstream ss(line);
+        std::string item;
+        while (std::getline(ss, item, ',')) out.push_back(item);
+        return out;
+    }
+
+    static double ParseNumber(const std::string& s) {
+        if (s.empty()) return std::numeric_limits<double>::quiet_NaN();
+        char* end = nullptr;
+        double v = std::strtod(s.c_str(), &end);
+        return (end && *end == '\0') ? v : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    void AddColumn(const std::string& name, Type type) {
+        columns_.push_back({name, type});
+        if (type == String) {
+            slot_.push_back(str_.size());
+            str_.emplace_back(n_rows_);
+        } else {
+            slot_.push_back(num_.size());
+            num_.emplace_back(n_rows_, std::numeric_limits<double>::quiet_NaN());
+        }
+    }
+
+    // 従来の txt に無いキーの列を行ごとの root_file 列 (無ければ表のファイル名) から補う
+    // (cat したサマリーでは行ごとに run / position が違う。root_file にディレクトリが無ければ position は表のディレクトリ)
+    void FillLegacyKeys(const std::string& path) {
+        bool has_run = Has("run"), has_voltage = Has("voltage"), has_position = Has("position");
+        if (!has_run) AddColumn("run", String);
+        if (!has_voltage) AddColumn("voltage", Double);
+        if (!has_position) AddColumn("position", String);
+        int c_file = Col("root_file");
+        for (size_t r = 0; r < n_rows_; ++r) {
+            const std::string& file = (c_file >= 0 && !Str(r, c_file).empty()) ? Str(r, c_file) : path;
+            if (!has_run) str_[slot_[Col("run")]][r] = fit_store_run_name(file);
+            if (!has_voltage) num_[slot_[Col("voltage")]][r] = fit_store_voltage(file);
+            if (!has_position) {
+                std::string pos = fit_store_position(file);
+                str_[slot_[Col("position")]][r] = pos.empty() ? fit_store_position(path) : pos;
+            }
+        }
+    }
+
+    std::string kind_;
+    int version_ = FIT_STORE_VERSION;
+    std::vector<Column> columns_;
+    std::vector<size_t> slot_;                    // 列 -> num_ / str_ のインデックス
+    std::vector<std::vector<double>> num_;
+    std::vector<std::vector<std::string>> str_;
+    size_t n_rows_ = 0;
+    mutable std::map<FitKey, long> index_;        // Find() で作る
+    mutable size_t index_rows_ = static_cast<size_t>(-1);
+};
+
+/**
+ * @brief 種類ごとの表の集まり。ディレクトリの *.fitres をまとめて読む
+ */
+class FitResultStore {
+public:
+    // 1ファイルを読んで、その種類の表に追加する
+    bool LoadFile(const std::string& path, const std::string& legacy_kind = "") {
+        FitTable t;
+        if (!FitTable::Load(path, t, legacy_kind)) {
+            std::cerr << "警告: フィット結果 " << path << " を読めません" << std::endl;
+            return false;
+        }
+        auto it = tables_.find(t.Kind());
+        if (it == tables_.end()) tables_.emplace(t.Kind(), std::move(t));
+        else it->second.Append(t);
+        return true;
+    }
+
+    /**
+     * @brief ディレクトリの *.fitres を全て読む (ファイル名順)
+     * legacy (種類 -> 従来の txt の接尾辞, 例: {"time", "_timefit.txt"}) を渡すと、
+     * .fitres に無い種類は従来の txt から読む (古い解析結果のディレクトリ用)。読んだファイル数を返す
+     */
+    int LoadDir(const std::string& dir, const std::map<std::string, std::string>& legacy = {}) {
+        std::vector<std::string> store_files, text_files;
+        std::error_code ec;
+        for (const auto& e : std::filesystem::directory_iterator(dir, ec)) {
+            std::string p = e.path().string();
+            if (e.path().extension() == FIT_STORE_EXT) store_files.push_back(p);
+            else if (e.path().extension() == ".txt") text_files.push_back(p);
+        }
+        if (ec) {
+            std::cerr << "エラー: ディレクトリ " << dir << " を開けません" << std::endl;
+            return 0;
+        }
+        std::sort(store_files.begin(), store_files.end());
+        std::sort(text_files.begin(), text_files.end());
+
+        int n = 0;
+        for (const auto& p : store_files) n += LoadFile(p) ? 1 : 0;
+        for (auto const& [kind, suffix] : legacy) {
+            if (Has(kind)) continue;
+            for (const auto& p : text_files) {
+                if (p.size() > suffix.size() && p.compare(p.size() - suffix.size(), suffix.size(), suffix) == 0) {
+                    n += LoadFile(p, kind) ? 1 : 0;
+                }
+            }
+        }
+        return n;
+    }
+
+    bool Has(const std::string& kind) const { return tables_.count(kind) > 0; }
+
+    // 種類の表 (無ければ空の表)
+    const FitTable& Table(const std::string& kind) const {
+        static const FitTable empty;
+        auto it = tables_.find(kind);
+        return it == tables_.end() ? empty : it->second;
+    }
+
+private:
+    std::map<std::string, FitTable> tables_;
+};
+
+/**
+ * @brief 下流のツール用: path がディレクトリならその *.fitres の kind の表、ファイルならそのファイルの表
+ */
+inline FitTable load_fit_table(const std::string& path, const std::string& kind) {
+    FitTable t(kind);
+    if (std::filesystem::is_directory(path)) {
+        FitResultStore store;
+        store.LoadDir(path);
+        if (!store.Has(kind)) std::cerr << "警告: " << path << " に " << kind << " のフィット結果 (*" << FIT_STORE_EXT << ") がありません" << std::endl;
+        t = store.Table(kind);
+    } else if (!FitTable::Load(path, t, kind)) {
+        std::cerr << "エラー: フィット結果 " << path << " を開けません" << std::endl;
+    }
+    return t;
+}
+
+/**
+ * @brief 電荷の表の値と誤差の列名: gaus -> (peak, peak_err), mean -> (mean, mean_err), peak -> (peak_pos, 誤差なし "")
+ */
+inline std::pair<std::string, std::string> charge_value_columns(const FitTable& t) {
+    if (t.Has("peak")) return {"peak", "peak_err"};
+    if (t.Has("mean")) return {"mean", "mean_err"};
+    return {"peak_pos", ""};
+}
+
+#endif // FIT_RESULT_STORE_H
@@ -0,0 +1,167 @@
+/*
+ * id: fit_strategy.h
+ * Place: ~/hkelec/DiscreteSoftware/Analysis/macro/fit_results/
+ * Last Edit: 2026-10-18 Gemini
+ *
+ * 概要: フィットの品質判定と再試行 (hist_fit_engine.h の gaus / time から使う)。
+ * 1回のフィット (試行) の結果を FitQuality (有効か, χ²/ndf, パラメータが制限に張り付いていないか) で判定し、
+ * 基準 (FitCriteria) を満たさなければ次の試行 (ヒストグラムのモーメントから安く計算した別の初期値・範囲) に進む。
+ * 基準を満たした時点で打ち切る。どの試行も満たさなければ、有効な試行のうち χ²/ndf が最小のものを使う。
+ * 最初の試行は従来のフィットそのままなので、基準を満たすヒストグラムの結果は変わらない。
+ * 試行回数と基準を満たしたかは FitJobStats に記録する (エンジンがジョブごとの CPU 時間と一緒にサマリーに書く)。
+ * コンパイル不要 (ヘッダーファイル)
+ */
+#ifndef FIT_STRATEGY_H
+#define FIT_STRATEGY_H
+
+#include <TH1.h>
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <functional>
+#include <limits>
+#include <vector>
+
+// --- 1. ヒストグラムのモーメント (初期値と範囲の候補を作るのに使う。ビンを1回なめるだけ) ---
+
+struct HistMoments {
+    double integral = 0;     // [xmin, xmax] の内容の和
+    double bin_width = 1;
+    double mean = 0, rms = 0, skew = 0;
+    double peak_x = 0;       // 最大ビンの中心
+    double peak_height = 0;  // 最大ビンの内容
+    double fwhm = 0;         // 最大ビンから左右に半値を下回るまで歩いた幅 (線形補間)
+    double SigmaHM() const { return fwhm > 0 ? fwhm / 2.3548 : rms; } // 半値幅から換算したガウスの σ
+};
+
+// ビン中心が [xmin, xmax] に入るビンのモーメント
+inline HistMoments hist_moments(const TH1& hist, double xmin, double xmax) {
+    HistMoments m;
+    const TAxis* axis = hist.GetXaxis();
+    int first = -1, last = -1, imax = -1;
+    double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (int i = 1; i <= hist.GetNbinsX(); ++i) {
+        double x = axis->GetBinCenter(i);
+        if (x < xmin || x > xmax) continue;
+        if (first < 0) { first = i; m.bin_width = axis->GetBinWidth(i); }
+        last = i;
+        double n = hist.GetBinContent(i);
+        if (imax < 0 || n > m.peak_height) { imax = i; m.peak_height = n; }
+        if (n <= 0) continue;
+        s0 += n; s1 += n * x; s2 += n * x * x; s3 += n * x * x * x;
+    }
+    if (s0 <= 0) return m;
+    m.integral = s0;
+    m.mean = s1 / s0;
+    double var = std::max(0.0, s2 / s0 - m.mean * m.mean);
+    m.rms = std::sqrt(var);
+    if (m.rms > 0) m.skew = (s3 / s0 - 3 * m.mean * var - m.mean * m.mean * m.mean) / (var * m.rms);
+    m.peak_x = axis->GetBinCenter(imax);
+
+    double half = 0.5 * m.peak_height;
+    auto edge = [&](int step) {
+        for (int i = imax; i + step >= first && i + step <= last; i += step) {
+            double a = hist.GetBinContent(i), b = hist.GetBinContent(i + step);
+            if (b < half) {
+                double xa = axis->GetBinCenter(i), xb = axis->GetBinCenter(i + step);
+                return xa + (xb - xa) * (a - half) / (a - b);
+            }
+        }
+        return axis->GetBinCenter(step > 0 ? last : first);
+    };
+    m.fwhm = edge(+1) - edge(-1);
+    return m;
+}
+
+/**
+ * @brief EMG (μ, γ, σ, λ) の初期値をモーメントから決める
+ * EMG の歪度 γ1 = 2τ³/(σ²+τ²)^(3/2) から τ を求め、σ² = rms² - τ², μ = mean - τ。
+ * γ は面積 (hist_fit_engine.h の EMG は γ 倍の確率密度なので 内容の和 × ビン幅)。
+ */
+inline std::vector<double> emg_seed_from_moments(const HistMoments& m) {
+    double g = std::min(std::max(m.skew, 0.05), 1.9) / 2;
+    double tau = m.rms * std::cbrt(g);
+    double sigma = m.rms * std::sqrt(std::max(1 - std::pow(g, 2.0 / 3.0), 0.05));
+    return {m.mean - tau, m.integral * m.bin_width, sigma, tau > 1e-9 ? 1 / tau : 1.0};
+}
+
+// --- 2. 品質の判定 ---
+
+struct FitQuality {
+    bool valid = false;       // フィットが収束し、結果が物理的に意味を持つ (σ > 0 など)
+    double chi2_ndf = std::numeric_limits<double>::infinity();
+    bool at_limit = false;    // 制限付きパラメータが制限に張り付いている
+};
+
+struct FitCriteria {
+    double max_chi2_ndf = 5.0;     // これより大きい χ²/ndf は外れ値とみなす
+    double limit_margin = 1e-3;    // 制限の幅に対してこの割合より端に近ければ「張り付いている」
+
+    bool Accept(const FitQuality& q) const { return q.valid && !q.at_limit && q.chi2_ndf <= max_chi2_ndf; }
+};
+
+// value が [lo, hi] の端から margin * (hi - lo) 以内なら true (lo >= hi は制限なし)
+inline bool near_limit(double value, double lo, double hi, double margin) {
+    if (lo >= hi) return false;
+    double d = margin * (hi - lo);
+    return value <= lo + d || value >= hi - d;
+}
+
+// --- 3. 再試行 ---
+
+// 1ジョブの試行の記録 (スレッドごとに1つ。エンジンがジョブの前に Reset する)
+struct FitJobStats {
+    int attempts = 0;
+    bool criteria_met = false;
+    void Reset() { attempts = 0; criteria_met = false; }
+};
+
+// 1回の試行: 結果の値を v に詰めて品質を返す
+using FitAttempt = std::function<FitQuality(std::vector<double>& v)>;
+
+/**
+ * @brief 試行を順に行い、基準を満たした時点で打ち切る
+ * どれも満たさなければ有効な試行のうち χ²/ndf が最小のものの値を v に入れる (無ければ false)。
+ * rerun_best: 最小の試行が最後の試行でなければ、それをもう1回行う
+ *             (TH1::Fit はヒストグラムにフィット関数を付けるので、PDF に使った試行の関数を残すため)。
+ */
+inline bool run_fit_strategy(const std::vector<FitAttempt>& attempts, const FitCriteria& criteria, FitJobStats& stats,
+                             std::vector<double>& v, bool rerun_best = false) {
+    int best = -1;
+    FitQuality best_q;
+    std::vector<double> best_v;
+    for (size_t i = 0; i < attempts.size(); ++i) {
+        std::vector<double> cand(v.size(), std::numeric_limits<double>::quiet_NaN());
+        stats.attempts++;
+        FitQuality q = attempts[i](cand);
+        if (criteria.Accept(q)) {
+            v = cand;
+            stats.criteria_met = true;
+            return true;
+        }
+        // 張り付いた試行は、張り付いていない試行より後回し
+        if (q.valid && (best < 0 || (best_q.at_limit && !q.at_limit) ||
+                        (best_q.at_limit == q.at_limit && q.chi2_ndf < best_q.chi2_ndf))) {
+            best = static_cast<int>(i);
+            best_q = q;
+            best_v = cand;
+        }
+    }
+    if (best < 0) return false;
+    if (rerun_best && best != static_cast<int>(attempts.size()) - 1) {
+        stats.attempts++;
+        attempts[best](best_v);
+    }
+    v = best_v;
+    return true;
+}
+
+// このスレッドが使った CPU 時間 [s] (ジョブごとの CPU 時間の記録用)
+inline double thread_cpu_seconds() {
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0;
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+#endif // FIT_STRATEGY_H
@@ -0,0 +1,892 @@
+/*
+ * id: hist_fit_engine.h
+ * Place: ~/hkelec/DiscreteSoftware/Analysis/macro/fit_results/
+ * Last Edit: 2026-10-18 Gemini
+ *
+ * 概要: gausfit / peakfinder / meanfinder (macro/fit_results と reconst/macros/cpp) で共通の
+ * ヒストグラムフィットエンジン。
+ * 1. 複数の _eventhist.root から、登録した手法 (FitMethod) が使う h_<type>_ch<N> を全て読み込む。
+ * 2. (ファイル, ch, type, 手法) ごとのジョブをスレッドプールで処理する。
+ *    ジョブごとにヒストグラムを複製し、TF1 はスレッドごとに1つずつ作って使い回す
+ *    (名前にスレッド番号を付けるので "f_prefit" などの同名 TF1 が衝突しない)。
+ * 3. 結果を1つの列形式サマリー (WriteSummary)、手法ごとの結果の表 (WriteStore, fit_result_store.h) と、
+ *    従来のファイルごとの txt (WriteLegacy) に書き出す。
+ * 結果はジョブ順 (ファイル → 手法 → ch → type) に並ぶので、スレッド数によらず出力の順番は同じ。
+ * 2 スレッド以上では TMinuit (スレッドセーフでない) の代わりに Minuit2 を使う。
+ * gaus / time は TH1::Fit の代わりに fast_binned_fit.h の専用フィッターも選べる (FitterKind)。
+ * gaus / time は品質の基準を満たさなければ別の初期値・範囲で再試行する (fit_strategy.h)。
+ * ジョブごとの試行回数と CPU 時間はサマリーと結果の表の attempts, criteria_met, cpu_ms 列に書く。
+ * PDF (EnablePdf) はフィットの終わったジョブから描画のスレッドに渡し、(入力, 手法) ごとの複数ページ PDF
+ * <run>_<手法>_fit.pdf に書く (plot_output.h)。PDF を作らない時は描画のスレッドも TCanvas も作らない。
+ * コンパイル不要 (ヘッダーファイル)
+ */
+#ifndef HIST_FIT_ENGINE_H
+#define HIST_FIT_ENGINE_H
+
+#include <TDirectory.h>
+#include <TF1.h>
+#include <TFile.h>
+#include <TFitResult.h>
+#include <TFitResultPtr.h>
+#include <TH1D.h>
+#include <TList.h>
+#include <TMath.h>
+#include <TMatrixDSym.h>
+#include <TROOT.h>
+#include <TString.h>
+#include <TStyle.h>
+#include <Math/MinimizerOptions.h>
+#include "emg_math.h"
+#include "fast_binned_fit.h"
+#include "fit_result_store.h"
+#include "fit_strategy.h"
+#include "plot_output.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// --- 1. 共通のユーティリティ関数 (ttshistofit.C より) ---
+
+// EMG (Exponentially Modified Gaussian) 関数
+// par[0]: #mu (ガウス中心), par[1]: #gamma (振幅スケール), par[2]: #sigma (ガウス幅), par[3]: #lambda (1/tau)
+inline Double_t EMG(Double_t *x, Double_t *par)
+{
+    if (par[2] == 0) return 0; // sigmaが0
+    if (par[3] == 0) return 0; // lambdaが0
+    return 0.5*par[3]*exp(0.5*par[3]*(2*par[0]+par[3]*par[2]*par[2]-2.*x[0]))
+           *TMath::Erfc((par[0]+par[3]*par[2]*par[2]-x[0])/(sqrt(2.)*par[2]))*par[1];
+}
+
+// EMG 関数 (パラメータは上の EMG の順) の mode と FWHM (emg_math.h。数値的な GetMaximumX / GetX を使わない)
+inline EmgShape GetEmgShape(TF1 *f)
+{
+    if (!f) return EmgShape();
+    return emg_shape(f->GetParameter(0), f->GetParameter(2), f->GetParameter(3));
+}
+
+// EMG関数の FWHM (半値全幅)
+inline Double_t GetFWHM(TF1 *f)
+{
+    return GetEmgShape(f).fwhm;
+}
+
+// EMG関数の最大値の位置 (mode)。以前の μ + σ²λ は λσ が小さい時の近似で、最大値の位置とはずれる
+inline Double_t GetPeak(TF1 *f)
+{
+    return GetEmgShape(f).mode;
+}
+
+// ファイル名の "<数字>V" から電圧を取得 (無ければ -1)
+inline double get_voltage_from_filename(const std::string& filename) {
+    std::regex re("(\\d+)V");
+    std::smatch match;
+    if (std::regex_search(filename, match, re) && match.size() > 1) {
+        return std::stod(match.str(1));
+    }
+    return -1.0;
+}
+
+// <input>_eventhist.root → <input><suffix> (入力が _eventhist.root で終わらない場合も入力を上書きしない)
+inline std::string replace_eventhist_suffix(const std::string& input, const std::string& suffix) {
+    TString name = input.c_str();
+    if (name.EndsWith("_eventhist.root")) return name.ReplaceAll("_eventhist.root", suffix.c_str()).Data();
+    std::string base = input;
+    if (name.EndsWith(".root")) base = input.substr(0, input.size() - 5);
+    return base + suffix;
+}
+
+// --- 2. スレッドごとのフィット関数 ---
+
+/**
+ * @brief 1スレッド分の TF1 置き場
+ * tag ごとに1つだけ作り、ジョブごとに範囲・パラメータ・誤差・制限を初期化して使い回す。
+ * (パラメータの誤差は Minuit の初期ステップに使われるので、前のジョブの値を残さない)
+ * TF1 の生成・破棄は gROOT の関数リストを触るので、全スレッド共通の mutex で保護する。
+ * 実行中のジョブの試行の記録 (FitJobStats) もここに置く (エンジンがジョブごとに Reset する)。
+ */
+class FitFunctions {
+public:
+    explicit FitFunctions(int thread_id) : id_(thread_id) {}
+    ~FitFunctions() {
+        std::lock_guard<std::mutex> lock(Mutex());
+        funcs_.clear();
+    }
+    FitFunctions(const FitFunctions&) = delete;
+    FitFunctions& operator=(const FitFunctions&) = delete;
+
+    int ThreadId() const { return id_; }
+    FitJobStats& Stats() { return stats_; }
+
+    // "gaus" 式の TF1
+    TF1* Gaus(const std::string& tag, double xmin, double xmax) {
+        return Get(tag, xmin, xmax, [](const char* name) { return new TF1(name, "gaus", 0, 1); });
+    }
+    // EMG (4 パラメータ) の TF1
+    TF1* Emg(const std::string& tag, double xmin, double xmax) {
+        return Get(tag, xmin, xmax, [](const char* name) { return new TF1(name, EMG, 0, 1, 4); });
+    }
+
+    // TF1 の生成・破棄を保護する mutex (PDF の描画のスレッドが pdf_style で TF1 を作る時も使う)
+    static std::mutex& Mutex() { static std::mutex m; return m; }
+
+private:
+    TF1* Get(const std::string& tag, double xmin, double xmax, const std::function<TF1*(const char*)>& make) {
+        auto& f = funcs_[tag];
+        if (!f) {
+            std::lock_guard<std::mutex> lock(Mutex());
+            f.reset(make(Form("%s_t%d", tag.c_str(), id_)));
+        }
+        int npar = f->GetNpar();
+        std::vector<double> zero(npar, 0.0);
+        for (int i = 0; i < npar; ++i) f->ReleaseParameter(i);
+        f->SetParameters(zero.data());
+        f->SetParErrors(zero.data());
+        f->SetRange(xmin, xmax);
+        return f.get();
+    }
+
+    int id_;
+    std::map<std::string, std::unique_ptr<TF1>> funcs_;
+    FitJobStats stats_;
+};
+
+// --- 3. 手法とジョブ ---
+
+/**
+ * @brief 1つのフィット手法
+ * fit は1つのヒストグラムから columns の順に値を詰め、結果が使えるなら true を返す。
+ * columns の後ろに PDF の描画用の値 (フィット関数のパラメータなど) を追加してもよい (txt には出力しない)。
+ * fit は複数のスレッドから同時に呼ばれる (ヒストグラムはジョブごとの複製、TF1 は FitFunctions から取る)。
+ */
+struct FitMethod {
+    std::string name;                       // サマリーの method 列 ("gaus", "peak", "mean", "time" など)
+    std::vector<std::string> types;         // 対象のヒストグラム h_<type>_ch<N>
+    double min_entries = 1;                 // これ未満のエントリー数のヒストグラムはフィットしない
+    std::vector<std::string> columns;       // 結果の列名
+    std::function<bool(TH1D&, FitFunctions&, std::vector<double>&)> fit;
+
+    // 従来のファイルごとの txt (legacy_suffix が空なら書かない)
+    std::string legacy_suffix;              // 例: "_gausfit.txt"
+    std::string legacy_header;              // 1行目 ("# ch,type,..." )
+    bool legacy_type_voltage = true;        // 行頭を "ch,type,voltage" にする (false なら "ch" のみ)
+    bool legacy_file = false;               // 行末に ROOT ファイル名を付ける
+    std::string legacy_message;             // 書き込み後の表示 (例: "Charge fit completed. -> ")
+
+    // PDF の描画設定 (gStyle, 表示範囲。引数はヒストグラムと結果の値)。空なら PDF を作らない
+    std::function<void(TH1D&, const std::vector<double>&)> pdf_style;
+};
+
+// 1ジョブ (ファイル, ch, type, 手法) の結果
+struct FitRecord {
+    enum Status { Ok, Failed, FewEntries };
+
+    int file = -1;    // HistFitEngine::Files() のインデックス
+    int method = -1;  // HistFitEngine::Methods() のインデックス
+    int ch = -1;
+    std::string type;
+    double entries = 0;
+    Status status = Failed;
+    std::vector<double> values;   // FitMethod::columns の順 (+ 描画用の値)。Ok 以外は NaN
+    std::unique_ptr<TH1D> hist;   // ジョブ専用の複製 (フィット関数のコピーを含む。PDF 用)
+    int attempts = 0;             // フィットの試行回数 (fit_strategy.h を使わない手法は 1)
+    bool criteria_met = false;    // 品質の基準を満たした試行があったか
+    double cpu_ms = 0;            // このジョブのフィットに使った CPU 時間 [ms]
+
+    bool IsOk() const { return status == Ok; }
+    const char* StatusName() const { return status == Ok ? "ok" : (status == Failed ? "failed" : "few_entries"); }
+};
+
+// --- 4. エンジン本体 ---
+
+class HistFitEngine {
+public:
+    static constexpr int N_CHANNELS = 12;
+
+    void AddMethod(const FitMethod& m) { methods_.push_back(m); }
+    void AddFile(const std::string& path) { files_.push_back(path); }
+
+    const std::vector<FitMethod>& Methods() const { return methods_; }
+    const std::vector<std::string>& Files() const { return files_; }
+    const std::vector<FitRecord>& Records() const { return records_; }
+    double FitSeconds() const { return fit_seconds_; } // 直前の Run() のフィット部分の実時間 (読み込みを除く)
+    bool FileOpened(int file) const { return opened_[file]; }
+    double Voltage(int file) const { return get_voltage_from_filename(files_[file]); }
+
+    // Run() でフィット結果の PDF も書く (手法の pdf_style があり、Ok のジョブだけ)
+    void EnablePdf(bool on = true) { save_pdf_ = on; }
+
+    // file 番目のファイル・method 番目の手法の (ch, type) の結果 (無ければ nullptr)
+    // Run() で作った表 (ファイル, 手法, ch, type) -> ジョブ を引くだけなので、ファイル・CH ごとに何度呼んでもよい
+    const FitRecord* Find(int file, int method, int ch, const std::string& type) const {
+        int slot = Slot(file, method, ch, type);
+        if (slot < 0 || record_index_[slot] < 0) return nullptr;
+        return &records_[record_index_[slot]];
+    }
+
+    /**
+     * @brief 全ファイルのヒストグラムを読み込み、全ジョブを n_threads スレッドで処理する
+     * 読み込みは1スレッドで行い、フィットだけを並列に行う。
+     * 各スレッドは共有カウンターから次のジョブを取る (フィット時間のばらつきで偏らないように)。
+     */
+    void Run(int n_threads) {
+        LoadAll();
+        n_threads = std::max(1, std::min<int>(n_threads, static_cast<int>(records_.size())));
+        if (n_threads > 1) {
+            ROOT::EnableThreadSafety();
+            std::string minimizer = ROOT::Math::MinimizerOptions::DefaultMinimizerType();
+            if (minimizer == "Minuit" || minimizer == "TMinuit") {
+                ROOT::Math::MinimizerOptions::SetDefaultMinimizer("Minuit2");
+                std::cout << "Info: " << n_threads << " スレッドでフィットするため、最小化を " << minimizer
+                          << " から Minuit2 に切り替えます" << std::endl;
+            }
+        }
+
+        if (save_pdf_) StartPdf();
+
+        auto start = std::chrono::steady_clock::now();
+        std::atomic<size_t> next(0);
+        auto worker = [&](int id) {
+            FitFunctions funcs(id);
+            for (size_t i = next++; i < records_.size(); i = next++) {
+                Fit(records_[i], funcs);
+                if (pdf_) SubmitPdf(i);
+            }
+        };
+        std::vector<std::thread> threads;
+        for (int t = 1; t < n_threads; ++t) threads.emplace_back(worker, t);
+        worker(0);
+        for (auto& t : threads) t.join();
+        fit_seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (pdf_) {
+            pdf_->Finish();
+            pdf_.reset();
+        }
+
+        int n_ok = 0, n_failed = 0;
+        for (const auto& r : records_) {
+            if (r.status == FitRecord::Ok) n_ok++;
+            else if (r.status == FitRecord::Failed) n_failed++;
+        }
+        std::cout << "Fit jobs: " << records_.size() << " (ok " << n_ok << ", failed " << n_failed
+                  << ", few entries " << records_.size() - n_ok - n_failed << ") on " << n_threads << " threads" << std::endl;
+        PrintAttemptStats();
+    }
+
+    // 従来のファイルごとの txt を書く (手法ごと・ファイルごとに1つ。Ok の結果だけを書く)
+    void WriteLegacy() const {
+        for (size_t f = 0; f < files_.size(); ++f) {
+            if (!opened_[f]) continue;
+            for (size_t m = 0; m < methods_.size(); ++m) {
+                const FitMethod& method = methods_[m];
+                if (method.legacy_suffix.empty()) continue;
+                std::string out_name = replace_eventhist_suffix(files_[f], method.legacy_suffix);
+                std::ofstream out(out_name);
+                out << method.legacy_header << std::endl;
+                for (const auto& r : records_) {
+                    if (r.file != static_cast<int>(f) || r.method != static_cast<int>(m) || !r.IsOk()) continue;
+                    out << r.ch;
+                    if (method.legacy_type_voltage) out << "," << r.type << "," << Voltage(f);
+                    for (size_t i = 0; i < method.columns.size(); ++i) out << "," << r.values[i];
+                    if (method.legacy_file) out << "," << files_[f];
+                    out << std::endl;
+                }
+                if (!method.legacy_message.empty()) std::cout << method.legacy_message << out_name << std::endl;
+            }
+        }
+    }
+
+    /**
+     * @brief 手法ごとの結果の表 (fit_result_store.h) を入力ファイルごとに書く: <run>_<手法>.fitres
+     * 全ジョブの行を書く (status 列で成否が分かる)。下流のツールは FitResultStore / load_fit_table で読む。
+     */
+    void WriteStore() const {
+        for (size_t f = 0; f < files_.size(); ++f) {
+            if (!opened_[f]) continue;
+            for (size_t m = 0; m < methods_.size(); ++m) {
+                FitTable table = MakeStoreTable(static_cast<int>(f), static_cast<int>(m));
+                std::string out_name = replace_eventhist_suffix(files_[f], "_" + methods_[m].name + FIT_STORE_EXT);
+                if (!table.Write(out_name)) std::cerr << "エラー: " << out_name << " を作成できません" << std::endl;
+            }
+        }
+    }
+
+    // file 番目のファイル・method 番目の手法の結果の表 (値の列は FitMethod::columns)
+    FitTable MakeStoreTable(int file, int method) const {
+        const FitMethod& mt = methods_[method];
+        std::vector<std::string> columns = mt.columns;
+        columns.insert(columns.end(), {"attempts", "criteria_met", "cpu_ms"});
+        FitTable table = FitTable::MakeFitTable(mt.name, columns);
+        for (const auto& r : records_) {
+            if (r.file != file || r.method != method) continue;
+            std::map<std::string, double> num = {{"ch", static_cast<double>(r.ch)}, {"voltage", Voltage(file)}, {"entries", r.entries}};
+            for (size_t i = 0; i < mt.columns.size(); ++i) num[mt.columns[i]] = r.values[i];
+            num["attempts"] = r.attempts;
+            num["criteria_met"] = r.criteria_met ? 1 : 0;
+            num["cpu_ms"] = r.cpu_ms;
+            table.AddRow(num, {{"run", fit_store_run_name(files_[file])}, {"type", r.type}, {"position", fit_store_position(files_[file])},
+                               {"status", r.StatusName()}, {"root_file", files_[file]}});
+        }
+        return table;
+    }
+
+    /**
+     * @brief 全結果を1つの列形式サマリーに書く
+     * 列: method,ch,type,voltage,status,entries,<全手法の列名 (登録順, 重複なし)>,attempts,criteria_met,cpu_ms,root_file
+     * その手法に無い列と Ok 以外の結果の値は nan。
+     */
+    bool WriteSummary(const std::string& path) const {
+        std::vector<std::string> columns;
+        for (const auto& m : methods_) {
+            for (const auto& c : m.columns) {
+                if (std::find(columns.begin(), columns.end(), c) == columns.end()) columns.push_back(c);
+            }
+        }
+        // 手法ごとに、サマリーの列 → 結果の値のインデックス (-1 は該当なし)
+        std::vector<std::vector<int>> index(methods_.size(), std::vector<int>(columns.size(), -1));
+        for (size_t m = 0; m < methods_.size(); ++m) {
+            for (size_t c = 0; c < columns.size(); ++c) {
+                auto it = std::find(methods_[m].columns.begin(), methods_[m].columns.end(), columns[c]);
+                if (it != methods_[m].columns.end()) index[m][c] = static_cast<int>(it - methods_[m].columns.begin());
+            }
+        }
+
+        std::ofstream out(path);
+        if (!out) {
+            std::cerr << "エラー: サマリーファイル " << path << " を作成できません" << std::endl;
+            return false;
+        }
+        out << "# method,ch,type,voltage,status,entries";
+        for (const auto& c : columns) out << "," << c;
+        out << ",attempts,criteria_met,cpu_ms,root_file" << std::endl;
+        for (const auto& r : records_) {
+            out << methods_[r.method].name << "," << r.ch << "," << r.type << "," << Voltage(r.file) << ","
+                << r.StatusName() << "," << r.entries;
+            for (int i : index[r.method]) {
+                out << ",";
+                if (i >= 0 && r.IsOk()) out << r.values[i];
+                else out << "nan";
+            }
+            out << "," << r.attempts << "," << (r.criteria_met ? 1 : 0) << "," << r.cpu_ms;
+            out << "," << files_[r.file] << std::endl;
+        }
+        std::cout << "Fit summary (" << records_.size() << " rows) -> " << path << std::endl;
+        return true;
+    }
+
+private:
+    // Find() の表の位置: ファイルごとに [手法][ch][type] を並べる (範囲外・手法に無い type は -1)
+    int Slot(int file, int method, int ch, const std::string& type) const {
+        if (file < 0 || file >= static_cast<int>(files_.size()) || method < 0 ||
+            method >= static_cast<int>(methods_.size()) || ch < 0 || ch >= N_CHANNELS) return -1;
+        const auto& types = methods_[method].types;
+        auto it = std::find(types.begin(), types.end(), type);
+        if (it == types.end()) return -1;
+        int n_types = static_cast<int>(types.size());
+        int offset = file * slots_per_file_ + method_offset_[method] + ch * n_types + static_cast<int>(it - types.begin());
+        return offset < static_cast<int>(record_index_.size()) ? offset : -1;
+    }
+
+    // 全ファイルを開き、手法ごとのジョブとヒストグラムの複製を作る (ヒストグラムが無い組み合わせはジョブにしない)
+    // 同時に Find() の表を作る
+    void LoadAll() {
+        records_.clear();
+        opened_.assign(files_.size(), false);
+        method_offset_.assign(methods_.size(), 0);
+        slots_per_file_ = 0;
+        for (size_t m = 0; m < methods_.size(); ++m) {
+            method_offset_[m] = slots_per_file_;
+            slots_per_file_ += N_CHANNELS * static_cast<int>(methods_[m].types.size());
+        }
+        record_index_.assign(files_.size() * slots_per_file_, -1);
+        for (size_t f = 0; f < files_.size(); ++f) {
+            std::unique_ptr<TFile> infile(TFile::Open(files_[f].c_str(), "READ"));
+            if (!infile || infile->IsZombie()) {
+                std::cerr << "エラー: ファイル " << files_[f] << " を開けません" << std::endl;
+                continue;
+            }
+            opened_[f] = true;
+            for (size_t m = 0; m < methods_.size(); ++m) {
+                for (int ch = 0; ch < N_CHANNELS; ++ch) {
+                    for (const auto& type : methods_[m].types) {
+                        auto hist = infile->Get<TH1D>(Form("h_%s_ch%d", type.c_str(), ch));
+                        if (!hist) continue;
+                        FitRecord r;
+                        r.file = static_cast<int>(f);
+                        r.method = static_cast<int>(m);
+                        r.ch = ch;
+                        r.type = type;
+                        r.entries = hist->GetEntries();
+                        {
+                            TDirectory::TContext ctx(nullptr); // 複製をファイルに登録しない
+                            r.hist.reset(static_cast<TH1D*>(hist->Clone()));
+                        }
+                        r.hist->SetDirectory(nullptr);
+                        record_index_[Slot(r.file, r.method, ch, type)] = static_cast<int>(records_.size());
+                        records_.push_back(std::move(r));
+                    }
+                }
+            }
+            infile->Close();
+        }
+    }
+
+    // (入力, 手法) ごとに本を1つ登録する。ジョブは (ファイル → 手法) の順に並ぶので、本のページは連続したジョブ
+    void StartPdf() {
+        pdf_.reset(new PlotBookWriter());
+        pdf_page_.assign(records_.size(), {-1, 0});
+        for (size_t i = 0; i < records_.size();) {
+            size_t end = i;
+            while (end < records_.size() && records_[end].file == records_[i].file && records_[end].method == records_[i].method) end++;
+            std::string path = replace_eventhist_suffix(files_[records_[i].file], "_" + methods_[records_[i].method].name + "_fit.pdf");
+            int book = pdf_->AddBook(path, static_cast<int>(end - i));
+            for (size_t j = i; j < end; ++j) pdf_page_[j] = {book, static_cast<int>(j - i)};
+            i = end;
+        }
+    }
+
+    // i 番目のジョブのページを描画のスレッドに渡す (描けないジョブは空のページで番号だけ進める)
+    // pdf_style (gStyle, 表示範囲) も描画のスレッドで呼ぶ。ヒストグラムは Run() が終わるまでジョブが持っている
+    void SubmitPdf(size_t i) const {
+        const FitRecord& r = records_[i];
+        const FitMethod* method = &methods_[r.method];
+        PlotBookWriter::DrawFn draw;
+        if (method->pdf_style && r.IsOk() && r.hist) {
+            TH1D* hist = r.hist.get();
+            const std::vector<double>* values = &r.values;
+            draw = [method, hist, values](TCanvas&) {
+                {
+                    std::lock_guard<std::mutex> lock(FitFunctions::Mutex());
+                    method->pdf_style(*hist, *values);
+                }
+                hist->Draw();
+            };
+        }
+        pdf_->Submit(pdf_page_[i].first, pdf_page_[i].second, std::move(draw), r.hist ? r.hist->GetName() : "");
+    }
+
+    void Fit(FitRecord& r, FitFunctions& funcs) const {
+        const FitMethod& method = methods_[r.method];
+        r.values.assign(method.columns.size(), std::numeric_limits<double>::quiet_NaN());
+        if (r.entries < method.min_entries) {
+            r.status = FitRecord::FewEntries;
+            return;
+        }
+        std::vector<double> values(method.columns.size(), std::numeric_limits<double>::quiet_NaN());
+        funcs.Stats().Reset();
+        double cpu_start = thread_cpu_seconds();
+        bool ok = method.fit(*r.hist, funcs, values);
+        r.cpu_ms = 1e3 * (thread_cpu_seconds() - cpu_start);
+        // fit_strategy.h を使わない手法は1回の試行で、成功すれば基準を満たしたとみなす
+        r.attempts = std::max(1, funcs.Stats().attempts);
+        r.criteria_met = funcs.Stats().attempts > 0 ? funcs.Stats().criteria_met : ok;
+        if (ok) {
+            r.values = values;
+            r.status = FitRecord::Ok;
+        } else {
+            r.status = FitRecord::Failed;
+        }
+    }
+
+    // 手法ごとの試行回数の分布・基準を満たさなかったジョブ数・CPU 時間 (合計と最大のジョブ) を表示する
+    void PrintAttemptStats() const {
+        for (size_t m = 0; m < methods_.size(); ++m) {
+            std::map<int, long> n_by_attempts;
+            long n_poor = 0;
+            double cpu_total = 0;
+            const FitRecord* slowest = nullptr;
+            for (const auto& r : records_) {
+                if (r.method != static_cast<int>(m) || r.status == FitRecord::FewEntries) continue;
+                n_by_attempts[r.attempts]++;
+                if (!r.criteria_met) n_poor++;
+                cpu_total += r.cpu_ms;
+                if (!slowest || r.cpu_ms > slowest->cpu_ms) slowest = &r;
+            }
+            if (!slowest || (n_by_attempts.size() == 1 && n_by_attempts.begin()->first == 1 && n_poor == 0)) continue;
+            std::cout << "  [" << methods_[m].name << "] 試行回数:";
+            for (auto const& [n, count] : n_by_attempts) std::cout << " " << n << "回=" << count;
+            std::cout << ", 基準を満たさない " << n_poor << ", CPU " << cpu_total / 1e3 << " s (最大 " << slowest->cpu_ms
+                      << " ms: ch" << slowest->ch << " " << slowest->type << " " << files_[slowest->file] << ")" << std::endl;
+        }
+    }
+
+    std::vector<FitMethod> methods_;
+    std::vector<std::string> files_;
+    std::vector<bool> opened_;
+    bool save_pdf_ = false;
+    std::unique_ptr<PlotBookWriter> pdf_;             // Run() の間だけ (EnablePdf の時)
+    std::vector<std::pair<int, int>> pdf_page_;       // ジョブ -> (本, ページ)
+    std::vector<FitRecord> records_;
+    std::vector<int> record_index_;                   // Find() の表: Slot() -> records_ のインデックス (無ければ -1)
+    std::vector<int> method_offset_;                  // 手法ごとの Slot() の開始位置 (ファイル内)
+    int slots_per_file_ = 0;
+    double fit_seconds_ = 0;
+};
+
+// --- 5. 組み込みの手法 (macro/fit_results の gausfit / peakfinder / meanfinder) ---
+
+// gaus / time のフィッター
+// Root    : TH1::Fit (TF1 + Minuit。従来どおり)
+// Fast    : fast_binned_fit.h の Poisson 尤度フィット (TF1 を使わない)
+// FastChi2: fast_binned_fit.h の Neyman χ² フィット (TH1::Fit と同じ目的関数。比較用)
+enum class FitterKind { Root, Fast, FastChi2 };
+
+inline bool ParseFitter(const std::string& name, FitterKind& k) {
+    if (name == "root") k = FitterKind::Root;
+    else if (name == "fast") k = FitterKind::Fast;
+    else if (name == "fast-chi2") k = FitterKind::FastChi2;
+    else return false;
+    return true;
+}
+
+inline const char* FitterName(FitterKind k) {
+    return k == FitterKind::Root ? "root" : (k == FitterKind::Fast ? "fast" : "fast-chi2");
+}
+
+// 高速フィッターの結果を PDF に描くため、描画用の値から TF1 を作ってヒストグラムに付ける。
+// pdf_style の中から PlotBookWriter の描画のスレッドだけで呼ぶ (フィットと同時に動くので、フィットのスレッドからは呼ばない)。
+// TF1 の生成は SubmitPdf が FitFunctions::Mutex() を取った中で行われる
+inline void attach_fast_curve(TH1D& hist, TF1* f) {
+    f->SetLineColor(kRed);
+    hist.GetListOfFunctions()->Add(f);
+}
+
+// 再試行の基準と EMG のパラメータの制限 (γ, σ, λ。μ は制限なし)
+const FitCriteria GAUS_CRITERIA = {5.0, 1e-3};
+const FitCriteria TIME_CRITERIA = {10.0, 1e-3};
+const double EMG_LIMITS[4][2] = {{0, 0}, {1, 1e9}, {0.01, 100}, {0.001, 500}};
+
+// 電荷: ガウスでプレフィット (最大ビン ± 5σ) → 本フィット (mean ± 2σ)。gausfit の --fit-charge
+// 基準 (GAUS_CRITERIA) を満たさなければ、半値幅から求めた σ で最大ビン ± 2σ, ± 3σ を直接フィットし直す (fit_strategy.h)。
+inline FitMethod MakeGausMethod(FitterKind fitter = FitterKind::Root) {
+    FitMethod m;
+    m.name = "gaus";
+    m.types = {"hgain", "lgain", "tot"};
+    m.min_entries = 200;
+    m.columns = {"peak", "peak_err", "sigma", "sigma_err", "chi2_ndf", "rough_sigma"};
+    m.legacy_suffix = "_gausfit.txt";
+    m.legacy_header = "# ch,type,voltage,peak,peak_err,sigma,sigma_err,chi2_ndf,rough_sigma,root_file";
+    m.legacy_file = true;
+    m.legacy_message = "Charge fit completed. -> ";
+
+    if (fitter != FitterKind::Root) {
+        // 同じ試行をビン配列に対して行う。描画用の値: 振幅, 本フィットの範囲
+        FitCost cost = (fitter == FitterKind::Fast) ? FitCost::Poisson : FitCost::Chi2;
+        m.fit = [cost](TH1D& hist, FitFunctions& ff, std::vector<double>& v) {
+            double rough_peak_pos = hist.GetXaxis()->GetBinCenter(hist.GetMaximumBin());
+            double rough_sigma = hist.GetStdDev();
+            if (rough_sigma == 0) return false;
+            double xmin = hist.GetXaxis()->GetXmin(), xmax = hist.GetXaxis()->GetXmax();
+            auto final_fit = [&](double lo, double hi, std::vector<double>& out) {
+                FitQuality q;
+                lo = std::max(xmin, lo);
+                hi = std::min(xmax, hi);
+                FastFitResult fit = fast_fit_gaus(binned_range(hist, lo, hi), cost);
+                if (!fit.valid || fit.ndf <= 0) return q;
+                out = {fit.par[1], fit.err[1], fit.par[2], fit.err[2], fit.chi2 / fit.ndf, rough_sigma, fit.par[0], lo, hi};
+                q.valid = fit.par[2] > 0 && fit.par[1] >= lo && fit.par[1] <= hi;
+                q.chi2_ndf = fit.chi2 / fit.ndf;
+                return q;
+            };
+            HistMoments hm = hist_moments(hist, xmin, xmax);
+            std::vector<FitAttempt> attempts = {
+                [&](std::vector<double>& out) {
+                    FastFitResult pre = fast_fit_gaus(binned_range(hist, std::max(xmin, rough_peak_pos - 5*rough_sigma), std::min(xmax, rough_peak_pos + 5*rough_sigma)), cost);
+                    if (!pre.valid || pre.par[2] == 0) return FitQuality();
+                    return final_fit(pre.par[1] - 2*pre.par[2], pre.par[1] + 2*pre.par[2], out);
+                },
+                [&](std::vector<double>& out) { return final_fit(hm.peak_x - 2*hm.SigmaHM(), hm.peak_x + 2*hm.SigmaHM(), out); },
+                [&](std::vector<double>& out) { return final_fit(hm.peak_x - 3*hm.SigmaHM(), hm.peak_x + 3*hm.SigmaHM(), out); },
+            };
+            return run_fit_strategy(attempts, GAUS_CRITERIA, ff.Stats(), v);
+        };
+        m.pdf_style = [](TH1D& hist, const std::vector<double>& v) {
+            gStyle->SetOptFit(1111);
+            TF1* f = new TF1(Form("f_fast_%s", hist.GetName()), "gaus", v[7], v[8]);
+            f->SetParameters(v[6], v[0], v[2]);
+            attach_fast_curve(hist, f);
+        };
+        return m;
+    }
+
+    m.fit = [](TH1D& hist, FitFunctions& ff, std::vector<double>& v) {
+        double rough_peak_pos = hist.GetXaxis()->GetBinCenter(hist.GetMaximumBin());
+        double rough_sigma = hist.GetStdDev();
+        if (rough_sigma == 0) return false;
+        double xmin = hist.GetXaxis()->GetXmin(), xmax = hist.GetXaxis()->GetXmax();
+        // 本フィット (TH1::Fit の "gaus" は初期値を範囲内のデータから自動で決めるので、試行ごとに変えるのは範囲)
+        auto final_fit = [&](double lo, double hi, std::vector<double>& out) {
+            FitQuality q;
+            lo = std::max(xmin, lo);
+            hi = std::min(xmax, hi);
+            TF1* f_final = ff.Gaus("f_final", lo, hi);
+            TFitResultPtr fit_result = hist.Fit(f_final, "SQR");
+            if (!fit_result.Get() || !fit_result->IsValid() || fit_result->Ndf() <= 0) return q;
+            double peak = fit_result->Parameter(1), sigma = std::abs(fit_result->Parameter(2));
+            out = {peak, fit_result->ParError(1), sigma, fit_result->ParError(2), fit_result->Chi2() / fit_result->Ndf(), rough_sigma};
+            q.valid = sigma > 0 && peak >= lo && peak <= hi;
+            q.chi2_ndf = fit_result->Chi2() / fit_result->Ndf();
+            return q;
+        };
+        HistMoments hm = hist_moments(hist, xmin, xmax);
+        std::vector<FitAttempt> attempts = {
+            [&](std::vector<double>& out) {
+                TF1* f_prefit = ff.Gaus("f_prefit", std::max(xmin, rough_peak_pos - 5*rough_sigma), std::min(xmax, rough_peak_pos + 5*rough_sigma));
+                TFitResultPtr pre_fit_res = hist.Fit(f_prefit, "QNRS");
+                if (!pre_fit_res.Get() || !pre_fit_res->IsValid()) return FitQuality();
+                double r_mean = pre_fit_res->Parameter(1), r_sigma = pre_fit_res->Parameter(2);
+                if (r_sigma == 0) return FitQuality();
+                return final_fit(r_mean - 2*r_sigma, r_mean + 2*r_sigma, out);
+            },
+            [&](std::vector<double>& out) { return final_fit(hm.peak_x - 2*hm.SigmaHM(), hm.peak_x + 2*hm.SigmaHM(), out); },
+            [&](std::vector<double>& out) { return final_fit(hm.peak_x - 3*hm.SigmaHM(), hm.peak_x + 3*hm.SigmaHM(), out); },
+        };
+        return run_fit_strategy(attempts, GAUS_CRITERIA, ff.Stats(), v, true);
+    };
+    m.pdf_style = [](TH1D&, const std::vector<double>&) { gStyle->SetOptFit(1111); };
+    return m;
+}
+
+// 電荷: 最大ビンの中心 (フィットなし)。peakfinder の --fit-charge
+inline FitMethod MakePeakMethod() {
+    FitMethod m;
+    m.name = "peak";
+    m.types = {"hgain", "lgain", "tot"};
+    m.min_entries = 1;
+    m.columns = {"peak_pos"};
+    m.fit = [](TH1D& hist, FitFunctions&, std::vector<double>& v) {
+        v = {hist.GetXaxis()->GetBinCenter(hist.GetMaximumBin())};
+        return true;
+    };
+    m.legacy_suffix = "_peak.txt";
+    m.legacy_header = "# ch,type,voltage,peak_pos,root_file";
+    m.legacy_file = true;
+    m.legacy_message = "電荷ピーク検出完了 -> ";
+    return m;
+}
+
+// 電荷: ヒストグラムの平均値 (フィットなし)。meanfinder の --fit-charge
+inline FitMethod MakeMeanMethod() {
+    FitMethod m;
+    m.name = "mean";
+    m.types = {"hgain", "lgain", "tot"};
+    m.min_entries = 1;
+    m.columns = {"mean", "mean_err", "rms"};
+    m.fit = [](TH1D& hist, FitFunctions&, std::vector<double>& v) {
+        v = {hist.GetMean(), hist.GetMeanError(), hist.GetRMS()};
+        return true;
+    };
+    m.legacy_suffix = "_mean.txt";
+    m.legacy_header = "# ch,type,voltage,mean,mean_err,rms,root_file";
+    m.legacy_file = true;
+    m.legacy_message = "電荷 平均値計算完了 -> ";
+    return m;
+}
+
+// 時間: 全範囲のガウスでプレフィット → EMG で本フィット (ttshistofit.C ベース)。3手法共通の --fit-time
+// 基準 (TIME_CRITERIA) を満たさなければ、モーメントから求めた EMG の初期値で全範囲、
+// 次にピーク付近の窓 (最大ビン - 5σ 〜 + 15σ。σ は半値幅から) をフィットし直す (fit_strategy.h)。
+// peak は EMG の mode、peak_err は共分散行列から伝播したその誤差、fwhm は emg_math.h で計算する。
+inline FitMethod MakeTimeMethod(FitterKind fitter = FitterKind::Root) {
+    FitMethod m;
+    m.name = "time";
+    m.types = {"time_diff"};
+    m.min_entries = 100;
+    m.columns = {"tts", "sigma", "fwhm", "peak", "peak_err", "tau", "chi2_ndf"};
+    m.legacy_suffix = "_timefit.txt";
+    m.legacy_header = "# ch,type,voltage,tts(sigma),sigma,fwhm(calc),peak(calc),peak_err,tau(1/lambda),chi2_ndf";
+    m.legacy_message = "Time fit completed. -> ";
+    auto set_range = [](TH1D& hist) {
+        gStyle->SetOptStat(0);
+        gStyle->SetOptFit(1);
+        double center = hist.GetBinCenter(hist.GetMaximumBin());
+        hist.GetXaxis()->SetRangeUser(center - 15, center + 20);
+    };
+
+    if (fitter != FitterKind::Root) {
+        // 同じ試行をビン配列に対して行う。描画用の値: EMG の4パラメータ
+        FitCost cost = (fitter == FitterKind::Fast) ? FitCost::Poisson : FitCost::Chi2;
+        m.fit = [cost](TH1D& hist, FitFunctions& ff, std::vector<double>& v) {
+            double hist_min = hist.GetXaxis()->GetXmin();
+            double hist_max = hist.GetXaxis()->GetXmax();
+            std::vector<ParLimit> limits(4);
+            for (int i = 1; i < 4; ++i) limits[i] = {EMG_LIMITS[i][0], EMG_LIMITS[i][1]};
+            auto emg_fit = [&](double lo, double hi, const std::vector<double>& seed, std::vector<double>& out) {
+                FitQuality q;
+                FastFitResult fit = fast_fit(EmgModel(), binned_range(hist, lo, hi), cost, seed, limits);
+                if (!fit.valid || fit.ndf <= 0) return q;
+                double mu = fit.par[0], sigma = fit.par[2], lambda = fit.par[3];
+                double tau = (lambda > 1e-9) ? (1.0 / lambda) : 0.0;
+                EmgShape shape = emg_shape(mu, sigma, lambda);
+                double peak_err = emg_error(shape.d_mode, [&](int i, int j) { return fit.Cov(i, j); });
+                out = {sigma, sigma, shape.fwhm, shape.mode, peak_err, tau, fit.chi2 / fit.ndf,
+                       mu, fit.par[1], sigma, lambda};
+                q.valid = sigma > 0 && shape.ok;
+                q.chi2_ndf = fit.chi2 / fit.ndf;
+                for (int i = 1; i < 4; ++i) q.at_limit = q.at_limit || near_limit(fit.par[i], limits[i].lo, limits[i].hi, TIME_CRITERIA.limit_margin);
+                return q;
+            };
+            HistMoments hm = hist_moments(hist, hist_min, hist_max);
+            double win_lo = std::max(hist_min, hm.peak_x - 5 * hm.SigmaHM());
+            double win_hi = std::min(hist_max, hm.peak_x + 15 * hm.SigmaHM());
+            std::vector<FitAttempt> attempts = {
+                [&](std::vector<double>& out) {
+                    FastFitResult pre = fast_fit_gaus(binned_range(hist, hist_min, hist_max), cost);
+                    if (!pre.valid) return FitQuality();
+                    double pre_amp = pre.par[0], pre_mean = pre.par[1], pre_sigma = pre.par[2];
+                    if (pre_sigma == 0) return FitQuality();
+                    return emg_fit(hist_min, hist_max, {pre_mean, pre_amp * 10.0, pre_sigma * 0.7, (pre_sigma > 1e-9) ? (1. / pre_sigma) : 1.0}, out);
+                },
+                [&](std::vector<double>& out) { return emg_fit(hist_min, hist_max, emg_seed_from_moments(hm), out); },
+                [&](std::vector<double>& out) {
+                    return emg_fit(win_lo, win_hi, emg_seed_from_moments(hist_moments(hist, win_lo, win_hi)), out);
+                },
+            };
+            return run_fit_strategy(attempts, TIME_CRITERIA, ff.Stats(), v);
+        };
+        m.pdf_style = [set_range](TH1D& hist, const std::vector<double>& v) {
+            set_range(hist);
+            TF1* f = new TF1(Form("f_fast_%s", hist.GetName()), EMG, hist.GetXaxis()->GetXmin(), hist.GetXaxis()->GetXmax(), 4);
+            for (int i = 0; i < 4; ++i) f->SetParameter(i, v[7 + i]);
+            f->SetNpx(2000);
+            attach_fast_curve(hist, f);
+        };
+        return m;
+    }
+
+    m.fit = [](TH1D& hist, FitFunctions& ff, std::vector<double>& v) {
+        double hist_min = hist.GetXaxis()->GetXmin();
+        double hist_max = hist.GetXaxis()->GetXmax();
+
+        // ステップB: EMG関数による本フィット ([lo, hi] を seed から)
+        auto emg_fit = [&](double lo, double hi, const std::vector<double>& seed, std::vector<double>& out) {
+            FitQuality q;
+            TF1* emg = ff.Emg("emg", lo, hi);
+            emg->SetLineColor(kRed);
+            emg->SetLineStyle(2);
+            emg->SetNpx(2000);
+            emg->SetParName(0, "#mu");
+            emg->SetParName(1, "#gamma");
+            emg->SetParName(2, "#sigma");
+            emg->SetParName(3, "#lambda");
+            for (int i = 0; i < 4; ++i) emg->SetParameter(i, seed[i]);
+            for (int i = 1; i < 4; ++i) emg->SetParLimits(i, EMG_LIMITS[i][0], EMG_LIMITS[i][1]);
+            TFitResultPtr fit_result = hist.Fit(emg, "SQR", "", lo, hi);
+            if (!fit_result.Get() || !fit_result->IsValid() || fit_result->Ndf() <= 0) return q;
+
+            double sigma = emg->GetParameter(2);
+            double lambda = emg->GetParameter(3);
+            double tau = (lambda > 1e-9) ? (1.0 / lambda) : 0.0;
+            EmgShape shape = GetEmgShape(emg);
+            TMatrixDSym cov = fit_result->GetCovarianceMatrix();
+            out = {sigma, sigma, shape.fwhm, shape.mode, emg_error(shape.d_mode, cov), tau, fit_result->Chi2() / fit_result->Ndf()};
+            q.valid = sigma > 0 && shape.ok;
+            q.chi2_ndf = fit_result->Chi2() / fit_result->Ndf();
+            for (int i = 1; i < 4; ++i) {
+                q.at_limit = q.at_limit || near_limit(emg->GetParameter(i), EMG_LIMITS[i][0], EMG_LIMITS[i][1], TIME_CRITERIA.limit_margin);
+            }
+            return q;
+        };
+
+        HistMoments hm = hist_moments(hist, hist_min, hist_max);
+        double win_lo = std::max(hist_min, hm.peak_x - 5 * hm.SigmaHM());
+        double win_hi = std::min(hist_max, hm.peak_x + 15 * hm.SigmaHM());
+        std::vector<FitAttempt> attempts = {
+            [&](std::vector<double>& out) {
+                // ステップA: ガウス関数によるプレフィット
+                TF1* fgaus = ff.Gaus("fgaus", hist_min, hist_max);
+                fgaus->SetLineColor(kCyan);
+                fgaus->SetLineWidth(1);
+                fgaus->SetParameter(1, hist.GetBinCenter(hist.GetMaximumBin()));
+                fgaus->SetParameter(2, hist.GetRMS());
+                hist.Fit(fgaus, "QN", "", hist_min, hist_max);
+                double pre_amp = fgaus->GetParameter(0);
+                double pre_mean = fgaus->GetParameter(1);
+                double pre_sigma = TMath::Abs(fgaus->GetParameter(2));
+                if (pre_sigma == 0) return FitQuality();
+                return emg_fit(hist_min, hist_max, {pre_mean, pre_amp * 10.0, pre_sigma * 0.7, (pre_sigma > 1e-9) ? (1. / pre_sigma) : 1.0}, out);
+            },
+            [&](std::vector<double>& out) { return emg_fit(hist_min, hist_max, emg_seed_from_moments(hm), out); },
+            [&](std::vector<double>& out) {
+                return emg_fit(win_lo, win_hi, emg_seed_from_moments(hist_moments(hist, win_lo, win_hi)), out);
+            },
+        };
+        return run_fit_strategy(attempts, TIME_CRITERIA, ff.Stats(), v, true);
+    };
+    m.pdf_style = [set_range](TH1D& hist, const std::vector<double>&) { set_range(hist); };
+    return m;
+}
+
+// 名前 ("gaus", "peak", "mean", "time") から組み込みの手法を作る。知らない名前なら false
+inline bool MakeBuiltinMethod(const std::string& name, FitMethod& m, FitterKind fitter = FitterKind::Root) {
+    if (name == "gaus") m = MakeGausMethod(fitter);
+    else if (name == "peak") m = MakePeakMethod();
+    else if (name == "mean") m = MakeMeanMethod();
+    else if (name == "time") m = MakeTimeMethod(fitter);
+    else return false;
+    return true;
+}
+
+// --- 6. gausfit / peakfinder / meanfinder 共通の main ---
+
+/**
+ * @brief 従来の1ファイル用プログラムの main
+ * 使い方: <prog> <input.root> [input2.root ...] [--fit-charge | --fit-time | --fit-all] [--no-pdf] [-j <N>] [--fitter <name>]
+ * --fit-charge は charge_method ("gaus", "peak", "mean")、--fit-time は "time" を使う。
+ * 出力は従来どおり入力ごとの txt (と PDF)。
+ */
+inline int run_fit_program(int argc, char* argv[], const std::string& charge_method) {
+    if (argc < 2) {
+        std::cerr << "使い方: " << argv[0] << " <input.root> [input2.root ...] [--fit-charge | --fit-time | --fit-all] [--no-pdf] [-j <N>] [--fitter <name>]" << std::endl;
+        std::cerr << "  -j <N>          : フィットのスレッド数 (デフォルト: 1)" << std::endl;
+        std::cerr << "  --fitter <name> : ガウス / EMG のフィッター root (TH1::Fit, デフォルト), fast (Poisson 尤度), fast-chi2 (χ²)" << std::endl;
+        return 1;
+    }
+
+    std::string fit_mode = "--fit-charge"; // デフォルト
+    bool save_pdf = true;
+    int n_threads = 1;
+    FitterKind fitter = FitterKind::Root;
+    HistFitEngine engine;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--fit-charge" || arg == "--fit-time" || arg == "--fit-all") fit_mode = arg;
+        else if (arg == "--no-pdf") save_pdf = false;
+        else if (arg == "-j" && i + 1 < argc) n_threads = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--fitter" && i + 1 < argc) {
+            if (!ParseFitter(argv[++i], fitter)) {
+                std::cerr << "エラー: 不明なフィッター '" << argv[i] << "' (root, fast, fast-chi2)" << std::endl;
+                return 1;
+            }
+        }
+        else if (i == 1 || TString(arg.c_str()).EndsWith(".root")) engine.AddFile(arg);
+    }
+
+    FitMethod method;
+    if (fit_mode == "--fit-charge" || fit_mode == "--fit-all") {
+        MakeBuiltinMethod(charge_method, method, fitter);
+        engine.AddMethod(method);
+    }
+    if (fit_mode == "--fit-time" || fit_mode == "--fit-all") engine.AddMethod(MakeTimeMethod(fitter));
+
+    engine.EnablePdf(save_pdf);
+    engine.Run(n_threads);
+    engine.WriteLegacy();
+    engine.WriteStore();
+    return 0;
+}
+
+#endif // HIST_FIT_ENGINE_H
@@ -0,0 +1,275 @@
+/*
+ * id: hv_gain_table.h
+ * Place: ~/hkelec/DiscreteSoftware/Analysis/macro/fit_results/
+ * Last Edit: 2026-10-18 Gemini
+ *
+ * 概要: HV vs Charge のべき乗則 Q = b * HV^a のフィットと、全チャンネルの結果をまとめたゲイン表。
+ * 1. HV vs Charge のファイル (select_gain / select_gain_mean の出力) をヘッダーの列名で読む。
+ * 2. フィットは ROOT を使わない (スレッドから並列に呼べる):
+ *    - 初期値: log Q = log c + a log(HV/HV0) の重み付き最小二乗 (閉じた式)。HV0 は HV の幾何平均で、
+ *      b = c HV0^(-a) と a の強い相関を除くためのもの。
+ *    - 本フィット: Q そのものの χ² を (log c, a) で Levenberg-Marquardt 法で最小化する。
+ *      HV の誤差は TGraphErrors::Fit と同じく有効分散 σ² = σ_Q² + (dQ/dHV σ_HV)² で入れる。
+ *    誤差は χ² の曲率から求め (χ²/ndf でスケールしない。fit_hv_gain と同じ)、(b, a) の共分散も持つ。
+ * 3. ゲイン表 (hv_gain_<手法>.fitres, kind=hv_gain, fit_result_store.h の形式) は1チャンネル1行。
+ *    load_hv_gain_table() で読み、HvGain::Charge / Gain / VoltageForGain で電荷・ゲイン・HV の換算に使う。
+ * コンパイル不要 (ヘッダーファイル)
+ */
+#ifndef HV_GAIN_TABLE_H
+#define HV_GAIN_TABLE_H
+
+#include "fit_result_store.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+const double HV_GAIN_E_PC = 1.60217663e-7;                 // 電気素量 [pC]
+const double HV_GAIN_REF_GAIN = 1.0e7;                     // 基準のゲイン (1 p.e. で 1.602 pC)
+const double HV_GAIN_REF_CHARGE = HV_GAIN_REF_GAIN * HV_GAIN_E_PC;
+
+// 1チャンネルの HV vs Charge の点
+struct HvSeries {
+    int ch = -1;
+    std::string file;
+    std::vector<double> hv, hv_err, q, q_err;
+};
+
+// ファイル名の "_ch<N>.txt" からチャンネル番号を取る (無ければ -1)
+inline int hv_series_channel(const std::string& path) {
+    std::smatch match;
+    std::string name = std::filesystem::path(path).filename().string();
+    if (std::regex_search(name, match, std::regex("_ch(\\d+)\\.txt$"))) return std::stoi(match.str(1));
+    return -1;
+}
+
+/**
+ * @brief HV vs Charge のファイルを読む (区切りは空白・カンマどちらでもよい)
+ * 列はヘッダー ("# HV(V), HV_err(V), Charge(pC), Charge_err(pC), ...") の名前で決める。
+ * ヘッダーに名前が無ければ fit_hv_gain と同じく列数で決める (3列: HV Q σ_Q, 4列以上: HV Q σ_HV σ_Q)。
+ */
+inline bool load_hv_series(const std::string& path, HvSeries& s) {
+    std::ifstream in(path);
+    if (!in) return false;
+    s = HvSeries();
+    s.file = path;
+    s.ch = hv_series_channel(path);
+
+    int c_hv = -1, c_hv_err = -1, c_q = -1, c_q_err = -1;
+    std::string line;
+    while (std::getline(in, line)) {
+        for (char& c : line) if (c == ',' || c == '\r') c = ' ';
+        if (line.find_first_not_of(' ') == std::string::npos) continue;
+        if (line[line.find_first_not_of(' ')] == '#') {
+            // ヘッダー: 名前の "(...)" を除いて列を探す
+            std::stringstream ss(line.substr(line.find('#') + 1));
+            std::string name;
+            for (int i = 0; ss >> name; ++i) {
+                name = name.substr(0, name.find('('));
+                if (name == "HV") c_hv = i;
+                else if (name == "HV_err") c_hv_err = i;
+                else if (name == "Charge") c_q = i;
+                else if (name == "Charge_err") c_q_err = i;
+            }
+            continue;
+        }
+        std::vector<double> v;
+        std::stringstream ss(line);
+        for (double x; ss >> x;) v.push_back(x);
+        if (v.size() < 3) continue;
+        bool named = c_hv >= 0 && c_q >= 0;
+        auto at = [&](int c) { return (c >= 0 && c < static_cast<int>(v.size())) ? v[c] : 0.0; };
+        s.hv.push_back(named ? at(c_hv) : v[0]);
+        s.q.push_back(named ? at(c_q) : v[1]);
+        s.hv_err.push_back(named ? at(c_hv_err) : (v.size() >= 4 ? v[2] : 0.0));
+        s.q_err.push_back(named ? at(c_q_err) : (v.size() >= 4 ? v[3] : v[2]));
+    }
+    return true;
+}
+
+// 1チャンネルのフィット結果。Q [pC] = b * HV^a
+struct HvGain {
+    int ch = -1;
+    std::string status = "failed";   // ok / few_points (範囲内の点が2点未満) / failed
+    int n_points = 0;
+    double hv_min = 0, hv_max = 0;   // フィットに使った点の HV の範囲
+    double b = NAN, b_err = NAN, a = NAN, a_err = NAN, cov_ab = NAN;
+    double chi2 = NAN, ndf = NAN;
+    double hv_ref = NAN, hv_ref_err = NAN;  // ゲインが HV_GAIN_REF_GAIN になる HV とその誤差
+    std::string file;
+
+    bool IsOk() const { return status == "ok"; }
+    double Charge(double hv) const { return b * std::pow(hv, a); }                    // 1 p.e. の電荷 [pC]
+    double Gain(double hv) const { return Charge(hv) / HV_GAIN_E_PC; }
+    double VoltageForCharge(double q) const { return std::pow(q / b, 1.0 / a); }
+    double VoltageForGain(double gain) const { return VoltageForCharge(gain * HV_GAIN_E_PC); }
+};
+
+/**
+ * @brief Q = b * HV^a を [hv_lo, hv_hi] の点 (Q > 0) にフィットする
+ * σ_Q が全て正でなければ重み無し (σ_Q = 1) でフィットする。
+ */
+inline HvGain fit_hv_power_law(const HvSeries& s, double hv_lo, double hv_hi) {
+    HvGain g;
+    g.ch = s.ch;
+    g.file = s.file;
+
+    std::vector<double> x, ex, y, ey;
+    for (size_t i = 0; i < s.hv.size(); ++i) {
+        if (s.hv[i] < hv_lo || s.hv[i] > hv_hi || !(s.hv[i] > 0) || !(s.q[i] > 0)) continue;
+        x.push_back(s.hv[i]); ex.push_back(s.hv_err[i]);
+        y.push_back(s.q[i]); ey.push_back(s.q_err[i]);
+    }
+    const size_t n = x.size();
+    g.n_points = static_cast<int>(n);
+    if (n < 2) {
+        g.status = "few_points";
+        return g;
+    }
+    bool weighted = true;
+    for (double e : ey) weighted = weighted && e > 0;
+    if (!weighted) std::fill(ey.begin(), ey.end(), 1.0);
+    g.hv_min = *std::min_element(x.begin(), x.end());
+    g.hv_max = *std::max_element(x.begin(), x.end());
+
+    // --- 初期値: log Q = lc + a t (t = log(HV/HV0)) の重み付き最小二乗。σ_logQ = σ_Q / Q ---
+    std::vector<double> t(n);
+    double log_x0 = 0;
+    for (size_t i = 0; i < n; ++i) log_x0 += std::log(x[i]) / n;
+    for (size_t i = 0; i < n; ++i) t[i] = std::log(x[i]) - log_x0;
+    double sw = 0, st = 0, sl = 0, stt = 0, stl = 0;
+    for (size_t i = 0; i < n; ++i) {
+        double w = (y[i] / ey[i]) * (y[i] / ey[i]), l = std::log(y[i]);
+        sw += w; st += w * t[i]; sl += w * l; stt += w * t[i] * t[i]; stl += w * t[i] * l;
+    }
+    double det = sw * stt - st * st;
+    double p[2] = {sl / sw, 0.0};  // (lc, a)。HV が全て同じなら a は決まらない
+    if (det > 0) {
+        p[0] = (stt * sl - st * stl) / det;
+        p[1] = (sw * stl - st * sl) / det;
+    }
+
+    // --- 本フィット: χ²(lc, a) = Σ (Q - exp(lc + a t))² / σ² を Levenberg-Marquardt 法で最小化 ---
+    // 有効分散の σ² はパラメータに依存するが、勾配では定数として扱う (TGraphErrors::Fit と同じ)
+    double jtj[3], jtr[2];  // 正規方程式 (jtj = {00, 01, 11})
+    auto eval = [&](const double* q, bool grad) {
+        double chi2 = 0;
+        if (grad) { jtj[0] = jtj[1] = jtj[2] = jtr[0] = jtr[1] = 0; }
+        for (size_t i = 0; i < n; ++i) {
+            double m = std::exp(q[0] + q[1] * t[i]);
+            double dm_dx = q[1] * m / x[i];
+            double w = 1.0 / (ey[i] * ey[i] + dm_dx * dm_dx * ex[i] * ex[i]);
+            double r = y[i] - m;
+            chi2 += w * r * r;
+            if (grad) {
+                double j0 = m, j1 = m * t[i];
+                jtj[0] += w * j0 * j0; jtj[1] += w * j0 * j1; jtj[2] += w * j1 * j1;
+                jtr[0] += w * j0 * r; jtr[1] += w * j1 * r;
+            }
+        }
+        return chi2;
+    };
+    double chi2 = eval(p, true);
+    double lambda = 1e-3;
+    bool converged = false;
+    for (int it = 0; it < 200 && !converged; ++it) {
+        double a00 = jtj[0] * (1 + lambda), a11 = jtj[2] * (1 + lambda), a01 = jtj[1];
+        double d = a00 * a11 - a01 * a01;
+        if (!(d > 0)) break;
+        double step[2] = {(a11 * jtr[0] - a01 * jtr[1]) / d, (a00 * jtr[1] - a01 * jtr[0]) / d};
+        double trial[2] = {p[0] + step[0], p[1] + step[1]};
+        double chi2_trial = eval(trial, false);
+        if (std::isfinite(chi2_trial) && chi2_trial <= chi2) {
+            converged = (chi2 - chi2_trial) <= 1e-12 * (1 + chi2) &&
+                        std::abs(step[0]) < 1e-10 && std::abs(step[1]) < 1e-10 * (1 + std::abs(p[1]));
+            p[0] = trial[0]; p[1] = trial[1];
+            chi2 = eval(p, true);
+            lambda = std::max(lambda / 10, 1e-12);
+        } else {
+            lambda *= 10;
+            if (lambda > 1e12) converged = true;  // これ以上下がらない (最小値)
+        }
+    }
+    eval(p, true);
+    double d = jtj[0] * jtj[2] - jtj[1] * jtj[1];
+    if (!(d > 0) || !std::isfinite(chi2)) return g;
+    double c00 = jtj[2] / d, c01 = -jtj[1] / d, c11 = jtj[0] / d;  // (lc, a) の共分散
+
+    // --- (lc, a) -> (b, a), HV_ref ---
+    // log b = lc - a log HV0
+    g.a = p[1];
+    g.a_err = std::sqrt(c11);
+    g.b = std::exp(p[0] - p[1] * log_x0);
+    double jb[2] = {g.b, -g.b * log_x0};
+    g.b_err = std::sqrt(std::max(0.0, jb[0] * jb[0] * c00 + 2 * jb[0] * jb[1] * c01 + jb[1] * jb[1] * c11));
+    g.cov_ab = jb[0] * c01 + jb[1] * c11;
+    g.chi2 = chi2;
+    g.ndf = static_cast<double>(n) - 2;
+    // log HV_ref = log HV0 + (log Q_ref - lc) / a
+    double dl = std::log(HV_GAIN_REF_CHARGE) - p[0];
+    g.hv_ref = std::exp(log_x0 + dl / p[1]);
+    double jr[2] = {-1 / p[1], -dl / (p[1] * p[1])};
+    g.hv_ref_err = g.hv_ref * std::sqrt(std::max(0.0, jr[0] * jr[0] * c00 + 2 * jr[0] * jr[1] * c01 + jr[1] * jr[1] * c11));
+    g.status = (p[1] > 0 && std::isfinite(g.b) && g.b > 0) ? "ok" : "failed";
+    return g;
+}
+
+// --- ゲイン表 ---
+
+const char* const HV_GAIN_KIND = "hv_gain";
+
+/**
+ * @brief ゲイン表を作る (1チャンネル1行)。method は HV vs Charge を作った電荷の手法 (gaus, peak, mean)
+ * 列: ch,method,status,n_points,hv_min,hv_max,b,b_err,a,a_err,cov_ab,chi2,ndf,hv_ref,hv_ref_err,ref_gain,file
+ */
+inline FitTable make_hv_gain_table(const std::vector<HvGain>& gains, const std::string& method) {
+    using C = FitTable::Column;
+    const FitTable::Type I = FitTable::Int, D = FitTable::Double, S = FitTable::String;
+    FitTable t = FitTable::MakeTable(HV_GAIN_KIND, {C{"ch", I}, C{"method", S}, C{"status", S}, C{"n_points", I},
+                                                    C{"hv_min", D}, C{"hv_max", D}, C{"b", D}, C{"b_err", D},
+                                                    C{"a", D}, C{"a_err", D}, C{"cov_ab", D}, C{"chi2", D},
+                                                    C{"ndf", D}, C{"hv_ref", D}, C{"hv_ref_err", D},
+                                                    C{"ref_gain", D}, C{"file", S}});
+    for (const auto& g : gains) {
+        t.AddRow({{"ch", g.ch}, {"n_points", g.n_points}, {"hv_min", g.hv_min}, {"hv_max", g.hv_max},
+                  {"b", g.b}, {"b_err", g.b_err}, {"a", g.a}, {"a_err", g.a_err}, {"cov_ab", g.cov_ab},
+                  {"chi2", g.chi2}, {"ndf", g.ndf}, {"hv_ref", g.hv_ref}, {"hv_ref_err", g.hv_ref_err},
+                  {"ref_gain", HV_GAIN_REF_GAIN}},
+                 {{"method", method}, {"status", g.status}, {"file", g.file}});
+    }
+    return t;
+}
+
+/**
+ * @brief ゲイン表を読む (ch -> HvGain)。ok_only なら status が ok の行だけ
+ */
+inline std::map<int, HvGain> load_hv_gain_table(const std::string& path, bool ok_only = true) {
+    std::map<int, HvGain> gains;
+    FitTable t;
+    if (!FitTable::Load(path, t, HV_GAIN_KIND) || t.Kind() != HV_GAIN_KIND) {
+        std::cerr << "エラー: ゲイン表 " << path << " を読めません" << std::endl;
+        return gains;
+    }
+    for (size_t r = 0; r < t.Rows(); ++r) {
+        HvGain g;
+        g.ch = static_cast<int>(t.Num(r, "ch"));
+        g.status = t.Str(r, "status");
+        if (ok_only && !g.IsOk()) continue;
+        g.n_points = static_cast<int>(t.Num(r, "n_points"));
+        g.hv_min = t.Num(r, "hv_min"); g.hv_max = t.Num(r, "hv_max");
+        g.b = t.Num(r, "b"); g.b_err = t.Num(r, "b_err");
+        g.a = t.Num(r, "a"); g.a_err = t.Num(r, "a_err");
+        g.cov_ab = t.Num(r, "cov_ab");
+        g.chi2 = t.Num(r, "chi2"); g.ndf = t.Num(r, "ndf");
+        g.hv_ref = t.Num(r, "hv_ref"); g.hv_ref_err = t.Num(r, "hv_ref_err");
+        g.file = t.Str(r, "file");
+        gains[g.ch] = g;
+    }
+    return gains;
+}
+
+#endif // HV_GAIN_TABLE_H
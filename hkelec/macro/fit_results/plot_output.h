@@ -0,0 +1,164 @@
+/*
+ * id: plot_output.h
+ * Place: ~/hkelec/DiscreteSoftware/Analysis/macro/fit_results/
+ * Last Edit: 2026-10-18 Gemini
+ *
+ * 概要: フィット図などの PDF 出力 (hist_fit_engine.h, fit_hv_gain_all, plot_summary から使う)。
+ * 1. バッチモードの TCanvas を1つだけ作って使い回す (図ごとに TCanvas を作って SaveAs しない)。
+ * 2. ページは出力ファイル (本, book) ごとに1つの複数ページ PDF にまとめる
+ *    (Print("name.pdf[") で開き、ページごとに Print("name.pdf")、最後に Print("name.pdf]") で閉じる)。
+ * 3. 描画は専用のスレッド1つで行い、フィットなどの呼び出し側はページ (描画する関数) を渡すだけで先に進む。
+ *    ROOT の描画はスレッドセーフでないので、TCanvas と gStyle を触るのはこのスレッドだけにする
+ *    (gPad はスレッドごとなので、他のスレッドの TH1::Fit がこのキャンバスに描くことはない)。
+ *    描画する関数が描くオブジェクトは Print まで残っている必要がある: 呼び出し側のもの (エンジンのヒストグラム) は
+ *    Finish() まで残し、関数の中で new したもの (TGraph など) は SetBit(kCanDelete) を付ける (次のページの Clear で消える)。
+ * 4. ページの順番は本ごとのページ番号で決まり (番号が揃うまで待つ)、渡した順番・スレッド数によらない。
+ *    描画しないページ (フィット失敗など) も空の関数で渡して番号を進める。
+ * PDF を作らない時は PlotBookWriter を作らなければ、スレッドも TCanvas も作らない。
+ * コンパイル不要 (ヘッダーファイル)
+ */
+#ifndef PLOT_OUTPUT_H
+#define PLOT_OUTPUT_H
+
+#include <TCanvas.h>
+#include <TROOT.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class PlotBookWriter {
+public:
+    using DrawFn = std::function<void(TCanvas&)>;
+
+    PlotBookWriter(int width = 800, int height = 600) : width_(width), height_(height) {
+        ROOT::EnableThreadSafety();
+        gROOT->SetBatch(kTRUE);
+        thread_ = std::thread([this] { Loop(); });
+    }
+    ~PlotBookWriter() { Finish(); }
+    PlotBookWriter(const PlotBookWriter&) = delete;
+    PlotBookWriter& operator=(const PlotBookWriter&) = delete;
+
+    // 本 (n_pages ページの PDF) を登録して番号を返す。本は登録順に書く (描画するページが無ければファイルを作らない)
+    // ページ数が先に分からなければ -1 にして、最後のページを渡した後に CloseBook で決める
+    int AddBook(const std::string& path, int n_pages = -1) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        books_.push_back(Book{path, n_pages});
+        cv_.notify_one();
+        return static_cast<int>(books_.size()) - 1;
+    }
+
+    void CloseBook(int book, int n_pages) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        books_[book].n_pages = n_pages;
+        cv_.notify_one();
+    }
+
+    // book の page 番目 (0 から) のページを渡す。draw が空なら描画しない。title は PDF のしおり
+    void Submit(int book, int page, DrawFn draw, const std::string& title = "") {
+        std::lock_guard<std::mutex> lock(mutex_);
+        books_[book].pending[page] = {std::move(draw), title};
+        cv_.notify_one();
+    }
+
+    // 渡された全ページを書き終えるまで待ち、描画のスレッドを止める (2回目以降は何もしない)
+    void Finish() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!thread_.joinable()) return;
+            finishing_ = true;
+            cv_.notify_one();
+        }
+        thread_.join();
+        if (pages_ > 0) {
+            std::cout << "PDF: " << pages_ << " pages in " << files_ << " files (描画 " << render_seconds_ << " s, 別スレッド)" << std::endl;
+        }
+    }
+
+private:
+    struct Page {
+        DrawFn draw;
+        std::string title;
+    };
+    struct Book {
+        std::string path;
+        int n_pages = -1;    // -1: まだ分からない (CloseBook 待ち)
+        int next = 0;        // 次に書くページ番号
+        bool open = false;   // Print("[") 済み
+        std::map<int, Page> pending;
+    };
+
+    // 描画のスレッド: 先頭の本のページを番号順に書き、最後のページで閉じて次の本に進む
+    void Loop() {
+        std::unique_ptr<TCanvas> canvas;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            if (current_ >= books_.size()) {
+                if (finishing_) break;
+                cv_.wait(lock);
+                continue;
+            }
+            Book& b = books_[current_];  // deque の push_back は要素の参照を無効にしない
+            if (b.n_pages >= 0 && b.next >= b.n_pages) {
+                if (b.open) {
+                    lock.unlock();
+                    canvas->Print((b.path + "]").c_str());
+                    lock.lock();
+                    files_++;
+                }
+                current_++;
+                continue;
+            }
+            auto it = b.pending.find(b.next);
+            if (it == b.pending.end()) {
+                if (!finishing_) {
+                    cv_.wait(lock);
+                    continue;
+                }
+                // Finish() の後に来ないページは飛ばす
+                if (b.pending.empty()) b.n_pages = b.next;
+                else b.next = b.pending.begin()->first;
+                continue;
+            }
+            Page page = std::move(it->second);
+            b.pending.erase(it);
+            b.next++;
+            if (!page.draw) continue;
+
+            lock.unlock();
+            auto start = std::chrono::steady_clock::now();
+            if (!canvas) canvas.reset(new TCanvas("plot_output", "plot_output", width_, height_));
+            if (!b.open) {
+                canvas->Print((b.path + "[").c_str());
+                b.open = true;
+            }
+            canvas->Clear();
+            canvas->cd();
+            page.draw(*canvas);
+            canvas->Print(b.path.c_str(), page.title.empty() ? "pdf" : ("Title:" + page.title).c_str());
+            render_seconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            lock.lock();
+            pages_++;
+        }
+    }
+
+    int width_, height_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Book> books_;
+    size_t current_ = 0;
+    bool finishing_ = false;
+    long pages_ = 0, files_ = 0;
+    double render_seconds_ = 0;
+    std::thread thread_;
+};
+
+#endif // PLOT_OUTPUT_H
@@ -6,6 +6,8 @@
 #
 # 概要: gausfit / meanfinder / peakfinder のワークフローを統一して実行する
 #       引数で method を指定 (gaus|mean|peak|all)。実行ログを出力する。
+# (修正: 2026-10-18 Gemini (fit_results/fit_pipeline があれば、変わった eventhist だけをフィットし直し、
+#        select_gain / create_ct_plot を手法ごとに並列に実行する。--full-rerun で従来の全ファイル処理) )
 #
 
 BASE_DIR="$(dirname "$0")"
@@ -17,6 +19,7 @@ PEAK_FITTER="${BASE_DIR}/fit_results/peakfinder"
 GAIN_SELECTOR="${BASE_DIR}/fit_results/select_gain"
 GAIN_SELECTOR_MEAN="${BASE_DIR}/fit_results/select_gain_mean"
 CT_PLOT_CREATOR="${BASE_DIR}/fit_results/create_ct_plot"
+FIT_PIPELINE="${BASE_DIR}/fit_results/fit_pipeline"
 
 usage(){
     cat <<EOF
@@ -26,6 +29,8 @@ Usage: $0 <target_dir> <method> [pedestal_dir] [options]
     --fit-charge | --fit-time | --fit-all
     --no-pdf
     --make-ct-plot
+    --force        (fit_pipeline のキャッシュを無視して全てフィットし直す)
+    --full-rerun   (fit_pipeline を使わず従来どおり全ファイルを処理する)
 EOF
 }
 
@@ -61,11 +66,15 @@ fi
 FIT_OPTION="--fit-charge"
 PDF_OPTION=""
 MAKE_CT_PLOT="no"
+FORCE_OPTION=""
+FULL_RERUN="no"
 for arg in "$@"; do
     case $arg in
         --fit-charge|--fit-time|--fit-all) FIT_OPTION=$arg ;; 
         --no-pdf) PDF_OPTION=$arg ;;
         --make-ct-plot) MAKE_CT_PLOT="yes" ;;
+        --force) FORCE_OPTION=$arg ;;
+        --full-rerun) FULL_RERUN="yes" ;;
         *) echo "Unknown option: $arg"; usage; exit 1 ;;
     esac
 done
@@ -106,6 +115,31 @@ else
     touch "$PEDESTAL_TXT_PATH"
 fi
 
+# Incremental pipeline: refit only changed eventhist files, then run selection / CT stages in parallel
+if [ -x "$FIT_PIPELINE" ] && [ "$FULL_RERUN" != "yes" ]; then
+    echo "\n--- Incremental fit pipeline ---"
+    case "$METHOD" in
+        all) CHARGE_METHODS="gaus,mean,peak" ;;
+        *) CHARGE_METHODS="$METHOD" ;;
+    esac
+    case "$FIT_OPTION" in
+        --fit-charge) PIPELINE_METHODS="$CHARGE_METHODS" ;;
+        --fit-time) PIPELINE_METHODS="time" ;;
+        --fit-all) PIPELINE_METHODS="$CHARGE_METHODS,time" ;;
+    esac
+    PIPELINE_ARGS=(-m "$PIPELINE_METHODS" --select "$PEDESTAL_TXT_PATH")
+    [ "$PDF_OPTION" == "--no-pdf" ] && PIPELINE_ARGS+=(--no-pdf)
+    [ "$MAKE_CT_PLOT" == "yes" ] && PIPELINE_ARGS+=(--ct)
+    [ -n "$FORCE_OPTION" ] && PIPELINE_ARGS+=("$FORCE_OPTION")
+    "$FIT_PIPELINE" "$TARGET_DIR" "${PIPELINE_ARGS[@]}"
+    PIPELINE_STATUS=$?
+    [ $PIPELINE_STATUS -ne 0 ] && echo "Error: fit_pipeline failed (exit $PIPELINE_STATUS)。失敗した後段の処理は次回やり直します"
+
+    echo "\n=== run_fitter_batch end: $(date) ==="
+    echo "Log saved to: $LOGFILE"
+    exit $PIPELINE_STATUS
+fi
+
 # Process eventhist files
 echo "\n--- Processing eventhist files ---"
 for evf in "$TARGET_DIR"/*_eventhist.root; do
@@ -148,7 +182,7 @@ echo "\n--- Creating summaries and HV vs Charge files ---"
 if [[ "$METHOD" == "gaus" || "$METHOD" == "all" ]]; then
     SUMMARY_FILE_CHARGE="$TARGET_DIR/summary_gausfit_all.txt"
     rm -f "$SUMMARY_FILE_CHARGE"
-    echo "# ch,type,voltage,peak,peak_err,sigma,sigma_err,chi2_ndf,rough_sigma" > "$SUMMARY_FILE_CHARGE"
+    echo "# ch,type,voltage,peak,peak_err,sigma,sigma_err,chi2_ndf,rough_sigma,root_file" > "$SUMMARY_FILE_CHARGE"
     cat "$TARGET_DIR"/*_gausfit.txt | grep -v '^#' >> "$SUMMARY_FILE_CHARGE"
     echo "Running gain selector (gaus)"
     if [ -x "$GAIN_SELECTOR" ]; then
@@ -163,7 +197,7 @@ if [[ "$METHOD" == "mean" || "$METHOD" == "all" ]]; then
     # meanfinder outputs *_mean.txt; select_gain_mean produces selected files and summary
     # create aggregated mean summary so select_gain_mean can read a single CSV-like file
     rm -f "$SUMMARY_FILE_CHARGE_MEAN"
-    echo "# ch,type,voltage,mean,mean_err,rms" > "$SUMMARY_FILE_CHARGE_MEAN"
+    echo "# ch,type,voltage,mean,mean_err,rms,root_file" > "$SUMMARY_FILE_CHARGE_MEAN"
     # Some *_mean.txt files may contain wrapped lines; pick only lines that start with channel number
     grep -h '^[0-9]' "$TARGET_DIR"/*_mean.txt 2>/dev/null >> "$SUMMARY_FILE_CHARGE_MEAN" || true
     if [ -x "$GAIN_SELECTOR_MEAN" ]; then
@@ -183,7 +217,7 @@ fi
 echo "\n--- Time summary aggregation ---"
 SUMMARY_FILE_TIME="$TARGET_DIR/summary_timefit_all.txt"
 rm -f "$SUMMARY_FILE_TIME"
-echo "# ch,type,voltage,tts,sigma,fwhm,peak,tau,chi2_ndf" > "$SUMMARY_FILE_TIME"
+echo "# ch,type,voltage,tts(sigma),sigma,fwhm(calc),peak(calc),peak_err,tau(1/lambda),chi2_ndf" > "$SUMMARY_FILE_TIME"
 cat "$TARGET_DIR"/*_timefit.txt 2>/dev/null | grep -v '^#' >> "$SUMMARY_FILE_TIME" || true
 
 # Create Charge vs Time files if requested
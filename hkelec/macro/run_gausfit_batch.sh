@@ -69,7 +69,7 @@ if [[ "$FIT_OPTION" == "--fit-charge" || "$FIT_OPTION" == "--fit-all" ]]; then
     echo "--- ステップA-2: 電荷フィットのサマリーを作成しています... ---"
     SUMMARY_FILE_CHARGE="$TARGET_DIR/summary_gausfit_all.txt"
     rm -f "$SUMMARY_FILE_CHARGE"
-    echo "# ch,type,voltage,peak,peak_err,sigma,sigma_err,chi2_ndf,rough_sigma" > "$SUMMARY_FILE_CHARGE"
+    echo "# ch,type,voltage,peak,peak_err,sigma,sigma_err,chi2_ndf,rough_sigma,root_file" > "$SUMMARY_FILE_CHARGE"
     cat "$TARGET_DIR"/*_gausfit.txt | grep -v '^#' >> "$SUMMARY_FILE_CHARGE"
     
     echo ""
@@ -89,7 +89,7 @@ if [[ "$FIT_OPTION" == "--fit-time" || "$FIT_OPTION" == "--fit-all" ]]; then
     echo "--- ステップB-2: 時間フィットのサマリーを作成しています... ---"
     SUMMARY_FILE_TIME="$TARGET_DIR/summary_timefit_all.txt"
     rm -f "$SUMMARY_FILE_TIME"
-    echo "# ch,type,voltage,tts,sigma,fwhm,peak,tau,chi2_ndf" > "$SUMMARY_FILE_TIME"
+    echo "# ch,type,voltage,tts,sigma,fwhm,peak,peak_err,tau,chi2_ndf" > "$SUMMARY_FILE_TIME"
     cat "$TARGET_DIR"/*_timefit.txt | grep -v '^#' >> "$SUMMARY_FILE_TIME"
 fi
 
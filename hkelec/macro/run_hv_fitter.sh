@@ -3,6 +3,7 @@
 # id: run_hv_fitter.sh
 # Place: ~/hkelec/DiscreteSoftware/Analysis/macro/
 # Last Edit: 2025-10-16 Gemini
+# (修正: 2026-10-18 Gemini (fit_hv_gain_all があれば全チャンネルを1回で並列にフィットし、ゲイン表 hv_gain_<type>.fitres も書く) )
 #
 # 概要: HV vs Charge のグラフ用テキストファイルを一括でフィットし、
 #       結果をPDFとサマリーテキストファイルに出力する。
@@ -12,13 +13,14 @@
 # 1. 設定
 BASE_DIR="$(dirname "$0")"
 FITTER_EXECUTABLE="${BASE_DIR}/fit_results/fit_hv_gain"
+FITTER_ALL_EXECUTABLE="${BASE_DIR}/fit_results/fit_hv_gain_all"
 
 # 2. 引数の検証
 if [ "$#" -ne 2 ]; then
     echo "使い方: $0 <対象のデータディレクトリ> <データタイプ>"
     echo "データタイプ: "
     echo "  'gaus' -> gausfit系列 (HV_vs_Charge_chXX.txt)"
-    echo "  'peak' -> peakfinder系列 (HV_vs_ChargeSubtracted_hgain_chXX.txt)"
+    echo "  'peak' -> peakfinder系列 (HV_vs_Charge_peak_chXX.txt)"
     echo "  'mean' -> meanfinder系列 (HV_vs_Charge_mean_chXX.txt)"
     exit 1
 fi
@@ -33,7 +35,7 @@ if [ "$DATA_TYPE" == "gaus" ]; then
     FILE_PATTERN="HV_vs_Charge_ch*.txt"
     SUMMARY_FILE="$TARGET_DIR/summary_HV_vs_Charge_gaus_fit_results.txt"
 elif [ "$DATA_TYPE" == "peak" ]; then
-    FILE_PATTERN="HV_vs_Charge_peak_hgain_ch*.txt"
+    FILE_PATTERN="HV_vs_Charge_peak_ch*.txt"
     SUMMARY_FILE="$TARGET_DIR/summary_HV_vs_Charge_peak_fit_results.txt"
 elif [ "$DATA_TYPE" == "mean" ]; then
     # select_gain_mean.C の出力ファイルを使用
@@ -44,11 +46,17 @@ else
     exit 1
 fi
 
-# 4. 最終的なサマリーファイルの準備
+# 4. fit_hv_gain_all があれば、全チャンネルをまとめてフィットする (同じサマリーとゲイン表を書く)
+if [ -x "$FITTER_ALL_EXECUTABLE" ]; then
+    "$FITTER_ALL_EXECUTABLE" "$TARGET_DIR" "$DATA_TYPE"
+    exit $?
+fi
+
+# 5. 最終的なサマリーファイルの準備
 rm -f "$SUMMARY_FILE"
 echo "# ch,param_b,param_b_err,param_a,param_a_err,HV for Gain = 10e7 (if 1 p.e.)" > "$SUMMARY_FILE"
 
-# 5. 対象となるテキストファイルをループ処理
+# 6. 対象となるテキストファイルをループ処理
 for file in "$TARGET_DIR"/$FILE_PATTERN; do
     if [ -f "$file" ]; then
         echo "処理中: $file"
@@ -100,7 +100,7 @@ if [[ "$FIT_OPTION" == "--fit-time" || "$FIT_OPTION" == "--fit-all" ]]; then
     SUMMARY_FILE_TIME="$TARGET_DIR/summary_timefit_all.txt"
     rm -f "$SUMMARY_FILE_TIME"
     # 10. ヘッダーを (gausfit/ttshistofit と) 同一に
-    echo "# ch,type,voltage,tts(sigma),sigma,fwhm(calc),peak(calc),tau(1/lambda),chi2_ndf" > "$SUMMARY_FILE_TIME"
+    echo "# ch,type,voltage,tts(sigma),sigma,fwhm(calc),peak(calc),peak_err,tau(1/lambda),chi2_ndf" > "$SUMMARY_FILE_TIME"
     cat "$TARGET_DIR"/*_timefit.txt | grep -v '^#' >> "$SUMMARY_FILE_TIME"
 fi
 
@@ -120,7 +120,7 @@ if [ "$MAKE_CT_PLOT" == "yes" ]; then
     # create_ct_plot は per-channel の HV_vs_ChargeSelected_ch*.txt を見に行けるため
     # summary_HV_vs_Charge_mean.txt がなくても動作する。ただし時間サマリーは必要なので作成する。
     SUMMARY_FILE_TIME_FOR_CT="$TARGET_DIR/summary_timefit_all.txt"
-    echo "# ch,type,voltage,tts(sigma),sigma,fwhm(calc),peak(calc),tau(1/lambda),chi2_ndf" > "$SUMMARY_FILE_TIME_FOR_CT"
+    echo "# ch,type,voltage,tts(sigma),sigma,fwhm(calc),peak(calc),peak_err,tau(1/lambda),chi2_ndf" > "$SUMMARY_FILE_TIME_FOR_CT"
     # *_timefit.txt があれば結合して summary_timefit_all.txt を作る
     for f in "$TARGET_DIR"/*_timefit.txt; do
         if [ -f "$f" ]; then
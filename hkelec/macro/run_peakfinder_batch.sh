@@ -61,7 +61,7 @@ done
 if [[ "$FIT_OPTION" == "--fit-charge" || "$FIT_OPTION" == "--fit-all" ]]; then
     SUMMARY_FILE="$TARGET_DIR/summary_peak_all.txt"
     rm -f "$SUMMARY_FILE"
-    echo "# ch,type,voltage,peak_pos" > "$SUMMARY_FILE"
+    echo "# ch,type,voltage,peak_pos,root_file" > "$SUMMARY_FILE"
     cat "$TARGET_DIR"/*_peak.txt | grep -v '^#' >> "$SUMMARY_FILE"
     
     TYPE="hgain" # hgainのみ対象
@@ -83,7 +83,7 @@ fi
 if [[ "$FIT_OPTION" == "--fit-time" || "$FIT_OPTION" == "--fit-all" ]]; then
     SUMMARY_FILE_TIME="$TARGET_DIR/summary_timefit_all.txt"
     rm -f "$SUMMARY_FILE_TIME"
-    echo "# ch,type,voltage,tts,sigma,fwhm,peak,tau,chi2_ndf" > "$SUMMARY_FILE_TIME"
+    echo "# ch,type,voltage,tts,sigma,fwhm,peak,peak_err,tau,chi2_ndf" > "$SUMMARY_FILE_TIME"
     # peakfinderは時間フィットの結果を _timefit.txt に出力する
     cat "$TARGET_DIR"/*_timefit.txt | grep -v '^#' >> "$SUMMARY_FILE_TIME"
     echo "時間フィットのサマリーファイルを作成しました: $SUMMARY_FILE_TIME"
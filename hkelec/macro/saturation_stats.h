@@ -0,0 +1,168 @@
+/*
+ * id: saturation_stats.h
+ * Place: ~/hkelec/DiscreteSoftware/Analysis/macro/
+ * Last Edit: 2026-10-18 Gemini
+ *
+ * 概要: hgain / lgain ヒストグラムのサチュレーション統計と、その表 (<出力名>_saturation.txt) の読み書き。
+ * eventtree2hist がヒストグラムを作る時に1回だけ計算して eventhist.root の隣に表を書き、
+ * select_gain / select_gain_mean は ROOT ファイルを開かずに表を読んで判定する。
+ * 統計:
+ *   last_bin_ratio    : 中身が入っている一番右のビンのカウント / その手前の (中身が入っている) ビンのカウント
+ *   overflow_fraction : オーバーフロービンに入ったエントリーの割合
+ *   n_at_threshold    : SATURATION_THRESHOLD 以上の値を持つエントリー数
+ *   saturated         : last_bin_ratio > SATURATION_LAST_BIN_RATIO (従来の check_saturation と同じ基準)
+ * 表が無い古い eventhist では、ROOT ファイルを1回だけ開いてヒストグラムから同じ統計を計算する。
+ * コンパイル不要 (ヘッダーファイル)
+ */
+#ifndef SATURATION_STATS_H
+#define SATURATION_STATS_H
+
+#include <TFile.h>
+#include <TH1.h>
+#include <TKey.h>
+#include <TList.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+const double SATURATION_THRESHOLD = 4000.0;     // hgain がこの ADC 値以上なら飽和域 (readData.cc と同じ)
+const double SATURATION_LAST_BIN_RATIO = 5.0;   // 一番右のビンが手前のビンの何倍より大きければ飽和とみなすか
+
+struct SaturationStats {
+    long entries = 0;
+    long n_at_threshold = 0;
+    double overflow_fraction = 0.0;
+    double last_bin_ratio = 0.0;
+    bool saturated = false;
+};
+
+/**
+ * @brief ヒストグラムの形状からサチュレーション統計を計算する
+ * n_at_threshold は Fill 時に数えた値を渡す (負なら SATURATION_THRESHOLD 以上のビンの中身から数える)。
+ */
+inline SaturationStats saturation_from_hist(const TH1& hist, long n_at_threshold = -1) {
+    SaturationStats s;
+    s.entries = static_cast<long>(hist.GetEntries());
+    int nbins = hist.GetNbinsX();
+    if (s.entries > 0) s.overflow_fraction = hist.GetBinContent(nbins + 1) / static_cast<double>(s.entries);
+
+    if (n_at_threshold < 0) {
+        double n = hist.GetBinContent(nbins + 1);
+        for (int i = hist.FindFixBin(SATURATION_THRESHOLD); i >= 1 && i <= nbins; ++i) n += hist.GetBinContent(i);
+        n_at_threshold = static_cast<long>(n);
+    }
+    s.n_at_threshold = n_at_threshold;
+
+    int last_filled_bin = hist.FindLastBinAbove(0);
+    if (last_filled_bin < 1) return s;
+    double last_content = hist.GetBinContent(last_filled_bin);
+    for (int i = last_filled_bin - 1; i >= 1; --i) {
+        if (hist.GetBinContent(i) > 0) {
+            s.last_bin_ratio = last_content / hist.GetBinContent(i);
+            break;
+        }
+    }
+    s.saturated = s.last_bin_ratio > SATURATION_LAST_BIN_RATIO;
+    return s;
+}
+
+// eventhist の ROOT ファイル名からサチュレーション表の名前を作る (.root -> _saturation.txt)
+inline std::string saturation_table_name(const std::string& root_file) {
+    std::string name = root_file;
+    if (name.size() > 5 && name.compare(name.size() - 5, 5, ".root") == 0) name.resize(name.size() - 5);
+    return name + "_saturation.txt";
+}
+
+using SaturationTable = std::map<std::pair<int, std::string>, SaturationStats>; // (ch, type) -> 統計
+
+inline bool write_saturation_table(const std::string& filename, const SaturationTable& table) {
+    std::ofstream out(filename);
+    if (!out) return false;
+    out << "# threshold=" << SATURATION_THRESHOLD << " last_bin_ratio_cut=" << SATURATION_LAST_BIN_RATIO << std::endl;
+    out << "# ch,type,entries,n_at_threshold,overflow_fraction,last_bin_ratio,saturated" << std::endl;
+    for (auto const& [key, s] : table) {
+        out << key.first << "," << key.second << "," << s.entries << "," << s.n_at_threshold << ","
+            << s.overflow_fraction << "," << s.last_bin_ratio << "," << (s.saturated ? 1 : 0) << std::endl;
+    }
+    return true;
+}
+
+inline bool read_saturation_table(const std::string& filename, SaturationTable& table) {
+    std::ifstream in(filename);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::vector<std::string> cols;
+        std::stringstream ss(line);
+        std::string item;
+        while (std::getline(ss, item, ',')) cols.push_back(item);
+        if (cols.size() < 7) continue;
+        SaturationStats s;
+        s.entries = std::stol(cols[2]);
+        s.n_at_threshold = std::stol(cols[3]);
+        s.overflow_fraction = std::stod(cols[4]);
+        s.last_bin_ratio = std::stod(cols[5]);
+        s.saturated = std::stoi(cols[6]) != 0;
+        table[{std::stoi(cols[0]), cols[1]}] = s;
+    }
+    return true;
+}
+
+/**
+ * @brief ROOT ファイルごとのサチュレーション表を1回だけ読んで引く
+ * 表が無ければ (古い eventhist) ROOT ファイルを1回だけ開いて h_hgain_ch<N> / h_lgain_ch<N> から計算する。
+ */
+class SaturationLookup {
+public:
+    // 見つからなければ nullptr
+    const SaturationStats* Find(const std::string& root_file, int ch, const std::string& type) {
+        auto it = tables_.find(root_file);
+        if (it == tables_.end()) it = tables_.emplace(root_file, Load(root_file)).first;
+        auto s = it->second.find({ch, type});
+        return s == it->second.end() ? nullptr : &s->second;
+    }
+
+    bool IsSaturated(const std::string& root_file, int ch, const std::string& type) {
+        const SaturationStats* s = Find(root_file, ch, type);
+        return s && s->saturated;
+    }
+
+    int NFallback() const { return n_fallback_; }
+
+private:
+    SaturationTable Load(const std::string& root_file) {
+        SaturationTable table;
+        if (read_saturation_table(saturation_table_name(root_file), table)) return table;
+
+        n_fallback_++;
+        TFile* file = TFile::Open(root_file.c_str(), "READ");
+        if (!file || file->IsZombie()) {
+            std::cerr << "警告: サチュレーション表も ROOT ファイル " << root_file << " も開けません" << std::endl;
+            delete file;
+            return table;
+        }
+        for (TObject* key : *file->GetListOfKeys()) {
+            int ch;
+            char type[16];
+            if (std::sscanf(key->GetName(), "h_%15[a-z]_ch%d", type, &ch) != 2) continue;
+            std::string t = type;
+            if (t != "hgain" && t != "lgain") continue;
+            if (auto hist = file->Get<TH1>(key->GetName())) table[{ch, t}] = saturation_from_hist(*hist);
+        }
+        file->Close();
+        delete file;
+        return table;
+    }
+
+    std::map<std::string, SaturationTable> tables_;
+    int n_fallback_ = 0;
+};
+
+#endif // SATURATION_STATS_H
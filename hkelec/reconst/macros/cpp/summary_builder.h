@@ -0,0 +1,770 @@
+/*
+ * id: summary_builder.h
+ * Place: /home/daiki/keio/hkelec/reconst/macros/cpp/
+ * Last Edit: 2026-10-18 Gemini
+ *
+ * 概要: Charge vs 各種パラメータのサマリーを作る共通の処理 (plot_summary と plot_from_csv から使う)。
+ * 1. 入力からグラフ (ch, type) ごとの点 (SummaryGraph) を作り、(ch, グラフの種類) の順に1つの配列に並べる。
+ *    - フィット結果 (plot_summary): <run>_charge.fitres / <run>_time.fitres (無ければ _mean.txt / _timefit.txt) を
+ *      fit_result_store.h で読み、(ch, key) でソートした平坦な配列 (SummaryRow) にして、電荷と時間を1回の走査で突き合わせる。
+ *    - CSV (plot_from_csv): plot_summary が書いた Charge_vs_<type>_ch<NN>.csv (外れ値の include_in_fit を手で 0 にしたもの)。
+ * 2. グラフを p0*x^{-1/2} + p1 + p2*x + p3*x^2 で2段階フィットし、fit範囲内の最小値とその誤差を求める。
+ *    チャンネルごとのジョブを -j のスレッド数で並列に処理する (2 スレッド以上では TMinuit の代わりに Minuit2 を使う)。
+ * 3. インクリメンタル (--incremental): チャンネルごとの点のハッシュをキャッシュ (.summary_cache.txt) と比べ、
+ *    変わっていないチャンネルはフィットせずに前回の結果のファイルの値を使う (グラフごとの CSV も書き直さない)。
+ *    PDF はどれかのチャンネルが変わった (か PDF が無い) 時だけ、前回の結果のページも含めて書き直す。
+ * 4. PDF は全グラフを1ファイル (1ページ1グラフ) に、描画のスレッドで書く (plot_output.h)。
+ *    フィット曲線はジョブの中で点にしておき、描画のスレッドでは TF1 を作らない。
+ * コンパイル不要 (ヘッダーファイル)
+ */
+#ifndef SUMMARY_BUILDER_H
+#define SUMMARY_BUILDER_H
+
+#include <Math/MinimizerOptions.h>
+#include <TAxis.h>
+#include <TF1.h>
+#include <TFitResult.h>
+#include <TFitResultPtr.h>
+#include <TGraphErrors.h>
+#include <TMath.h>
+#include <TMatrixDSym.h>
+#include <TROOT.h>
+#include <TString.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// フィット結果の表の読み込み・PDF 出力 (macro/fit_results)
+#include "fit_result_store.h"
+#include "plot_output.h"
+
+const int SUMMARY_BUILDER_VERSION = 1;                   // フィット・結果の形式を変えたら上げる (キャッシュを無効にする)
+const char* const SUMMARY_CACHE_NAME = ".summary_cache.txt";
+const int SUMMARY_NPAR = 4;
+
+// グラフの種類 (この順に並べる。CSV にこれ以外の種類があれば後ろに名前順)
+enum SummaryGraphType { kMean, kRMS, kPeak, kTTS, kMu, kSigma, kGamma, kTau, kGausAmp, kGausMu, kGausSigma, kNGraphTypes };
+const std::vector<std::string> SUMMARY_GRAPH_TYPES = {
+    "Mean", "RMS", "Peak", "TTS", "Mu", "Sigma", "Gamma", "Tau",
+    "GausAmp", "GausMu", "GausSigma"
+};
+
+enum class SummaryMode {
+    Results,   // フィット結果から (plot_summary)
+    Csv        // Charge_vs_*.csv から (plot_from_csv)
+};
+
+// 1つの (ch, key) の電荷と時間のパラメータ
+struct SummaryRow {
+    int ch = -1;
+    std::string key;   // run
+    double charge = 0, charge_err = 0;
+
+    // ヒストグラム統計量
+    double h_mean = 0, h_mean_err = 0, h_rms = 0, h_rms_err = 0;
+    bool hist_valid = false;
+
+    // EMG フィットパラメータ
+    double peak = 0, peak_err = 0, tts = 0, tts_err = 0;
+    double mu = 0, gamma = 0, sigma = 0, lambda = 0;
+    bool fit_valid = false;
+
+    // ガウスフィットパラメータ
+    double g_amp = 0, g_amp_err = 0, g_mu = 0, g_mu_err = 0, g_sigma = 0, g_sigma_err = 0;
+    bool g_valid = false;
+
+    double Tau() const { return (fit_valid && lambda > 1e-9) ? (1.0 / lambda) : -9999; }
+};
+
+inline bool summary_row_less(const SummaryRow& a, const SummaryRow& b) {
+    return std::tie(a.ch, a.key) < std::tie(b.ch, b.key);
+}
+
+// 1つのグラフ (ch, type) の点
+struct SummaryGraph {
+    int ch = -1;
+    std::string type;
+    std::vector<double> x, ex, y, ey;
+    std::vector<int> include;   // 1: フィットに使う (CSV の include_in_fit)
+
+    void Add(double xv, double exv, double yv, double eyv, int inc = 1) {
+        x.push_back(xv); ex.push_back(exv);
+        y.push_back(yv); ey.push_back(eyv);
+        include.push_back(inc);
+    }
+};
+
+// 1つのグラフのフィット結果とページに描く範囲・曲線
+struct SummaryFit {
+    bool fitted = false;    // フィットした (か前回の結果を使った)
+    bool cached = false;    // 前回の結果
+    double p[SUMMARY_NPAR] = {0, 0, 0, 0}, p_err[SUMMARY_NPAR] = {0, 0, 0, 0};
+    double chi2 = 0, ndf = 0, min_val = 0, min_err = 0, at_charge = 0;
+    double range_min = 0, range_max = 0;      // フィット範囲
+    double display_min = 0, display_max = 0;  // 描画の x 範囲
+    std::vector<double> curve_x, curve_y;     // フィット曲線 (描画用)
+};
+
+struct SummaryOptions {
+    SummaryMode mode = SummaryMode::Results;
+    bool save_pdf = true;
+    bool incremental = false;
+    int n_threads = 1;
+};
+
+// モデル: p0*x^{-1/2} + p1 + p2*x + p3*x^2
+inline double summary_model(double* x, double* p) {
+    return p[0] * std::pow(x[0], -0.5) + p[1] + p[2] * x[0] + p[3] * x[0] * x[0];
+}
+
+// 誤差伝播: fit範囲内の最小値 min_x f(x; p) の不確かさ
+// 包絡線定理から d(最小値)/dp_i = ∂f/∂p_i (x = 最小値の位置) なので、パラメータを動かして最小値を探し直す必要はない
+// (範囲の端で最小になる場合も同じ)。モデルはパラメータについて線形なので GradientPar の微分は正確。
+inline Double_t GetMinimumError(TF1 *f, const TMatrixDSym &cov, Double_t x_min)
+{
+    int nPar = f->GetNpar();
+    std::vector<Double_t> grad(nPar);
+    f->GradientPar(&x_min, grad.data());
+
+    Double_t variance = 0.0;
+    for (int i = 0; i < nPar; ++i) {
+        for (int j = 0; j < nPar; ++j) {
+            variance += grad[i] * grad[j] * cov(i, j);
+        }
+    }
+    return (variance > 0) ? TMath::Sqrt(variance) : 0.0;
+}
+
+// 結果・PDF・キャッシュのファイル名 (モードごと)
+inline std::string summary_results_name(SummaryMode mode) {
+    return mode == SummaryMode::Results ? "fit_results_summary.txt" : "fit_results_from_csv.csv";
+}
+inline std::string summary_pdf_name(SummaryMode mode) {
+    return mode == SummaryMode::Results ? "Charge_vs_summary.pdf" : "Refitted_Charge_vs_summary.pdf";
+}
+inline std::string summary_mode_name(SummaryMode mode) {
+    return mode == SummaryMode::Results ? "results" : "csv";
+}
+
+// グラフの種類の並び順 (SUMMARY_GRAPH_TYPES の順、それ以外は後ろ)
+inline size_t summary_type_rank(const std::string& type) {
+    auto it = std::find(SUMMARY_GRAPH_TYPES.begin(), SUMMARY_GRAPH_TYPES.end(), type);
+    return static_cast<size_t>(it - SUMMARY_GRAPH_TYPES.begin());
+}
+
+inline std::string summary_y_unit(const std::string& type) {
+    if (type == "Gamma" || type.find("Amp") != std::string::npos) return "[arb. units]";
+    if (type == "Mean" || type == "Peak" || type == "GausMu") return "[ns (abs)]";
+    return "[ns]";
+}
+
+// --- 1. 入力 ---
+
+/**
+ * @brief フィット結果の表から (ch, key) ごとの行を作る ((ch, key) の順)
+ * 電荷は charge 表の pc_by_h / pc_by_l の行、時間は time 表の行 (失敗したフィットの値は -9999)。
+ * 同じ (ch, key) が複数あれば後の行を使い、電荷と時間の両方がある (ch, key) だけを返す。
+ */
+inline std::vector<SummaryRow> build_summary_rows(const FitResultStore& store) {
+    // --- Chargeデータ ---
+    const FitTable& charge = store.Table("charge");
+    std::string c_val = charge.Has("charge") ? "charge" : "mean";     // .fitres / 従来の _mean.txt
+    std::string c_err = charge.Has("charge") ? "charge_err" : "mean_err";
+    std::vector<SummaryRow> charges;
+    for (size_t row = 0; row < charge.Rows(); ++row) {
+        FitKey k = charge.Key(row);
+        if (k.type != "pc_by_h" && k.type != "pc_by_l") continue;
+        SummaryRow r;
+        r.ch = k.ch;
+        r.key = k.run;
+        r.charge = charge.Num(row, c_val);
+        r.charge_err = charge.Num(row, c_err);
+        charges.push_back(std::move(r));
+    }
+
+    // --- Timeデータ ---
+    const FitTable& time = store.Table("time");
+    std::vector<SummaryRow> times;
+    for (size_t row = 0; row < time.Rows(); ++row) {
+        FitKey k = time.Key(row);
+        auto v = [&](const char* name) { return time.Num(row, name); };
+        SummaryRow r;
+        r.ch = k.ch;
+        r.key = k.run;
+
+        // --- EMG Parameters ---
+        r.fit_valid = v("peak") > -9000;
+        if (r.fit_valid) {
+            r.peak = v("peak"); r.peak_err = v("peak_err");
+            r.tts = v("tts");   r.tts_err = v("tts_err");
+            r.mu = v("mu"); r.gamma = v("gamma");
+            r.sigma = v("sigma"); r.lambda = v("lambda");
+        }
+
+        // --- Hist Stats ---
+        r.h_mean = v("mean"); r.h_mean_err = v("mean_err");
+        r.h_rms = v("rms");   r.h_rms_err = v("rms_err");
+        r.hist_valid = !std::isnan(r.h_mean);
+
+        // --- Gaussian Parameters ---
+        r.g_valid = v("g_mu") > -9000;
+        if (r.g_valid) {
+            r.g_amp = v("g_amp");     r.g_amp_err = v("g_amp_err");
+            r.g_mu = v("g_mu");       r.g_mu_err = v("g_mu_err");
+            r.g_sigma = v("g_sigma"); r.g_sigma_err = v("g_sigma_err");
+        }
+        times.push_back(std::move(r));
+    }
+
+    // (ch, key) でソートし、同じキーは後の行を残す
+    auto sort_unique = [](std::vector<SummaryRow>& v) {
+        std::stable_sort(v.begin(), v.end(), summary_row_less);
+        std::vector<SummaryRow> out;
+        out.reserve(v.size());
+        for (size_t i = 0; i < v.size(); ++i) {
+            if (i + 1 < v.size() && !summary_row_less(v[i], v[i + 1])) continue;
+            out.push_back(std::move(v[i]));
+        }
+        v.swap(out);
+    };
+    sort_unique(charges);
+    sort_unique(times);
+
+    // 突き合わせ (両方ソート済みなので1回の走査)
+    std::vector<SummaryRow> rows;
+    size_t i = 0, j = 0;
+    while (i < charges.size() && j < times.size()) {
+        if (summary_row_less(charges[i], times[j])) ++i;
+        else if (summary_row_less(times[j], charges[i])) ++j;
+        else {
+            SummaryRow r = std::move(times[j]);
+            r.charge = charges[i].charge;
+            r.charge_err = charges[i].charge_err;
+            rows.push_back(std::move(r));
+            ++i; ++j;
+        }
+    }
+    return rows;
+}
+
+/**
+ * @brief (ch, key) の順の行からグラフを作る ((ch, 種類) の順。点の無いグラフは作らない)
+ * ヒストグラム統計量は常に、EMG・ガウスのパラメータはフィットが成功した行だけ点にする。
+ */
+inline std::vector<SummaryGraph> make_summary_graphs(const std::vector<SummaryRow>& rows) {
+    std::vector<SummaryGraph> graphs;
+    for (size_t b = 0; b < rows.size();) {
+        size_t e = b;
+        while (e < rows.size() && rows[e].ch == rows[b].ch) ++e;
+
+        std::vector<SummaryGraph> g(kNGraphTypes);
+        for (int t = 0; t < kNGraphTypes; ++t) {
+            g[t].ch = rows[b].ch;
+            g[t].type = SUMMARY_GRAPH_TYPES[t];
+        }
+        for (size_t i = b; i < e; ++i) {
+            const SummaryRow& r = rows[i];
+            double x = r.charge, ex = r.charge_err;
+            if (r.hist_valid) {
+                g[kMean].Add(x, ex, r.h_mean, r.h_mean_err);
+                g[kRMS].Add(x, ex, r.h_rms, r.h_rms_err);
+            }
+            if (r.fit_valid) {
+                g[kPeak].Add(x, ex, r.peak, r.peak_err);
+                g[kTTS].Add(x, ex, r.tts, r.tts_err);
+                g[kMu].Add(x, ex, r.mu, 0);
+                g[kSigma].Add(x, ex, r.sigma, 0);
+                g[kGamma].Add(x, ex, r.gamma, 0);
+                g[kTau].Add(x, ex, r.Tau(), 0);
+            }
+            if (r.g_valid) {
+                g[kGausAmp].Add(x, ex, r.g_amp, r.g_amp_err);
+                g[kGausMu].Add(x, ex, r.g_mu, r.g_mu_err);
+                g[kGausSigma].Add(x, ex, r.g_sigma, r.g_sigma_err);
+            }
+        }
+        for (auto& graph : g) {
+            if (!graph.x.empty()) graphs.push_back(std::move(graph));
+        }
+        b = e;
+    }
+    return graphs;
+}
+
+/**
+ * @brief ディレクトリの Charge_vs_<type>_ch<NN>.csv を読む ((ch, 種類) の順)
+ * 列は charge,charge_err,<type>,<type>_err,include_in_fit (include_in_fit が無ければ全点をフィットに使う)。
+ */
+inline std::vector<SummaryGraph> load_summary_csvs(const std::string& dir) {
+    std::vector<SummaryGraph> graphs;
+    const std::regex name_re("Charge_vs_(.+)_ch(\\d+)\\.csv");
+    std::error_code ec;
+    for (const auto& e : std::filesystem::directory_iterator(dir, ec)) {
+        std::string name = e.path().filename().string();
+        std::smatch match;
+        if (!std::regex_match(name, match, name_re)) continue;
+        FitTable t;
+        if (!FitTable::Load(e.path().string(), t) || t.Columns().size() < 4) {
+            std::cerr << "警告: " << e.path().string() << " を読めません" << std::endl;
+            continue;
+        }
+        SummaryGraph g;
+        g.ch = std::stoi(match.str(2));
+        g.type = match.str(1);
+        int c_inc = t.Col("include_in_fit");
+        for (size_t r = 0; r < t.Rows(); ++r) {
+            double v[4];
+            bool ok = true;
+            for (int c = 0; c < 4; ++c) {
+                v[c] = t.Num(r, c);
+                ok = ok && !std::isnan(v[c]);
+            }
+            if (!ok) continue;
+            double inc = t.Num(r, c_inc);
+            g.Add(v[0], v[1], v[2], v[3], std::isnan(inc) ? 1 : static_cast<int>(inc));
+        }
+        if (!g.x.empty()) graphs.push_back(std::move(g));
+    }
+    if (ec) std::cerr << "エラー: ディレクトリ " << dir << " を開けません" << std::endl;
+    std::sort(graphs.begin(), graphs.end(), [](const SummaryGraph& a, const SummaryGraph& b) {
+        return std::make_tuple(a.ch, summary_type_rank(a.type), a.type) < std::make_tuple(b.ch, summary_type_rank(b.type), b.type);
+    });
+    return graphs;
+}
+
+// --- 2. フィット ---
+
+// TF1 の生成・破棄は gROOT の関数リストを触るので、全スレッド共通の mutex で保護する
+inline std::mutex& summary_tf1_mutex() { static std::mutex m; return m; }
+
+// フィット範囲と描画範囲
+// フィット結果から: データの範囲 (マージン10%程度)、x^{-1/2} を含むため 0 を跨がないように下限を微小正数へ
+// CSV から: 描画は全点、フィットは include_in_fit = 1 の点だけの範囲
+inline void summary_ranges(const SummaryGraph& g, SummaryMode mode, SummaryFit& f) {
+    double x_min_data = *std::min_element(g.x.begin(), g.x.end());
+    double x_max_data = *std::max_element(g.x.begin(), g.x.end());
+    f.display_min = (x_min_data < 0) ? x_min_data * 1.1 : 0.0;
+    f.display_max = (x_max_data > 0) ? x_max_data * 1.1 : 100.0;
+    if (f.display_min <= 0) f.display_min = 1e-6;
+    f.range_min = f.display_min;
+    f.range_max = f.display_max;
+    if (mode != SummaryMode::Csv) return;
+
+    double x_min_fit = 0, x_max_fit = 0;
+    bool any = false;
+    for (size_t i = 0; i < g.x.size(); ++i) {
+        if (g.include[i] != 1) continue;
+        x_min_fit = any ? std::min(x_min_fit, g.x[i]) : g.x[i];
+        x_max_fit = any ? std::max(x_max_fit, g.x[i]) : g.x[i];
+        any = true;
+    }
+    if (!any) return;
+    f.range_min = (x_min_fit < 0) ? x_min_fit * 1.1 : x_min_fit * 0.9;
+    f.range_max = x_max_fit * 1.1;
+    if (f.range_min <= 0) f.range_min = 1e-6;
+}
+
+// フィット曲線を点にする (描画用)
+inline void summary_curve(SummaryFit& f, int n = 200) {
+    f.curve_x.clear();
+    f.curve_y.clear();
+    if (!f.fitted || !(f.range_max > f.range_min)) return;
+    for (int i = 0; i < n; ++i) {
+        double x = f.range_min + (f.range_max - f.range_min) * i / (n - 1);
+        f.curve_x.push_back(x);
+        f.curve_y.push_back(summary_model(&x, f.p));
+    }
+}
+
+/**
+ * @brief 1つのグラフを2段階でフィットし、最小値とその誤差を求める
+ * フィットに使う点 (include = 1) が min_points 未満ならフィットしない (f.fitted = false)。
+ * CSV からのフィットは y の最小値で初期値を切り替える (絶対時刻の Mean/Peak と幅などで大きさが違う)。
+ */
+inline void fit_summary_graph(const SummaryGraph& g, SummaryMode mode, SummaryFit& f) {
+    summary_ranges(g, mode, f);
+    std::vector<double> x, ex, y, ey;
+    for (size_t i = 0; i < g.x.size(); ++i) {
+        if (g.include[i] != 1) continue;
+        x.push_back(g.x[i]); ex.push_back(g.ex[i]);
+        y.push_back(g.y[i]); ey.push_back(g.ey[i]);
+    }
+    size_t min_points = (mode == SummaryMode::Csv) ? SUMMARY_NPAR : 1;
+    if (x.size() < min_points) {
+        std::cerr << "Warning: Not enough include_in_fit points for fitting (Ch" << g.ch << ", " << g.type << "). Skipping fit." << std::endl;
+        return;
+    }
+
+    TGraphErrors gr(static_cast<int>(x.size()), x.data(), y.data(), ex.data(), ey.data());
+    TF1* f_model;
+    {
+        std::lock_guard<std::mutex> lock(summary_tf1_mutex());
+        f_model = new TF1(TString::Format("f_model_ch%02d_%s", g.ch, g.type.c_str()), summary_model, f.range_min, f.range_max, SUMMARY_NPAR);
+    }
+    if (mode == SummaryMode::Csv) {
+        double y_min_data = *std::min_element(g.y.begin(), g.y.end());
+        if (y_min_data >= 100.0) f_model->SetParameters(18.66, 247.0, -0.005, 0.0);
+        else f_model->SetParameters(3.5, 0.0, 0.0, 0.0);
+    } else {
+        f_model->SetParameters(0.0, 0.0, 0.0, 0.0);
+    }
+
+    // 1回目の結果を初期値として2回目のフィット (描画はページで行うので N)
+    gr.Fit(f_model, "QSN", "", f.range_min, f.range_max);
+    TFitResultPtr r2 = gr.Fit(f_model, "QSN", "", f.range_min, f.range_max);
+
+    // 最小値の算出 (fit範囲内で) とその誤差 (パラメータ共分散による誤差伝播)
+    f.min_val = f_model->GetMinimum(f.range_min, f.range_max);
+    f.at_charge = f_model->GetMinimumX(f.range_min, f.range_max);
+    TMatrixDSym cov = r2.Get() ? r2->GetCovarianceMatrix() : TMatrixDSym();
+    f.min_err = 0.0;
+    if (cov.GetNrows() == f_model->GetNpar()) {
+        f.min_err = GetMinimumError(f_model, cov, f.at_charge);
+    } else {
+        std::cerr << "Warning: covariance matrix unavailable for Ch" << g.ch << ", " << g.type << " (min_err set to 0)" << std::endl;
+    }
+
+    for (int i = 0; i < SUMMARY_NPAR; ++i) {
+        f.p[i] = f_model->GetParameter(i);
+        f.p_err[i] = f_model->GetParError(i);
+    }
+    f.chi2 = f_model->GetChisquare();
+    f.ndf = f_model->GetNDF();
+    f.fitted = true;
+    {
+        std::lock_guard<std::mutex> lock(summary_tf1_mutex());
+        delete f_model;
+    }
+}
+
+// --- 3. インクリメンタル ---
+
+// チャンネルの点 (とモード・形式のバージョン) のハッシュ (FNV-1a)
+inline std::string summary_channel_hash(const std::vector<SummaryGraph>& graphs, size_t begin, size_t end, SummaryMode mode) {
+    uint64_t h = 1469598103934665603ULL;
+    auto add = [&h](const void* data, size_t n) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < n; ++i) {
+            h ^= p[i];
+            h *= 1099511628211ULL;
+        }
+    };
+    std::string head = "summary=" + std::to_string(SUMMARY_BUILDER_VERSION) + ";mode=" + summary_mode_name(mode);
+    add(head.data(), head.size());
+    for (size_t i = begin; i < end; ++i) {
+        const SummaryGraph& g = graphs[i];
+        add(g.type.data(), g.type.size() + 1);
+        size_t n = g.x.size();
+        add(&n, sizeof(n));
+        add(g.x.data(), n * sizeof(double));
+        add(g.ex.data(), n * sizeof(double));
+        add(g.y.data(), n * sizeof(double));
+        add(g.ey.data(), n * sizeof(double));
+        add(g.include.data(), n * sizeof(int));
+    }
+    std::ostringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << h;
+    return ss.str();
+}
+
+// (モード, ch) -> 前回の点のハッシュ
+using SummaryCache = std::map<std::pair<std::string, int>, std::string>;
+
+inline SummaryCache read_summary_cache(const std::string& path) {
+    SummaryCache cache;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::vector<std::string> cols;
+        std::stringstream ss(line);
+        std::string item;
+        while (std::getline(ss, item, ',')) cols.push_back(item);
+        if (cols.size() != 3) continue;
+        cache[{cols[0], std::atoi(cols[1].c_str())}] = cols[2];
+    }
+    return cache;
+}
+
+// 途中で止まっても壊れないように、一時ファイルに書いてから置き換える
+inline bool write_summary_cache(const std::string& path, const SummaryCache& cache) {
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp);
+        if (!out) return false;
+        out << "# summary_builder cache version=" << SUMMARY_BUILDER_VERSION << std::endl;
+        out << "# mode,ch,hash" << std::endl;
+        for (auto const& [key, hash] : cache) out << key.first << "," << key.second << "," << hash << std::endl;
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// 前回の結果のファイル -> (ch, 種類) ごとの結果 (読めなければ false)
+inline bool load_summary_results(const std::string& path, std::map<std::pair<int, std::string>, SummaryFit>& out) {
+    FitTable t;
+    if (!std::filesystem::exists(path) || !FitTable::Load(path, t) || !t.Has("graph_type") || !t.Has("at_charge")) return false;
+    for (size_t r = 0; r < t.Rows(); ++r) {
+        SummaryFit f;
+        for (int i = 0; i < SUMMARY_NPAR; ++i) {
+            f.p[i] = t.Num(r, "p" + std::to_string(i));
+            f.p_err[i] = t.Num(r, "p" + std::to_string(i) + "_err");
+        }
+        f.chi2 = t.Num(r, "chi2");
+        f.ndf = t.Num(r, "ndf");
+        f.min_val = t.Num(r, "min_val");
+        f.min_err = t.Num(r, "min_err");
+        f.at_charge = t.Num(r, "at_charge");
+        f.fitted = f.cached = true;
+        out[{static_cast<int>(t.Num(r, "ch")), t.Str(r, "graph_type")}] = f;
+    }
+    return true;
+}
+
+// --- 4. 出力 ---
+
+// フィット結果から作った (ch, key) ごとの全データ (外れ値を見つける用)
+inline bool write_summary_rows_csv(const std::string& path, const std::vector<SummaryRow>& rows) {
+    std::ofstream out(path);
+    if (!out) return false;
+    out << "ch,key,charge,charge_err,"
+        << "h_mean,h_mean_err,h_rms,h_rms_err,"
+        << "peak,peak_err,tts,tts_err,"
+        << "g_amp,g_amp_err,g_mu,g_mu_err,g_sigma,g_sigma_err,"
+        << "mu,gamma,sigma,tau,fit_valid,g_valid" << std::endl;
+    for (const auto& t : rows) {
+        out << t.ch << "," << t.key << ","
+            << t.charge << "," << t.charge_err << ","
+            << t.h_mean << "," << t.h_mean_err << ","
+            << t.h_rms << "," << t.h_rms_err << ","
+            << (t.fit_valid ? t.peak : -9999) << "," << (t.fit_valid ? t.peak_err : 0) << ","
+            << (t.fit_valid ? t.tts : -9999) << "," << (t.fit_valid ? t.tts_err : 0) << ","
+            << (t.g_valid ? t.g_amp : -9999) << "," << (t.g_valid ? t.g_amp_err : 0) << ","
+            << (t.g_valid ? t.g_mu : -9999) << "," << (t.g_valid ? t.g_mu_err : 0) << ","
+            << (t.g_valid ? t.g_sigma : -9999) << "," << (t.g_valid ? t.g_sigma_err : 0) << ","
+            << (t.fit_valid ? t.mu : -9999) << ","
+            << (t.fit_valid ? t.gamma : -9999) << ","
+            << (t.fit_valid ? t.sigma : -9999) << ","
+            << t.Tau() << ","
+            << t.fit_valid << "," << t.g_valid << std::endl;
+    }
+    return static_cast<bool>(out);
+}
+
+// グラフの点の CSV (include_in_fit フラグ付き。plot_from_csv の入力)
+inline void write_summary_graph_csv(const std::string& dir, const SummaryGraph& g) {
+    std::ofstream csv(TString::Format("%s/Charge_vs_%s_ch%02d.csv", dir.c_str(), g.type.c_str(), g.ch).Data());
+    csv << "charge,charge_err," << g.type << "," << g.type << "_err,include_in_fit" << std::endl;
+    for (size_t i = 0; i < g.x.size(); ++i) {
+        csv << g.x[i] << "," << g.ex[i] << "," << g.y[i] << "," << g.ey[i] << "," << g.include[i] << std::endl;
+    }
+}
+
+// フィットのパラメータ (パラメータは p0*x^{-1/2} + p1 + p2*x + p3*x^2) と最小値 (min_val, min_err, at_charge)
+inline bool write_summary_results(const std::string& path, SummaryMode mode, const std::vector<SummaryGraph>& graphs,
+                                  const std::vector<SummaryFit>& fits) {
+    std::ofstream out(path);
+    if (!out) return false;
+    out << (mode == SummaryMode::Results ? "# " : "")
+        << "ch,graph_type,p0,p0_err,p1,p1_err,p2,p2_err,p3,p3_err,chi2,ndf,min_val,min_err,at_charge" << std::endl;
+    for (size_t i = 0; i < graphs.size(); ++i) {
+        const SummaryFit& f = fits[i];
+        if (!f.fitted) continue;
+        out << graphs[i].ch << "," << graphs[i].type;
+        for (int k = 0; k < SUMMARY_NPAR; ++k) out << "," << f.p[k] << "," << f.p_err[k];
+        out << "," << f.chi2 << "," << f.ndf << "," << f.min_val << "," << f.min_err << "," << f.at_charge << std::endl;
+    }
+    return static_cast<bool>(out);
+}
+
+/**
+ * @brief グラフの1ページ (描画のスレッドで呼ばれる。描いたオブジェクトは次のページで消える)
+ * include_in_fit = 1 の点は黒●、0 の点は青×、フィット曲線は赤。
+ * CSV からのグラフは外れ値も入るように y の範囲を全点に合わせる。
+ */
+inline PlotBookWriter::DrawFn summary_page(const SummaryGraph* g, const SummaryFit* f, SummaryMode mode) {
+    return [g, f, mode](TCanvas& c) {
+        c.SetGrid();
+        auto included = new TGraphErrors();
+        auto excluded = new TGraphErrors();
+        for (size_t i = 0; i < g->x.size(); ++i) {
+            TGraphErrors* gr = (g->include[i] == 1) ? included : excluded;
+            gr->SetPoint(gr->GetN(), g->x[i], g->y[i]);
+            gr->SetPointError(gr->GetN() - 1, g->ex[i], g->ey[i]);
+        }
+        included->SetMarkerStyle(20);  // ●
+        included->SetMarkerColor(kBlack);
+        included->SetMarkerSize(0.8);
+        excluded->SetMarkerStyle(5);   // ×
+        excluded->SetMarkerColor(kBlue);
+        excluded->SetMarkerSize(2.0);
+        included->SetBit(TObject::kCanDelete);
+        excluded->SetBit(TObject::kCanDelete);
+
+        // 軸は点のある方のグラフで描く
+        TGraphErrors* frame = included->GetN() > 0 ? included : excluded;
+        TGraphErrors* other = frame == included ? excluded : included;
+        frame->SetTitle(Form("Ch%d %s;Charge [pC];%s %s", g->ch, g->type.c_str(), g->type.c_str(), summary_y_unit(g->type).c_str()));
+        frame->GetXaxis()->SetLimits(f->display_min, f->display_max);
+        if (mode == SummaryMode::Csv) {
+            double y_min_data = *std::min_element(g->y.begin(), g->y.end());
+            double y_max_data = *std::max_element(g->y.begin(), g->y.end());
+            double y_span = y_max_data - y_min_data;
+            if (y_span <= 0) y_span = std::max(std::abs(y_max_data), 1.0);
+            frame->GetYaxis()->SetRangeUser(y_min_data - 0.1 * y_span, y_max_data + 0.1 * y_span);
+        }
+        frame->Draw("APE");
+        if (other->GetN() > 0) other->Draw("PE");
+
+        if (!f->curve_x.empty()) {
+            auto curve = new TGraph(static_cast<int>(f->curve_x.size()), f->curve_x.data(), f->curve_y.data());
+            curve->SetLineColor(kRed);
+            curve->SetLineWidth(2);
+            curve->SetBit(TObject::kCanDelete);
+            curve->Draw("L");
+        }
+    };
+}
+
+// --- 5. まとめ ---
+
+/**
+ * @brief 入力を読み、全グラフをフィットして結果・PDF (・フィット結果からはグラフごとの CSV と全データ) を書く
+ * @return 0: 成功, 1: 入力が無い
+ */
+inline int run_summary_builder(const std::string& dir, const SummaryOptions& opt) {
+    SummaryMode mode = opt.mode;
+
+    // 1. 入力
+    std::vector<SummaryGraph> graphs;
+    std::string rows_csv_path;
+    if (mode == SummaryMode::Results) {
+        // meanfinder が書いた <run>_charge.fitres (pC) と <run>_time.fitres を読む。
+        // 無ければ従来の _mean.txt / _timefit.txt を列名で読む。run (ファイル名から _eventhist.root 等を除いたもの) で対応付ける
+        FitResultStore store;
+        store.LoadDir(dir, {{"charge", "_mean.txt"}, {"time", "_timefit.txt"}});
+        std::vector<SummaryRow> rows = build_summary_rows(store);
+        rows_csv_path = dir + "/summary_all_data.csv";
+        if (!write_summary_rows_csv(rows_csv_path, rows)) std::cerr << "警告: " << rows_csv_path << " を書けません" << std::endl;
+        graphs = make_summary_graphs(rows);
+    } else {
+        graphs = load_summary_csvs(dir);
+    }
+    if (graphs.empty()) {
+        std::cerr << "エラー: " << dir << " に"
+                  << (mode == SummaryMode::Results ? "電荷と時間の両方があるフィット結果" : " Charge_vs_*_ch*.csv") << "がありません" << std::endl;
+        return 1;
+    }
+
+    // チャンネルごとのグラフの範囲 [begin, end)
+    std::vector<std::pair<size_t, size_t>> channels;
+    for (size_t b = 0; b < graphs.size();) {
+        size_t e = b;
+        while (e < graphs.size() && graphs[e].ch == graphs[b].ch) ++e;
+        channels.push_back({b, e});
+        b = e;
+    }
+
+    // 2. インクリメンタル: 点が前回と同じチャンネルは前回の結果を使う
+    std::string results_path = dir + "/" + summary_results_name(mode);
+    std::string cache_path = dir + "/" + SUMMARY_CACHE_NAME;
+    std::string pdf_path = dir + "/" + summary_pdf_name(mode);
+    std::vector<std::string> hashes(channels.size());
+    std::vector<char> fresh(channels.size(), 0);
+    std::map<std::pair<int, std::string>, SummaryFit> previous;
+    SummaryCache cache = read_summary_cache(cache_path);
+    bool have_previous = opt.incremental && load_summary_results(results_path, previous);
+    size_t n_fresh = 0;
+    for (size_t c = 0; c < channels.size(); ++c) {
+        hashes[c] = summary_channel_hash(graphs, channels[c].first, channels[c].second, mode);
+        if (!have_previous) continue;
+        auto it = cache.find({summary_mode_name(mode), graphs[channels[c].first].ch});
+        fresh[c] = it != cache.end() && it->second == hashes[c];
+        n_fresh += fresh[c] ? 1 : 0;
+    }
+
+    // 3. チャンネルごとのジョブを並列に処理する (共有カウンターから次のチャンネルを取る)
+    int n_threads = std::max(1, std::min<int>(opt.n_threads, static_cast<int>(channels.size())));
+    if (n_threads > 1) {
+        ROOT::EnableThreadSafety();
+        std::string minimizer = ROOT::Math::MinimizerOptions::DefaultMinimizerType();
+        if (minimizer == "Minuit" || minimizer == "TMinuit") {
+            ROOT::Math::MinimizerOptions::SetDefaultMinimizer("Minuit2");
+            std::cout << "Info: " << n_threads << " スレッドでフィットするため、最小化を " << minimizer
+                      << " から Minuit2 に切り替えます" << std::endl;
+        }
+    }
+
+    // PDF (全 ch・全グラフを1ファイルに。描画は別スレッド)。全チャンネルが前回と同じで PDF があれば書かない
+    std::unique_ptr<PlotBookWriter> pdf;
+    int pdf_book = -1;
+    if (opt.save_pdf && (n_fresh < channels.size() || !std::filesystem::exists(pdf_path))) {
+        pdf.reset(new PlotBookWriter());
+        pdf_book = pdf->AddBook(pdf_path, static_cast<int>(graphs.size()));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<SummaryFit> fits(graphs.size());
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t c = next++; c < channels.size(); c = next++) {
+            for (size_t i = channels[c].first; i < channels[c].second; ++i) {
+                const SummaryGraph& g = graphs[i];
+                if (fresh[c]) {
+                    auto it = previous.find({g.ch, g.type});
+                    if (it != previous.end()) fits[i] = it->second;
+                    summary_ranges(g, mode, fits[i]);
+                } else {
+                    fit_summary_graph(g, mode, fits[i]);
+                    if (mode == SummaryMode::Results) write_summary_graph_csv(dir, g);
+                }
+                summary_curve(fits[i]);
+                if (pdf) pdf->Submit(pdf_book, static_cast<int>(i), summary_page(&g, &fits[i], mode), TString::Format("ch%02d %s", g.ch, g.type.c_str()).Data());
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < n_threads; ++t) threads.emplace_back(worker);
+    worker();
+    for (auto& t : threads) t.join();
+    double fit_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (pdf) pdf->Finish();
+
+    // 4. 結果とキャッシュ (このモードの行は今回のチャンネルで置き換える)
+    if (!write_summary_results(results_path, mode, graphs, fits)) std::cerr << "警告: " << results_path << " を書けません" << std::endl;
+    SummaryCache new_cache;
+    for (auto const& [key, hash] : cache) {
+        if (key.first != summary_mode_name(mode)) new_cache[key] = hash;
+    }
+    for (size_t c = 0; c < channels.size(); ++c) new_cache[{summary_mode_name(mode), graphs[channels[c].first].ch}] = hashes[c];
+    if (!write_summary_cache(cache_path, new_cache)) std::cerr << "警告: キャッシュ " << cache_path << " を書けません" << std::endl;
+
+    std::cout << "Summary fits: " << graphs.size() << " graphs in " << channels.size() << " channels (fit "
+              << channels.size() - n_fresh << " ch, 前回の結果 " << n_fresh << " ch) on " << n_threads << " threads, "
+              << fit_ms << " ms" << std::endl;
+    std::cout << "Processing completed." << std::endl;
+    if (!rows_csv_path.empty()) std::cout << " - CSV Data  : " << rows_csv_path << std::endl;
+    std::cout << " - Results   : " << results_path << std::endl;
+    if (pdf) std::cout << " - PDF       : " << pdf_path << std::endl;
+    else if (opt.save_pdf) std::cout << " - PDF       : " << pdf_path << " (変更なし)" << std::endl;
+    return 0;
+}
+
+#endif // SUMMARY_BUILDER_H
@@ -0,0 +1,488 @@
+/*
+ * id: unbinned_time_fit.h
+ * Place: /home/daiki/keio/hkelec/reconst/macros/cpp/
+ * Last Edit: 2026-10-18 Gemini
+ *
+ * 概要: processed_hits の (電荷, 時間) の組から、電荷依存の EMG 時間モデルを unbinned 最尤法でフィットする (unbinned_tw_fit から使う)。
+ * 従来の流れ (ファイルごとに time_diff をヒストグラムにして EMG フィット (meanfinder) → ピーク位置 vs 平均電荷をフィット (plot_summary))
+ * の代わりに、スキャンの全ファイルのヒットを1回のフィットに使う。電荷はファイルの平均ではなくヒットごとの値を使う。
+ * 1. 読み込み: <run>_eventhist.root の processed_hits (無ければ processed_events) から ch, hgain, lgain, time_diff を読み、
+ *    ペデスタルを引いて pC にする (readData.cc と同じ: hgain が飽和 (>= 4000) なら lgain)。ファイルごとに並列に読む。
+ * 2. モデル (x = q / UTW_QREF):
+ *      t ~ EMG(μ(q), σ(q), λ)、μ(q) = a0 x^{-1/2} + a1 + a2 x + a3 x^2、σ(q)^2 = s0^2 / x + s1^2 (TTS/√Npe と回路のジッター)
+ *    時間窓 [t_lo, t_hi] で規格化し、一様なバックグラウンド (割合 f_bkg) を足す。
+ *    出力の c0..c3 は plot_summary / TW_PARAMS と同じ q [pC] での係数に直す。
+ * 3. 尤度: ヒットをチャンクに分け、スレッドプール (ChunkedSum) の各スレッドがチャンクごとの -ln L の部分和を計算し、
+ *    チャンク順に足す (足す順番が決まっているので、結果はスレッド数によらない)。最小化は Minuit2 (Migrad + Hesse)。
+ * コンパイル不要 (ヘッダーファイル)
+ */
+#ifndef UNBINNED_TIME_FIT_H
+#define UNBINNED_TIME_FIT_H
+
+#include <Math/Factory.h>
+#include <Math/Functor.h>
+#include <Math/Minimizer.h>
+#include <TFile.h>
+#include <TLeaf.h>
+#include <TTree.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// EMG の ln erfc と mode (macro/fit_results)
+#include "emg_math.h"
+
+const double UTW_QREF = 100.0;             // 電荷の基準 [pC] (フィットのパラメータの大きさを揃える)
+const double UTW_K_HGAIN = 0.073;          // pC/ADC (readData.cc, meanfinder と同じ)
+const double UTW_K_LGAIN = 0.599;
+const double UTW_SATURATION = 4000.0;      // hgain がこれ以上なら lgain を使う
+const int UTW_NPAR = 8;
+
+// パラメータの並び
+enum UtwParam { kA0, kA1, kA2, kA3, kS0, kS1, kLambda, kFBkg };
+const char* const UTW_PAR_NAMES[UTW_NPAR] = {"a0", "a1", "a2", "a3", "s0", "s1", "lambda", "f_bkg"};
+
+// =========================================================
+// 読み込み
+// =========================================================
+
+struct UtwPedestal {
+    double hgain = 0, lgain = 0;
+};
+
+// hkelec_pedestal_hithist_means.txt (ch,type,mean,err) を読む (無ければ空)
+inline std::map<int, UtwPedestal> load_utw_pedestals(const std::string& path) {
+    std::map<int, UtwPedestal> peds;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        for (char& c : line) if (c == ',') c = ' ';
+        std::istringstream ss(line);
+        int ch;
+        std::string type;
+        double mean, err;
+        if (!(ss >> ch >> type >> mean >> err)) continue;
+        if (type == "hgain") peds[ch].hgain = mean;
+        else if (type == "lgain") peds[ch].lgain = mean;
+    }
+    return peds;
+}
+
+// 1つのチャンネルのヒット (電荷 [pC], 時間 [ns])。file_begin[f] はファイル f の最初のヒットの番号
+struct UtwHits {
+    std::vector<float> q, t;
+    std::vector<size_t> file_begin;
+    size_t FileEnd(size_t f) const { return f + 1 < file_begin.size() ? file_begin[f + 1] : q.size(); }
+};
+
+/**
+ * @brief 1つの eventhist の processed_hits (無ければ processed_events) から ch 0-3 の (電荷, 時間) を読む
+ * q_min [pC] 以下のヒットは捨てる。列の型 (--precision compact など) によらず TLeaf::GetValue で読む。
+ */
+inline bool load_utw_file(const std::string& path, const std::map<int, UtwPedestal>& peds, double q_min, UtwHits hits[4]) {
+    std::unique_ptr<TFile> f(TFile::Open(path.c_str(), "READ"));
+    if (!f || f->IsZombie()) {
+        std::cerr << "警告: " << path << " を開けません" << std::endl;
+        return false;
+    }
+    bool event_layout = false;
+    TTree* tree = dynamic_cast<TTree*>(f->Get("processed_hits"));
+    if (!tree) {
+        tree = dynamic_cast<TTree*>(f->Get("processed_events"));
+        event_layout = (tree != nullptr);
+    }
+    if (!tree) {
+        std::cerr << "警告: " << path << " に processed_hits / processed_events がありません" << std::endl;
+        return false;
+    }
+    tree->SetBranchStatus("*", false);
+    for (const char* name : {"ch", "hgain", "lgain", "time_diff"}) tree->SetBranchStatus(name, true);
+    if (event_layout) tree->SetBranchStatus("nhits", true);
+    TLeaf* l_ch = tree->GetLeaf("ch");
+    TLeaf* l_hgain = tree->GetLeaf("hgain");
+    TLeaf* l_lgain = tree->GetLeaf("lgain");
+    TLeaf* l_time = tree->GetLeaf("time_diff");
+    TLeaf* l_nhits = event_layout ? tree->GetLeaf("nhits") : nullptr;
+    if (!l_ch || !l_hgain || !l_lgain || !l_time || (event_layout && !l_nhits)) {
+        std::cerr << "警告: " << path << " に ch, hgain, lgain, time_diff の列がありません" << std::endl;
+        return false;
+    }
+
+    UtwPedestal ped[4];
+    for (int ch = 0; ch < 4; ++ch) {
+        auto it = peds.find(ch);
+        if (it != peds.end()) ped[ch] = it->second;
+    }
+    Long64_t n_entries = tree->GetEntries();
+    for (Long64_t e = 0; e < n_entries; ++e) {
+        tree->GetEntry(e);
+        int n = event_layout ? static_cast<int>(l_nhits->GetValue()) : 1;
+        for (int i = 0; i < n; ++i) {
+            int ch = static_cast<int>(l_ch->GetValue(i));
+            if (ch < 0 || ch >= 4) continue;
+            double hgain = l_hgain->GetValue(i);
+            double q = (hgain >= UTW_SATURATION) ? (l_lgain->GetValue(i) - ped[ch].lgain) * UTW_K_LGAIN
+                                                 : (hgain - ped[ch].hgain) * UTW_K_HGAIN;
+            if (!(q > q_min)) continue;
+            hits[ch].q.push_back(static_cast<float>(q));
+            hits[ch].t.push_back(static_cast<float>(l_time->GetValue(i)));
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 複数の eventhist をファイルごとに並列に読み、ファイル順に1つの配列にまとめる (結果はスレッド数によらない)
+ */
+inline void load_utw_scan(const std::vector<std::string>& files, const std::map<int, UtwPedestal>& peds, double q_min,
+                          int n_threads, UtwHits hits[4]) {
+    std::vector<std::vector<UtwHits>> per_file(files.size(), std::vector<UtwHits>(4));
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t f = next++; f < files.size(); f = next++) load_utw_file(files[f], peds, q_min, per_file[f].data());
+    };
+    n_threads = std::max(1, std::min<int>(n_threads, static_cast<int>(files.size())));
+    std::vector<std::thread> threads;
+    for (int t = 1; t < n_threads; ++t) threads.emplace_back(worker);
+    worker();
+    for (auto& t : threads) t.join();
+
+    for (int ch = 0; ch < 4; ++ch) {
+        size_t total = 0;
+        for (const auto& pf : per_file) total += pf[ch].q.size();
+        hits[ch] = UtwHits();
+        hits[ch].q.reserve(total);
+        hits[ch].t.reserve(total);
+        for (auto& pf : per_file) {
+            hits[ch].file_begin.push_back(hits[ch].q.size());
+            hits[ch].q.insert(hits[ch].q.end(), pf[ch].q.begin(), pf[ch].q.end());
+            hits[ch].t.insert(hits[ch].t.end(), pf[ch].t.begin(), pf[ch].t.end());
+            std::vector<float>().swap(pf[ch].q);   // 読み終わったファイルの分はすぐ解放する
+            std::vector<float>().swap(pf[ch].t);
+        }
+    }
+}
+
+// =========================================================
+// モデル
+// =========================================================
+
+/**
+ * @brief 電荷依存の EMG 時間モデル (パラメータは UtwParam の順)
+ */
+struct UtwModel {
+    double p[UTW_NPAR] = {0, 0, 0, 0, 1, 1, 1, 0};
+    double t_lo = -1e9, t_hi = 1e9;   // 時間窓 (規格化とバックグラウンドの範囲)
+
+    double Mu(double q) const {
+        double x = q / UTW_QREF;
+        return p[kA0] / std::sqrt(x) + p[kA1] + p[kA2] * x + p[kA3] * x * x;
+    }
+    double Sigma(double q) const {
+        double x = q / UTW_QREF;
+        return std::sqrt(p[kS0] * p[kS0] / x + p[kS1] * p[kS1]);
+    }
+    // EMG の ln f(t) と、時間窓での規格化 N = F(t_hi) - F(t_lo)
+    // ln f = ln(λ/2) + k²/2 - k v + ln erfc((k - v)/√2)  (v = (t - μ)/σ, k = λσ。f は t [ns] での密度)
+    // F(t) = Φ(v) - f(t)/λ
+    static double LogEmg(double v, double k, double log_half_lambda) {
+        return log_half_lambda + 0.5 * k * k - k * v + emg_log_erfc((k - v) / std::sqrt(2.0));
+    }
+    static double EmgCdf(double v, double k) {
+        return 0.5 * std::erfc(-v / std::sqrt(2.0)) - std::exp(0.5 * k * k - k * v + emg_log_erfc((k - v) / std::sqrt(2.0)) - std::log(2.0));
+    }
+    // ヒット1つの確率密度 (時間窓で規格化した EMG と一様なバックグラウンドの和)
+    double Pdf(double q, double t) const {
+        double mu = Mu(q), sigma = Sigma(q), lambda = p[kLambda];
+        double k = lambda * sigma;
+        double norm = EmgCdf((t_hi - mu) / sigma, k) - EmgCdf((t_lo - mu) / sigma, k);
+        double emg = std::exp(LogEmg((t - mu) / sigma, k, std::log(0.5 * lambda)));
+        return (1 - p[kFBkg]) * emg / std::max(norm, 1e-300) + p[kFBkg] / (t_hi - t_lo);
+    }
+    // 電荷 q での EMG の mode (時間窓・バックグラウンドは無視)
+    double Mode(double q) const {
+        EmgShape s = emg_shape(Mu(q), Sigma(q), p[kLambda]);
+        return s.ok ? s.mode : Mu(q);
+    }
+    // q [pC] での係数 (plot_summary / TW_PARAMS と同じ形 c0 q^{-1/2} + c1 + c2 q + c3 q^2) への換算係数
+    static double CoefScale(int i) {
+        static const double s[4] = {std::sqrt(UTW_QREF), 1.0, 1.0 / UTW_QREF, 1.0 / (UTW_QREF * UTW_QREF)};
+        return s[i];
+    }
+};
+
+// =========================================================
+// チャンクに分けた並列の和
+// =========================================================
+
+/**
+ * @brief [0, n) をチャンクに分け、f(begin, end) (チャンクの部分和) をスレッドプールで並列に計算して足す
+ * スレッドは作った時に起こしておき、Sum のたびに作り直さない (Migrad は数百回呼ぶ)。呼び出したスレッドも計算に加わる。
+ * 部分和はチャンクごとの場所に置き、最後にチャンク順に足すので、結果はスレッド数によらない。
+ */
+class ChunkedSum {
+public:
+    using ChunkFn = std::function<double(size_t, size_t)>;
+
+    ChunkedSum(int n_threads, size_t chunk_size) : chunk_size_(std::max<size_t>(1, chunk_size)) {
+        for (int i = 1; i < n_threads; ++i) threads_.emplace_back([this] { Loop(); });
+    }
+    ~ChunkedSum() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        start_.notify_all();
+        for (auto& t : threads_) t.join();
+    }
+    ChunkedSum(const ChunkedSum&) = delete;
+    ChunkedSum& operator=(const ChunkedSum&) = delete;
+
+    int Threads() const { return static_cast<int>(threads_.size()) + 1; }
+    long Calls() const { return calls_; }
+
+    double Sum(size_t n, const ChunkFn& f) {
+        size_t n_chunks = (n + chunk_size_ - 1) / chunk_size_;
+        partial_.assign(n_chunks, 0.0);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            fn_ = &f;
+            n_ = n;
+            n_chunks_ = n_chunks;
+            next_ = 0;
+            running_ = static_cast<int>(threads_.size());
+            generation_++;
+        }
+        start_.notify_all();
+        RunChunks();
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            done_.wait(lock, [this] { return running_ == 0; });
+            fn_ = nullptr;
+        }
+        calls_++;
+        double sum = 0.0;
+        for (double v : partial_) sum += v;
+        return sum;
+    }
+
+private:
+    void RunChunks() {
+        for (size_t c = next_++; c < n_chunks_; c = next_++) {
+            size_t begin = c * chunk_size_;
+            partial_[c] = (*fn_)(begin, std::min(n_, begin + chunk_size_));
+        }
+    }
+    void Loop() {
+        long seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                start_.wait(lock, [&] { return stop_ || generation_ != seen; });
+                if (stop_) return;
+                seen = generation_;
+            }
+            RunChunks();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (--running_ == 0) done_.notify_one();
+            }
+        }
+    }
+
+    size_t chunk_size_;
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable start_, done_;
+    bool stop_ = false;
+    long generation_ = 0;
+    int running_ = 0;
+    const ChunkFn* fn_ = nullptr;
+    size_t n_ = 0, n_chunks_ = 0;
+    std::atomic<size_t> next_{0};
+    std::vector<double> partial_;
+    long calls_ = 0;
+};
+
+// =========================================================
+// フィット
+// =========================================================
+
+struct UtwFit {
+    int ch = -1;
+    std::string status = "no_data";   // ok / failed / no_data
+    size_t n_hits = 0;
+    UtwModel model;
+    double err[UTW_NPAR] = {0, 0, 0, 0, 0, 0, 0, 0};
+    double cov[UTW_NPAR][UTW_NPAR] = {};
+    double nll = 0, edm = 0;
+    int minuit_status = -1;
+    long n_calls = 0;
+    double q_min = 0, q_max = 0;      // データの電荷の範囲
+    double real_seconds = 0;
+    bool IsOk() const { return status == "ok"; }
+};
+
+// 中央値 (v は並べ替える)
+inline double utw_median(std::vector<double>& v) {
+    if (v.empty()) return 0.0;
+    size_t m = v.size() / 2;
+    std::nth_element(v.begin(), v.begin() + m, v.end());
+    return v[m];
+}
+
+/**
+ * @brief 初期値: 電荷の下位・上位 10% のヒットの時間の中央値から a0, a1 を、全体の中央値・MAD から σ と λ を決める
+ */
+inline UtwModel utw_seed(const UtwHits& h, double t_lo, double t_hi) {
+    UtwModel m;
+    m.t_lo = t_lo;
+    m.t_hi = t_hi;
+    size_t n = h.q.size();
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return h.q[a] < h.q[b]; });
+    size_t n10 = std::max<size_t>(1, n / 10);
+    std::vector<double> t_low, t_high, q_low, q_high, t_all(h.t.begin(), h.t.end());
+    for (size_t i = 0; i < n10; ++i) {
+        t_low.push_back(h.t[order[i]]);
+        q_low.push_back(h.q[order[i]]);
+        t_high.push_back(h.t[order[n - 1 - i]]);
+        q_high.push_back(h.q[order[n - 1 - i]]);
+    }
+    double xl = utw_median(q_low) / UTW_QREF, xh = utw_median(q_high) / UTW_QREF;
+    double tl = utw_median(t_low), th = utw_median(t_high);
+    double dx = 1 / std::sqrt(xl) - 1 / std::sqrt(xh);
+    m.p[kA0] = (dx > 1e-6) ? (tl - th) / dx : 0.0;
+    m.p[kA1] = th - m.p[kA0] / std::sqrt(xh);
+
+    double t_med = utw_median(t_all);
+    std::vector<double> dev(n);
+    double mean = 0;
+    for (size_t i = 0; i < n; ++i) {
+        dev[i] = std::fabs(h.t[i] - t_med);
+        mean += h.t[i];
+    }
+    mean /= std::max<size_t>(n, 1);
+    double width = std::max(1.4826 * utw_median(dev), 0.05);
+    m.p[kS0] = 0.5 * width;
+    m.p[kS1] = 0.5 * width;
+    m.p[kLambda] = 1.0 / std::max(mean - t_med, 0.3 * width);
+    m.p[kFBkg] = 0.01;
+    return m;
+}
+
+/**
+ * @brief 1チャンネルのヒットに UtwModel を unbinned 最尤法でフィットする
+ * t_lo < t_hi なら時間窓、そうでなければヒットの時間の最小・最大を窓にする (窓の外のヒットは使わない)。
+ * Migrad は a2, a3 を 0 に固定して1回、全パラメータで1回回し、最後に Hesse で誤差を求める。
+ */
+inline UtwFit fit_unbinned_time_model(int ch, const UtwHits& all, double t_lo, double t_hi, ChunkedSum& pool) {
+    UtwFit fit;
+    fit.ch = ch;
+    auto start = std::chrono::steady_clock::now();
+
+    // 時間窓の中のヒット
+    if (!(t_lo < t_hi) && !all.t.empty()) {
+        t_lo = *std::min_element(all.t.begin(), all.t.end()) - 1e-3;
+        t_hi = *std::max_element(all.t.begin(), all.t.end()) + 1e-3;
+    }
+    UtwHits h;
+    for (size_t i = 0; i < all.q.size(); ++i) {
+        if (all.t[i] < t_lo || all.t[i] > t_hi) continue;
+        h.q.push_back(all.q[i]);
+        h.t.push_back(all.t[i]);
+    }
+    fit.n_hits = h.q.size();
+    if (fit.n_hits < 100) return fit;
+    fit.q_min = *std::min_element(h.q.begin(), h.q.end());
+    fit.q_max = *std::max_element(h.q.begin(), h.q.end());
+
+    UtwModel seed = utw_seed(h, t_lo, t_hi);
+    const float* q = h.q.data();
+    const float* t = h.t.data();
+    const double width = t_hi - t_lo;
+
+    // -ln L (チャンクごとの部分和を並列に計算)
+    auto nll = [&](const double* par) {
+        const double a0 = par[kA0], a1 = par[kA1], a2 = par[kA2], a3 = par[kA3];
+        const double s0sq = par[kS0] * par[kS0], s1sq = par[kS1] * par[kS1];
+        const double lambda = par[kLambda], fb = par[kFBkg];
+        const double log_half_lambda = std::log(0.5 * lambda);
+        const double bkg = fb / width;
+        ChunkedSum::ChunkFn chunk = [&](size_t begin, size_t end) {
+            double sum = 0.0;
+            for (size_t i = begin; i < end; ++i) {
+                double x = q[i] / UTW_QREF;
+                double rx = 1 / std::sqrt(x);
+                double mu = a0 * rx + a1 + a2 * x + a3 * x * x;
+                double sigma = std::sqrt(s0sq * rx * rx + s1sq);
+                double k = lambda * sigma;
+                double norm = UtwModel::EmgCdf((t_hi - mu) / sigma, k) - UtwModel::EmgCdf((t_lo - mu) / sigma, k);
+                double emg = std::exp(UtwModel::LogEmg((t[i] - mu) / sigma, k, log_half_lambda));
+                double p = (1 - fb) * emg / std::max(norm, 1e-300) + bkg;
+                sum -= std::log(p > 1e-300 ? p : 1e-300);
+            }
+            return sum;
+        };
+        return pool.Sum(h.q.size(), chunk);
+    };
+
+    std::unique_ptr<ROOT::Math::Minimizer> min(ROOT::Math::Factory::CreateMinimizer("Minuit2", "Migrad"));
+    if (!min) {
+        std::cerr << "エラー: Minuit2 を作れません" << std::endl;
+        fit.status = "failed";
+        return fit;
+    }
+    ROOT::Math::Functor fcn(nll, UTW_NPAR);
+    min->SetFunction(fcn);
+    min->SetErrorDef(0.5);        // -ln L
+    min->SetStrategy(1);
+    min->SetPrintLevel(0);
+    min->SetMaxFunctionCalls(20000);
+    const double step[UTW_NPAR] = {0.1, 0.1, 0.01, 0.001, 0.05, 0.05, 0.05, 0.005};
+    for (int i = 0; i < UTW_NPAR; ++i) {
+        if (i == kLambda) min->SetLimitedVariable(i, UTW_PAR_NAMES[i], seed.p[i], step[i], 0.001, 100.0);
+        else if (i == kFBkg) min->SetLimitedVariable(i, UTW_PAR_NAMES[i], seed.p[i], step[i], 0.0, 0.9);
+        else min->SetVariable(i, UTW_PAR_NAMES[i], seed.p[i], step[i]);
+    }
+    min->FixVariable(kA2);
+    min->FixVariable(kA3);
+    min->Minimize();
+    min->ReleaseVariable(kA2);
+    min->ReleaseVariable(kA3);
+    bool ok = min->Minimize();
+    min->Hesse();
+
+    fit.model = seed;
+    for (int i = 0; i < UTW_NPAR; ++i) {
+        fit.model.p[i] = min->X()[i];
+        fit.err[i] = min->Errors()[i];
+        for (int j = 0; j < UTW_NPAR; ++j) fit.cov[i][j] = min->CovMatrix(i, j);
+    }
+    fit.model.p[kS0] = std::fabs(fit.model.p[kS0]);
+    fit.model.p[kS1] = std::fabs(fit.model.p[kS1]);
+    fit.nll = min->MinValue();
+    fit.edm = min->Edm();
+    fit.minuit_status = min->Status();
+    fit.n_calls = min->NCalls();
+    fit.status = ok ? "ok" : "failed";
+    fit.real_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return fit;
+}
+
+#endif // UNBINNED_TIME_FIT_H
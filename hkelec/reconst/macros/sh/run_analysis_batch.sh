@@ -8,6 +8,7 @@
 #   1. fit_pedestal (ペデスタル解析)
 #   2. meanfinder (イベント電荷・時間解析)
 #   3. plot_summary (集計・グラフ作成・フィッティング)
+#   4. unbinned_tw_fit (--unbinned 指定時: processed_hits からの unbinned TimeWalk フィットと 3 との比較)
 #
 
 # --- 設定: 実行ファイルの場所 ---
@@ -18,6 +19,7 @@ CPP_DIR="${BASE_DIR}/../cpp"
 EXE_PEDESTAL="${CPP_DIR}/fit_pedestal"
 EXE_MEANFINDER="${CPP_DIR}/meanfinder"
 EXE_PLOT="${CPP_DIR}/plot_summary"
+EXE_UNBINNED="${CPP_DIR}/unbinned_tw_fit"
 
 # --- ヘルプ表示 ---
 usage() {
@@ -40,6 +42,7 @@ usage() {
   --fit-time   : meanfinderで時間のみ計算
   --fit-all    : 両方計算 (デフォルト)
   --no-pdf     : PDFを出力しない
+  --unbinned   : plot_summary の後に unbinned_tw_fit を実行 (ヒストグラムを経ない TimeWalk フィット)
 
 [入出力ファイルの仕様]
   -----------------------------------------------------------------------------
@@ -53,7 +56,8 @@ usage() {
   以下のC++プログラムが ${CPP_DIR} に存在し、実行可能である必要があります。
   - fit_pedestal  : ペデスタル解析 (ペデスタル平均・誤差算出)
   - meanfinder    : イベント解析 (電荷計算、時間EMGフィット)
-  - plot_summary  : 集計・プロット (グラフ作成、7次関数フィット、CSV出力)
+  - plot_summary  : 集計・プロット (グラフ作成、フィット、CSV出力。チャンネルごとに並列)
+  - unbinned_tw_fit : (--unbinned) processed_hits の (電荷, 時間) から EMG 時間モデルを unbinned 最尤フィット
 ===============================================================================
 EOF
 }
@@ -68,6 +72,7 @@ fi
 DIRS=()
 FIT_OPTION="--fit-all"
 PDF_OPTION=""
+RUN_UNBINNED=0
 
 while (( "$#" )); do
     case "$1" in
@@ -83,6 +88,10 @@ while (( "$#" )); do
             PDF_OPTION="$1"
             shift
             ;;
+        --unbinned)
+            RUN_UNBINNED=1
+            shift
+            ;;
         -*)
             echo "エラー: 不明なオプション $1"
             usage
@@ -153,6 +162,16 @@ for DIR in "${DIRS[@]}"; do
     echo "[Step 3] Creating Summary Plots..."
     "$EXE_PLOT" "$DIR" "$PDF_OPTION"
 
+    # 4. Unbinned TimeWalk Fit (比較に plot_summary の summary_all_data.csv を使う)
+    if [ "$RUN_UNBINNED" -eq 1 ]; then
+        if [ -x "$EXE_UNBINNED" ]; then
+            echo "[Step 4] Running Unbinned TimeWalk Fit..."
+            "$EXE_UNBINNED" "$DIR" $PDF_OPTION
+        else
+            echo "[Step 4] Skip: 実行ファイルが見つかりません ($EXE_UNBINNED)"
+        fi
+    fi
+
     echo "Done: $DIR"
     echo ""
 done
@@ -0,0 +1,198 @@
+/*
+ * id: bench_reconstructor.cc
+ * Place: /home/daiki/keio/hkelec/reconst/reco/
+ * Author: Gemini (Modified based on user request)
+ * Last Edit: 2026-10-18
+ *
+ * 概要:
+ * 並列再構成 (ParallelReconstructor) のスケーリングベンチマーク
+ * fittinginput.hh のモデル (FuncF 電荷 + TimeWalk + 電荷依存の時間分解能) から
+ * トイMCイベントを生成し、1..N スレッドでフィットした時間を比較します。
+ * 光源位置をランダムに振るのでイベントごとのフィット時間はばらつき、
+ * 固定範囲分割 (static) とワークスティーリング (steal) の差が見えます。
+ * 全スレッド数で結果が 1 スレッドと一致することも確認します。
+ *
+ * 使い方:
+ * $ make bench
+ * $ ./bench_reconstructor -n 4000 -j 16
+ */
+
+#include "parallelReco.hh"
+#include "chargeTable.hh"
+#include "timeCalib.hh"
+#include <TROOT.h>
+#include <TRandom3.h>
+#include <TStopwatch.h>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <unistd.h>
+
+void PrintUsage(const char* progName) {
+    std::cout << "======================================================================" << std::endl;
+    std::cout << "  並列再構成スケーリングベンチマーク (bench_reconstructor)" << std::endl;
+    std::cout << "======================================================================" << std::endl;
+    std::cout << "\n[概要]" << std::endl;
+    std::cout << "  トイMCイベントを生成し、スレッド数 1, 2, 4, ..., N で再構成して" << std::endl;
+    std::cout << "  実時間・スループット・速度向上率を表示します。" << std::endl;
+    std::cout << "  各スレッド数で 固定範囲分割(static) と ワークスティーリング(steal) を比較し、" << std::endl;
+    std::cout << "  結果が 1 スレッドの場合と完全に一致するかも確認します。" << std::endl;
+
+    std::cout << "\n[使い方]" << std::endl;
+    std::cout << "  " << progName << " [オプション]" << std::endl;
+
+    std::cout << "\n[オプション]" << std::endl;
+    std::cout << "  -n <N>     : トイMCイベント数 (デフォルト: 2000)" << std::endl;
+    std::cout << "  -j <N>     : 最大スレッド数 (デフォルト: 全コア)" << std::endl;
+    std::cout << "  -c <N>     : チャンクあたりのイベント数 (デフォルト: 8)" << std::endl;
+    std::cout << "  -s <seed>  : 乱数シード (デフォルト: 12345)" << std::endl;
+    std::cout << "======================================================================" << std::endl;
+}
+
+/**
+ * @brief トイMCイベントを生成する
+ * 光源 x,y ∈ [-150,150], z ∈ [90,290] cm、光量 A ∈ [0.3,3]、t0 = 0。
+ * 電荷はモデル期待値に 5% + sqrt(mu) のガウス揺らぎ、時間は分解能 sigma_t のガウス揺らぎ。
+ */
+std::vector<std::vector<PMTData>> GenerateToyEvents(int nEvents, unsigned int seed) {
+    TRandom3 rnd(seed);
+    const TimeCalibration& calib = GetTimeCalibration();
+    double pmt_cz = PMT_SURFACE_Z - PMT_RADIUS_F;
+    std::vector<std::vector<PMTData>> events;
+    events.reserve(nEvents);
+
+    for (int ev = 0; ev < nEvents; ++ev) {
+        double sx = rnd.Uniform(-150, 150);
+        double sy = rnd.Uniform(-150, 150);
+        double sz = rnd.Uniform(90, 290);
+        double A = rnd.Uniform(0.3, 3.0);
+
+        std::vector<PMTData> hits;
+        for (int ch = 0; ch < 4; ++ch) {
+            double vx = PMT_XY_POS[ch][0] - sx;
+            double vy = PMT_XY_POS[ch][1] - sy;
+            double vz = pmt_cz - sz;
+            double r2 = vx * vx + vy * vy + vz * vz;
+            double r = std::sqrt(r2);
+            double cos_alpha = (vx * PMT_DIR[0] + vy * PMT_DIR[1] + vz * PMT_DIR[2]) / r;
+            double mu = A * AnalyticChargeResponse(ChargeModelType::FuncF, ch, r, r2, cos_alpha);
+
+            PMTData hit;
+            hit.eventID = ev;
+            hit.ch = ch;
+            hit.charge = std::max(mu + rnd.Gaus(0, 0.05 * mu + std::sqrt(std::max(mu, 0.0))), 0.1);
+            double sigma_t = std::max(calib.SigmaT(ch, hit.charge), 0.1);
+            hit.time = (r - PMT_RADIUS_F) / C_LIGHT + calib.TimeWalk(ch, hit.charge)
+                     + calib.tCorr[ch] + rnd.Gaus(0, sigma_t);
+            hit.x = PMT_POSITIONS[ch][0];
+            hit.y = PMT_POSITIONS[ch][1];
+            hit.z = PMT_POSITIONS[ch][2];
+            hit.dir_x = PMT_DIR[0];
+            hit.dir_y = PMT_DIR[1];
+            hit.dir_z = PMT_DIR[2];
+            hit.isHit = true;
+            hits.push_back(hit);
+        }
+        events.push_back(hits);
+    }
+    return events;
+}
+
+int main(int argc, char** argv) {
+    int nEvents = 2000;
+    int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    int chunkSize = 8;
+    unsigned int seed = 12345;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:j:c:s:h")) != -1) {
+        switch (opt) {
+            case 'n': nEvents = std::stoi(optarg); break;
+            case 'j': maxThreads = std::max(1, std::stoi(optarg)); break;
+            case 'c': chunkSize = std::max(1, std::stoi(optarg)); break;
+            case 's': seed = std::stoul(optarg); break;
+            case 'h':
+                PrintUsage(argv[0]);
+                return 0;
+            default:
+                PrintUsage(argv[0]);
+                return 1;
+        }
+    }
+
+    ROOT::EnableThreadSafety();
+
+    std::cout << "トイMCイベントを生成中: " << nEvents << " events (seed=" << seed << ")" << std::endl;
+    auto events = GenerateToyEvents(nEvents, seed);
+
+    // 設定はデフォルト (gaus電荷, func_f, gaus時間, migrad誤差)
+    FitConfig config;
+
+    std::vector<int> threadCounts;
+    for (int n = 1; n < maxThreads; n *= 2) threadCounts.push_back(n);
+    threadCounts.push_back(maxThreads);
+
+    std::vector<FitResult> reference;
+    std::vector<char> referenceConv;
+    double referenceTime = 0.0;
+
+    std::cout << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(10) << "mode" << std::setw(12) << "time[s]"
+              << std::setw(12) << "events/s" << std::setw(10) << "speedup" << std::setw(8) << "eff"
+              << std::setw(9) << "steals" << std::setw(12) << "imbalance" << std::setw(10) << "identical" << std::endl;
+
+    for (int nThreads : threadCounts) {
+        for (int steal = 0; steal <= 1; ++steal) {
+            if (nThreads == 1 && steal == 0) continue; // 1スレッドでは同じ
+
+            ParallelReconstructor reco(config, nThreads, nullptr, "", chunkSize);
+            std::vector<FitResult> results;
+            std::vector<char> converged;
+
+            TStopwatch sw;
+            sw.Start();
+            reco.FitBlock(events, events.size(), results, converged, steal == 1);
+            sw.Stop();
+            double t = sw.RealTime();
+
+            // ワーカーごとの CPU 時間の最大/平均 (1 に近いほど均等)
+            double maxCpu = 0.0, sumCpu = 0.0;
+            for (const auto& ws : reco.GetWorkerStats()) {
+                maxCpu = std::max(maxCpu, ws.cpuMs);
+                sumCpu += ws.cpuMs;
+            }
+            double imbalance = (sumCpu > 0) ? maxCpu / (sumCpu / reco.GetNThreads()) : 1.0;
+
+            bool identical = true;
+            if (nThreads == 1) {
+                reference = results;
+                referenceConv = converged;
+                referenceTime = t;
+            } else {
+                for (size_t i = 0; i < events.size() && identical; ++i) {
+                    identical = (converged[i] == referenceConv[i] && results[i].x == reference[i].x &&
+                                 results[i].y == reference[i].y && results[i].z == reference[i].z &&
+                                 results[i].t == reference[i].t && results[i].chi2 == reference[i].chi2);
+                }
+            }
+
+            double speedup = (t > 0) ? referenceTime / t : 0.0;
+            std::cout << std::setw(8) << nThreads << std::setw(10) << (steal ? "steal" : "static")
+                      << std::setw(12) << std::fixed << std::setprecision(3) << t
+                      << std::setw(12) << std::setprecision(1) << nEvents / std::max(t, 1e-9)
+                      << std::setw(10) << std::setprecision(2) << speedup
+                      << std::setw(8) << speedup / nThreads
+                      << std::setw(9) << reco.GetNSteals()
+                      << std::setw(12) << imbalance
+                      << std::setw(10) << (identical ? "yes" : "NO") << std::endl;
+        }
+    }
+
+    long nConv = std::count(referenceConv.begin(), referenceConv.end(), 1);
+    std::cout << "\n収束イベント: " << nConv << " / " << nEvents << std::endl;
+    return 0;
+}
@@ -0,0 +1,244 @@
+/*
+ * id: chargeTable.cc
+ * Place: /home/daiki/keio/hkelec/reconst/reco/
+ * Author: Gemini (Modified based on user request)
+ * Last Edit: 2026-10-18
+ *
+ * 概要:
+ * 電荷応答参照テーブル (ChargeTable) の実装
+ * 解析モデルからの生成、較正データセットからの生成、ファイル入出力を行います。
+ * 補間 (Eval) はフィット中に呼ばれるためヘッダー側にインラインで置いています。
+ */
+
+#include "chargeTable.hh"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+
+// =========================================================
+// 解析モデル
+// =========================================================
+double AnalyticPmtRadius(ChargeModelType model) {
+    return (model == ChargeModelType::FuncG) ? PMT_RADIUS_G : PMT_RADIUS_F;
+}
+
+double AnalyticChargeResponse(ChargeModelType model, int ch,
+                              double dist_center, double dist_center2, double cos_alpha) {
+    // 角度依存項 epsilon (8項多項式)
+    const double* c_ang = (model == ChargeModelType::FuncG) ? CHARGE_ANGULAR_PARAMS_FUNC_G[ch]
+                                                            : CHARGE_ANGULAR_PARAMS_FUNC_F[ch];
+    double epsilon = c_ang[0] + cos_alpha * (c_ang[1] + cos_alpha * (c_ang[2] + cos_alpha * (c_ang[3] +
+                     cos_alpha * (c_ang[4] + cos_alpha * (c_ang[5] + cos_alpha * (c_ang[6] + cos_alpha * c_ang[7]))))));
+    if (epsilon < 0) epsilon = 0.0;
+
+    double f_r = 0.0;
+    if (model == ChargeModelType::FuncG) {
+        // [FuncG] f(r) = c0 / r^2
+        double c0 = CHARGE_RADIAL_PARAMS_FUNC_G[ch];
+        if (dist_center2 < 1.0) dist_center2 = 1.0; // ゼロ除算防止
+        f_r = c0 / dist_center2;
+    } else {
+        // [FuncF] f(r) = c0 * (1 - sqrt(1 - (r_pmt/r)^2))
+        double c0 = CHARGE_RADIAL_PARAMS_FUNC_F[ch];
+        double r_pmt = PMT_RADIUS_F;
+        if (dist_center > r_pmt + 0.001) {
+            double ratio = r_pmt / dist_center;
+            f_r = c0 * (1.0 - std::sqrt(1.0 - ratio * ratio));
+        } else {
+            f_r = c0; // ルート内保護
+        }
+    }
+    return f_r * epsilon;
+}
+
+// CSV 1行を分割 (pandas は ',' を含む列名をダブルクォートで囲むため、それを考慮)
+static std::vector<std::string> SplitCsvLine(const std::string& line) {
+    std::vector<std::string> cols;
+    std::string cur;
+    bool quoted = false;
+    for (char ch : line) {
+        if (ch == '"') quoted = !quoted;
+        else if (ch == ',' && !quoted) { cols.push_back(cur); cur.clear(); }
+        else if (ch != '\r') cur += ch;
+    }
+    cols.push_back(cur);
+    return cols;
+}
+
+// =========================================================
+// ChargeTable
+// =========================================================
+ChargeTable::ChargeTable()
+    : fRPmt(0.0), fNR(0), fNCos(0), fRMin(0.0), fRMax(0.0), fCosMin(0.0), fCosMax(0.0),
+      fInvDR(0.0), fInvDCos(0.0) {}
+
+void ChargeTable::SetGrid(double rPmt, int nR, double rMin, double rMax,
+                          int nCos, double cosMin, double cosMax) {
+    fRPmt = rPmt;
+    fNR = std::max(nR, 2);
+    fNCos = std::max(nCos, 2);
+    fRMin = rMin;
+    fRMax = rMax;
+    fCosMin = cosMin;
+    fCosMax = cosMax;
+    fInvDR = (fNR - 1) / (fRMax - fRMin);
+    fInvDCos = (fNCos - 1) / (fCosMax - fCosMin);
+    fValues.assign(static_cast<size_t>(4) * fNR * fNCos, 0.0);
+}
+
+void ChargeTable::BuildFromAnalytic(ChargeModelType model, int nR, double rMin, double rMax, int nCos) {
+    SetGrid(AnalyticPmtRadius(model), nR, rMin, rMax, nCos, -1.0, 1.0);
+    for (int ch = 0; ch < 4; ++ch) {
+        for (int ir = 0; ir < fNR; ++ir) {
+            double r = R(ir);
+            for (int ic = 0; ic < fNCos; ++ic) {
+                At(ch, ir, ic) = AnalyticChargeResponse(model, ch, r, r * r, Cos(ic));
+            }
+        }
+    }
+}
+
+bool ChargeTable::BuildFromDataset(const std::string& csvFile, double rPmt,
+                                   int nR, double rMin, double rMax, int nCos,
+                                   double bwR, double bwCos) {
+    std::ifstream ifs(csvFile);
+    if (!ifs.is_open()) {
+        std::cerr << "エラー: データセットを開けません: " << csvFile << std::endl;
+        return false;
+    }
+
+    // ヘッダーから列番号を決定
+    std::string line;
+    if (!std::getline(ifs, line)) return false;
+    std::vector<std::string> header = SplitCsvLine(line);
+    auto column = [&](const std::string& name) {
+        auto it = std::find(header.begin(), header.end(), name);
+        return (it == header.end()) ? -1 : static_cast<int>(it - header.begin());
+    };
+    int iPmt = column("#PMT_num");
+    int iQ = column("Charge(pC)");
+    int iPow = column("light_power(def:(15dB, 5V)=1)");
+    int iX = column("x"), iY = column("y"), iZ = column("z");
+    if (iPmt < 0 || iQ < 0 || iPow < 0 || iX < 0 || iY < 0 || iZ < 0) {
+        std::cerr << "エラー: データセットに必要な列がありません: " << csvFile << std::endl;
+        return false;
+    }
+
+    // データ点 (r, cos, 応答) を CHごとに収集
+    // r, cos は fcn_wrapper と同じく PMT球中心 (Z = PMT_SURFACE_Z - rPmt) 基準で再計算する
+    struct Point { double r, c, y; };
+    std::vector<Point> points[4];
+    double pmt_cz = PMT_SURFACE_Z - rPmt;
+    while (std::getline(ifs, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::vector<std::string> cols = SplitCsvLine(line);
+        if (static_cast<int>(cols.size()) < static_cast<int>(header.size())) continue;
+        try {
+            int ch = std::stoi(cols[iPmt]) - 1; // PMT_num (1~4) -> ch (0~3)
+            double power = std::stod(cols[iPow]);
+            if (ch < 0 || ch >= 4 || power <= 0) continue;
+            double vx = PMT_XY_POS[ch][0] - std::stod(cols[iX]);
+            double vy = PMT_XY_POS[ch][1] - std::stod(cols[iY]);
+            double vz = pmt_cz - std::stod(cols[iZ]);
+            double r = std::sqrt(vx * vx + vy * vy + vz * vz);
+            if (r <= 0) continue;
+            double c = (vx * PMT_DIR[0] + vy * PMT_DIR[1] + vz * PMT_DIR[2]) / r;
+            points[ch].push_back({r, c, std::stod(cols[iQ]) / power});
+        } catch (const std::exception&) {
+            continue;
+        }
+    }
+
+    SetGrid(rPmt, nR, rMin, rMax, nCos, -1.0, 1.0);
+    bool ok = true;
+    for (int ch = 0; ch < 4; ++ch) {
+        const auto& pts = points[ch];
+        std::cout << "  CH" << ch << ": " << pts.size() << " データ点" << std::endl;
+        if (pts.empty()) { ok = false; continue; }
+
+        for (int ir = 0; ir < fNR; ++ir) {
+            for (int ic = 0; ic < fNCos; ++ic) {
+                double r = R(ir), c = Cos(ic);
+                double hr = bwR, hc = bwCos;
+                double sumW = 0.0, sumWY = 0.0;
+                // 近傍の重みが足りなければカーネル幅を倍々に広げる
+                for (int iter = 0; iter < 8; ++iter) {
+                    sumW = sumWY = 0.0;
+                    for (const auto& p : pts) {
+                        double dr = (p.r - r) / hr;
+                        double dc = (p.c - c) / hc;
+                        double w = std::exp(-0.5 * (dr * dr + dc * dc));
+                        sumW += w;
+                        sumWY += w * p.y;
+                    }
+                    if (sumW >= 0.5) break;
+                    hr *= 2.0;
+                    hc *= 2.0;
+                }
+                At(ch, ir, ic) = (sumW > 0) ? std::max(sumWY / sumW, 0.0) : 0.0;
+            }
+        }
+    }
+    return ok;
+}
+
+bool ChargeTable::Load(const std::string& filename) {
+    std::ifstream ifs(filename);
+    if (!ifs.is_open()) {
+        std::cerr << "エラー: 電荷テーブルを開けません: " << filename << std::endl;
+        return false;
+    }
+
+    // コメントを除いた数値を順に読む
+    std::vector<double> numbers;
+    std::string line;
+    while (std::getline(ifs, line)) {
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line = line.substr(0, hash);
+        std::stringstream ss(line);
+        double v;
+        while (ss >> v) numbers.push_back(v);
+    }
+    if (numbers.size() < 7) {
+        std::cerr << "エラー: 電荷テーブルのヘッダーが不正です: " << filename << std::endl;
+        return false;
+    }
+
+    int nR = static_cast<int>(numbers[1]);
+    int nCos = static_cast<int>(numbers[4]);
+    size_t expected = 7 + static_cast<size_t>(4) * nR * nCos;
+    if (nR < 2 || nCos < 2 || numbers.size() != expected) {
+        std::cerr << "エラー: 電荷テーブルの要素数が不正です (" << numbers.size()
+                  << " != " << expected << "): " << filename << std::endl;
+        return false;
+    }
+    SetGrid(numbers[0], nR, numbers[2], numbers[3], nCos, numbers[5], numbers[6]);
+    std::copy(numbers.begin() + 7, numbers.end(), fValues.begin());
+    return true;
+}
+
+bool ChargeTable::Save(const std::string& filename) const {
+    std::ofstream ofs(filename);
+    if (!ofs.is_open()) {
+        std::cerr << "エラー: 電荷テーブルを書き込めません: " << filename << std::endl;
+        return false;
+    }
+    ofs << "# charge response table (mu at A=1) for reconstructor -m table\n";
+    ofs << "# r_pmt n_r r_min r_max n_cos cos_min cos_max\n";
+    ofs << fRPmt << " " << fNR << " " << fRMin << " " << fRMax << " "
+        << fNCos << " " << fCosMin << " " << fCosMax << "\n";
+    ofs.precision(10);
+    for (int ch = 0; ch < 4; ++ch) {
+        ofs << "# CH" << ch << "\n";
+        for (int ir = 0; ir < fNR; ++ir) {
+            const double* row = &fValues[(static_cast<size_t>(ch) * fNR + ir) * fNCos];
+            for (int ic = 0; ic < fNCos; ++ic) {
+                ofs << (ic ? " " : "") << row[ic];
+            }
+            ofs << "\n";
+        }
+    }
+    return true;
+}
@@ -0,0 +1,130 @@
+/*
+ * id: chargeTable.hh
+ * Place: /home/daiki/keio/hkelec/reconst/reco/
+ * Author: Gemini (Modified based on user request)
+ * Last Edit: 2026-10-18
+ *
+ * 概要:
+ * 電荷応答モデルの参照テーブル (ChargeTable) の定義
+ * 各CHについて (PMT球中心からの距離 r, 入射角 cos(alpha)) の2次元格子上に
+ * 光量 A=1 のときの期待電荷 mu/A を事前計算しておき、フィット中は
+ * 双線形補間で引きます。補間値の r, cos(alpha) 微分も解析的に返します。
+ *
+ * テーブルの作り方:
+ * 1. 既存の解析モデル (FuncF / FuncG) を格子点で評価 (BuildFromAnalytic)
+ * 2. 較正データセット (create_dataset.py の出力CSV) からカーネル平均で作成 (BuildFromDataset)
+ * 3. 上記をファイルに保存したもの (make_charge_table の出力) を読み込み (Load)
+ *
+ * テーブルファイル形式 (テキスト、'#' 以降はコメント):
+ *   1行目 : r_pmt n_r r_min r_max n_cos cos_min cos_max
+ *   以降  : CH0 の r 格子ごとに n_cos 個の値を1行、続いて CH1, CH2, CH3
+ */
+
+#ifndef CHARGE_TABLE_HH
+#define CHARGE_TABLE_HH
+
+#include "fittinginput.hh"
+#include <string>
+#include <vector>
+
+/**
+ * @brief 解析モデル (FuncF / FuncG) による A=1 での期待電荷
+ *
+ * fcn_wrapper と同じ式・同じ保護処理 (epsilon<0 -> 0, r<r_pmt で f=c0, r^2<1 -> 1) を使います。
+ * @param dist_center PMT球中心からの距離 [cm]
+ * @param dist_center2 距離の2乗 (呼び出し側で計算済みのもの)
+ * @param cos_alpha CalculateCosAngle(PMT中心 - 光源, PMT向き) の値
+ */
+double AnalyticChargeResponse(ChargeModelType model, int ch,
+                              double dist_center, double dist_center2, double cos_alpha);
+
+/**
+ * @brief 解析モデルに対応するPMT半径 [cm] (PMT球中心 Z = PMT_SURFACE_Z - r_pmt)
+ */
+double AnalyticPmtRadius(ChargeModelType model);
+
+class ChargeTable {
+public:
+    ChargeTable();
+
+    /**
+     * @brief 解析モデルを格子点で評価してテーブルを作る
+     * @param model FuncF または FuncG (r_pmt もモデルに合わせます)
+     */
+    void BuildFromAnalytic(ChargeModelType model,
+                           int nR = 450, double rMin = 20.0, double rMax = 470.0,
+                           int nCos = 201);
+
+    /**
+     * @brief 較正データセットCSVからテーブルを作る
+     *
+     * 各行の (x,y,z) から r, cos(alpha) を fcn_wrapper と同じ幾何で再計算し、
+     * 応答 Charge / light_power を格子点ごとのガウスカーネル平均で埋めます。
+     * 近傍にデータが無い格子点はカーネル幅を倍々に広げて埋めます。
+     *
+     * @param csvFile create_dataset.py の出力CSV
+     * @param rPmt 距離・角度の基準とするPMT半径 [cm]
+     * @param bwR, bwCos カーネル幅 (距離 [cm], cos)
+     * @return 読み込めたデータ点が無いCHがあれば false
+     */
+    bool BuildFromDataset(const std::string& csvFile, double rPmt,
+                          int nR = 450, double rMin = 20.0, double rMax = 470.0,
+                          int nCos = 201, double bwR = 15.0, double bwCos = 0.1);
+
+    bool Load(const std::string& filename);
+    bool Save(const std::string& filename) const;
+
+    bool IsValid() const { return !fValues.empty(); }
+    double GetPmtRadius() const { return fRPmt; }
+
+    /**
+     * @brief A=1 での期待電荷を双線形補間で返す
+     *
+     * 格子範囲外は端の値でクランプします (その方向の微分は 0)。
+     * @param dmu_dr, dmu_dcos nullptr でなければ補間面の解析的な偏微分を格納
+     */
+    double Eval(int ch, double r, double cos_alpha,
+                double* dmu_dr = nullptr, double* dmu_dcos = nullptr) const {
+        double ur = (r - fRMin) * fInvDR;
+        double uc = (cos_alpha - fCosMin) * fInvDCos;
+        bool clampR = false, clampC = false;
+        if (ur < 0.0) { ur = 0.0; clampR = true; }
+        if (ur > fNR - 1) { ur = fNR - 1; clampR = true; }
+        if (uc < 0.0) { uc = 0.0; clampC = true; }
+        if (uc > fNCos - 1) { uc = fNCos - 1; clampC = true; }
+
+        int ir = static_cast<int>(ur);
+        int ic = static_cast<int>(uc);
+        if (ir > fNR - 2) ir = fNR - 2;
+        if (ic > fNCos - 2) ic = fNCos - 2;
+        double tr = ur - ir;
+        double tc = uc - ic;
+
+        const double* row0 = &fValues[(static_cast<size_t>(ch) * fNR + ir) * fNCos + ic];
+        const double* row1 = row0 + fNCos;
+        double f00 = row0[0], f01 = row0[1];
+        double f10 = row1[0], f11 = row1[1];
+
+        if (dmu_dr) {
+            *dmu_dr = clampR ? 0.0 : ((1.0 - tc) * (f10 - f00) + tc * (f11 - f01)) * fInvDR;
+        }
+        if (dmu_dcos) {
+            *dmu_dcos = clampC ? 0.0 : ((1.0 - tr) * (f01 - f00) + tr * (f11 - f10)) * fInvDCos;
+        }
+        return (1.0 - tr) * ((1.0 - tc) * f00 + tc * f01) + tr * ((1.0 - tc) * f10 + tc * f11);
+    }
+
+private:
+    double fRPmt;
+    int fNR, fNCos;
+    double fRMin, fRMax, fCosMin, fCosMax;
+    double fInvDR, fInvDCos;
+    std::vector<double> fValues; // [ch][ir][ic]
+
+    void SetGrid(double rPmt, int nR, double rMin, double rMax, int nCos, double cosMin, double cosMax);
+    double& At(int ch, int ir, int ic) { return fValues[(static_cast<size_t>(ch) * fNR + ir) * fNCos + ic]; }
+    double R(int ir) const { return fRMin + ir * (fRMax - fRMin) / (fNR - 1); }
+    double Cos(int ic) const { return fCosMin + ic * (fCosMax - fCosMin) / (fNCos - 1); }
+};
+
+#endif // CHARGE_TABLE_HH
@@ -0,0 +1,157 @@
+/*
+ * id: check_layouts.cc
+ * Place: /home/daiki/keio/hkelec/reconst/reco/
+ * Author: Gemini (Modified based on user request)
+ * Last Edit: 2026-10-18
+ *
+ * 概要:
+ * DataReader が processed_events (イベント単位) と processed_hits (ヒット単位) のどちらを読んでも
+ * 同じイベントを同じ順で、同じヒットの並び (未ヒット CH の空データを含む) で返すことを確認するプログラム
+ * 入力を指定しなければ、両方のレイアウトを持つテスト用のファイルを作って比較します
+ * (CH 0-3 の欠けたイベント, CH 0-3 以外だけのイベント, hgain の飽和, 欠けのある最後のイベントを含む)。
+ * 1つでも違えば終了コード 1。
+ *
+ * 使い方:
+ * $ make check
+ * $ ./check_layouts [eventtree2hist --layout both の出力.root] [pedestal.csv]
+ */
+
+#include "readData.hh"
+#include <TFile.h>
+#include <TTree.h>
+#include <TRandom3.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// テスト用のファイル: eventtree2hist --layout both --precision double と同じブランチ
+void WriteTestFile(const std::string &path) {
+    TFile f(path.c_str(), "RECREATE");
+    int eventID, ch, nhits, hitMask;
+    double hgain, lgain, tot, tdcDiff, timeDiff;
+    int e_ch[MAX_HITS_PER_EVENT];
+    double e_hgain[MAX_HITS_PER_EVENT], e_lgain[MAX_HITS_PER_EVENT], e_tot[MAX_HITS_PER_EVENT];
+    double e_tdcDiff[MAX_HITS_PER_EVENT], e_timeDiff[MAX_HITS_PER_EVENT];
+
+    TTree *hits = new TTree("processed_hits", "Processed Hit Data per Channel");
+    hits->Branch("eventID", &eventID, "eventID/I");
+    hits->Branch("ch", &ch, "ch/I");
+    hits->Branch("hgain", &hgain, "hgain/D");
+    hits->Branch("lgain", &lgain, "lgain/D");
+    hits->Branch("tot", &tot, "tot/D");
+    hits->Branch("tdc_diff", &tdcDiff, "tdc_diff/D");
+    hits->Branch("time_diff", &timeDiff, "time_diff/D");
+
+    TTree *events = new TTree("processed_events", "Processed Hit Data per Event");
+    events->Branch("eventID", &eventID, "eventID/I");
+    events->Branch("nhits", &nhits, "nhits/I");
+    events->Branch("hit_mask", &hitMask, "hit_mask/I");
+    events->Branch("ch", e_ch, "ch[nhits]/I");
+    events->Branch("hgain", e_hgain, "hgain[nhits]/D");
+    events->Branch("lgain", e_lgain, "lgain[nhits]/D");
+    events->Branch("tot", e_tot, "tot[nhits]/D");
+    events->Branch("tdc_diff", e_tdcDiff, "tdc_diff[nhits]/D");
+    events->Branch("time_diff", e_timeDiff, "time_diff[nhits]/D");
+
+    // (チャンネル, hgain) の並びでイベントを作る。最後のイベントは CH 1, 3 が欠ける
+    TRandom3 rng(20261018);
+    std::vector<std::vector<std::pair<int, double>>> layout = {
+        {{0, 900}, {1, 950}, {2, 1000}, {3, 1100}},
+        {{0, 900}, {1, 950}, {2, 1000}},
+        {{5, 900}},
+        {{0, 900}, {5, 950}, {3, 1000}, {1, 1100}},
+        {{2, 4100}, {0, 900}, {1, 950}, {3, 1000}},
+    };
+    for (int i = 0; i < 2000; ++i) {
+        std::vector<std::pair<int, double>> ev;
+        for (int c = 0; c < 6; ++c) {
+            if (rng.Uniform() < 0.8) ev.push_back({c, rng.Uniform(100, 4200)});
+        }
+        if (!ev.empty()) layout.push_back(ev);
+    }
+    layout.push_back({{0, 900}, {2, 1000}});
+
+    for (size_t i = 0; i < layout.size(); ++i) {
+        eventID = 10 + static_cast<int>(i) * 2;
+        nhits = 0;
+        hitMask = 0;
+        for (const auto &[c, q] : layout[i]) {
+            ch = c;
+            hgain = q;
+            lgain = 300 + q / 8;
+            tot = rng.Uniform(10, 40);
+            tdcDiff = rng.Uniform(-100, 100);
+            timeDiff = rng.Uniform(180, 260);
+            hits->Fill();
+            e_ch[nhits] = ch;
+            e_hgain[nhits] = hgain;
+            e_lgain[nhits] = lgain;
+            e_tot[nhits] = tot;
+            e_tdcDiff[nhits] = tdcDiff;
+            e_timeDiff[nhits] = timeDiff;
+            hitMask |= (1 << ch);
+            nhits++;
+        }
+        events->Fill();
+    }
+    f.Write();
+    f.Close();
+}
+
+bool SameHit(const PMTData &a, const PMTData &b) {
+    return a.eventID == b.eventID && a.ch == b.ch && a.time == b.time && a.charge == b.charge &&
+           a.isHit == b.isHit && a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+int main(int argc, char *argv[]) {
+    std::string input = argc > 1 ? argv[1] : "/tmp/check_layouts.root";
+    std::map<int, PedestalData> pedMap;
+    if (argc > 2) {
+        if (readPedestals(argv[2], pedMap) != 0) return 1;
+    } else {
+        for (int ch = 0; ch < 4; ++ch) pedMap[ch] = {};
+    }
+    if (argc <= 1) WriteTestFile(input);
+
+    DataReader eventReader(input, pedMap, true);
+    DataReader hitReader(input, pedMap, false);
+    if (!eventReader.isEventLayout()) {
+        std::cerr << "Error: " << input << " has no 'processed_events' (use eventtree2hist --layout both)" << std::endl;
+        return 1;
+    }
+
+    std::vector<PMTData> a, b;
+    long nEvents = 0, nMismatch = 0;
+    std::map<size_t, long> nBySize;
+    while (true) {
+        bool okA = eventReader.nextEvent(a);
+        bool okB = hitReader.nextEvent(b);
+        if (okA != okB) {
+            std::cerr << "[NG] イベント数が違います (" << nEvents << " イベント目で "
+                      << (okA ? "processed_hits" : "processed_events") << " が終わりました)" << std::endl;
+            return 1;
+        }
+        if (!okA) break;
+        nEvents++;
+        nBySize[a.size()]++;
+        bool same = a.size() == b.size();
+        for (size_t i = 0; same && i < a.size(); ++i) same = SameHit(a[i], b[i]);
+        if (!same) {
+            if (nMismatch < 10) {
+                std::cerr << "[NG] eventID " << (a.empty() ? -1 : a[0].eventID) << ": processed_events " << a.size()
+                          << " 個, processed_hits " << b.size() << " 個" << std::endl;
+            }
+            nMismatch++;
+        }
+    }
+
+    std::cout << "Events: " << nEvents << " (ヒット数ごと:";
+    for (const auto &[n, count] : nBySize) std::cout << " " << n << "=" << count;
+    std::cout << ")" << std::endl;
+    if (nMismatch > 0) {
+        std::cout << "不一致: " << nMismatch << " イベント" << std::endl;
+        return 1;
+    }
+    std::cout << "[OK] 両方のレイアウトで同じイベント・同じヒットの並びになりました" << std::endl;
+    return 0;
+}
@@ -81,6 +81,9 @@
 // =========================================================
 const double C_LIGHT = 29.970255; // 光速 [cm/ns] (空気中の屈折率 n=1.0003 を考慮)
 
+// ※ 時間補正値・TimeWalk・時間分解能は、時間較正ファイル (make_time_calib の出力、reconstructor -C) が
+//    あればそちらを使います (timeCalib.hh)。以下は較正ファイルが無いときの既定値です。
+
 // PMTごとの時間補正値 (ns) : ケーブル遅延やT0オフセット
 // t_expected の計算に使用されます: t_exp = t0 + tof + TW + CORRECTION
 const double TIME_CORRECTION_VAL[4] = {190.23, 213.561, 217.03, 242.587};
@@ -478,10 +481,12 @@ enum class ChargeChi2Type {
  * @enum ChargeModelType
  * @brief 電荷の期待値モデル
  * @note 古いモデルは削除され、FuncF, FuncGのみとなりました。
+ *       Table は (距離, cos) の参照テーブルを補間します (chargeTable.hh)。
  */
 enum class ChargeModelType {
     FuncF,          // r=28.5, 立体角近似式
-    FuncG           // r=23.5, 1/r^2
+    FuncG,          // r=23.5, 1/r^2
+    Table           // 参照テーブル (解析モデル or 較正データセットから作成)
 };
 
 /**
@@ -495,13 +500,29 @@ enum class TimeChi2Type {
     None            // 時間情報を使用しない
 };
 
+/**
+ * @enum ErrorMode
+ * @brief パラメータ誤差の計算方法
+ * 後ろに行くほど正確だがCPUコストが大きくなります。
+ */
+enum class ErrorMode {
+    None,           // 誤差を計算しない (MIGRAD STRATEGY 0、誤差は -9999)
+    Migrad,         // MIGRAD終了時の近似共分散 (従来の動作)
+    Hesse,          // MIGRAD後にHESSEで2階微分行列を再計算
+    Minos           // HESSEに加えて x,y,z,t のMINOS非対称誤差を計算
+};
+
 struct FitConfig {
     ChargeChi2Type chargeType = ChargeChi2Type::Gaussian;
     ChargeModelType chargeModel = ChargeModelType::FuncF; // デフォルト
     TimeChi2Type timeType = TimeChi2Type::Gaussian;
+    ErrorMode errorMode = ErrorMode::Migrad;
     bool useUnhit = false;
 };
 
+// 共分散行列に含めるパラメータ数 (x, y, z, t, A の順。Bは常に固定なので含めない)
+const int N_COV_PARAMS = 5;
+
 struct FitResult {
     double x, y, z, t;
     double err_x, err_y, err_z, err_t;
@@ -509,6 +530,17 @@ struct FitResult {
     double chi2;
     int ndf;
     int status;
+
+    // 共分散行列 [x,y,z,t,A][x,y,z,t,A]。固定パラメータの行・列は 0
+    double cov[N_COV_PARAMS][N_COV_PARAMS];
+    // MINOS 非対称誤差 (x,y,z,t)。ErrorMode::Minos 以外では -9999
+    double errp[4];
+    double errn[4];
+
+    // CPUコスト (ms) と FCN呼び出し回数
+    double cpu_minimize; // MIGRAD
+    double cpu_error;    // HESSE / MINOS
+    int nfcn;
 };
 
 #endif // FITTINGINPUT_HH
\ No newline at end of file
@@ -10,18 +10,28 @@
  *
  * @author Gemini (Modified based on user request)
  * @date 2025-01-08
+ * (修正: 2026-10-18 Gemini (時間較正ファイル -C / time_calib.txt の読み込みを追加) )
  */
 
 #include "readData.hh"
 #include "onemPMTfit.hh"
 #include "fittinginput.hh"
+#include "chargeTable.hh"
+#include "timeCalib.hh"
+#include "parallelReco.hh"
 #include <TFile.h>
 #include <TTree.h>
+#include <TROOT.h>
+#include <TStopwatch.h>
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <unistd.h>
 #include <sstream>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <TString.h>
 
 /**
  * @brief 使い方とオプションの説明を表示する関数
@@ -46,8 +56,15 @@ void PrintUsage(const char* progName) {
     std::cout << "      func_f : r=28.5cm, mu = A * c0 * (1 - sqrt(1 - (28.5/r)^2)) * eps" << std::endl;
     std::cout << "      func_g : r=23.5cm, mu = A * c0 / r^2 * eps" << std::endl;
     std::cout << "      all    : func_f と func_g の両方で解析を実行（2回解析）" << std::endl;
+    std::cout << "      table  : (距離, cos) の参照テーブルを双線形補間 (-T で指定、省略時は func_f から生成)" << std::endl;
+    std::cout << "               時間モデルが gaus/none のときは解析的勾配でMIGRADを実行します" << std::endl;
     std::cout << "               ※ 係数c0, eps(角度依存)は fittinginput.hh で設定" << std::endl;
 
+    std::cout << "  -T <file>  : -m table で使う電荷テーブルファイル (make_charge_table で作成)" << std::endl;
+    std::cout << "  -C <file>  : 時間較正ファイル (make_time_calib で作成)" << std::endl;
+    std::cout << "               省略時は入力ROOTファイルと同じディレクトリの 'time_calib.txt' があれば読み、" << std::endl;
+    std::cout << "               無ければ fittinginput.hh の値を使います" << std::endl;
+
     std::cout << "  -q <model> : 電荷Chi2定義 (デフォルト: gaus)" << std::endl;
     std::cout << "      gaus : Gaussian" << std::endl;
     std::cout << "      bc   : Baker-Cousins (Poisson分布に基づく尤度比)" << std::endl;
@@ -58,16 +75,34 @@ void PrintUsage(const char* progName) {
     std::cout << "      goodness : SK風Goodness" << std::endl;
     std::cout << "      emg      : EMG分布 (現在は試験的実装)" << std::endl;
     std::cout << "      none     : 時間情報を使用しない (電荷のみでフィット)" << std::endl;
+
+    std::cout << "  -e <mode>  : 誤差計算モード (デフォルト: migrad)" << std::endl;
+    std::cout << "      none   : 誤差を計算しない (最速、誤差列は -9999)" << std::endl;
+    std::cout << "      migrad : MIGRAD終了時の近似共分散 (従来の動作)" << std::endl;
+    std::cout << "      hesse  : HESSEで共分散を再計算 (較正用サブセット向け)" << std::endl;
+    std::cout << "      minos  : HESSE + x,y,z,t のMINOS非対称誤差 (最も高コスト)" << std::endl;
+    std::cout << "      ※ 終了時にモードごとのCPUコスト (ms/event, FCN呼び出し回数) を表示します" << std::endl;
+
+    std::cout << "  -j <N>     : フィットに使うスレッド数 (デフォルト: 1、0 = 全コア)" << std::endl;
+    std::cout << "               8イベントずつのチャンクをワークスティーリングで各スレッドに配ります。" << std::endl;
+    std::cout << "               出力の順序・内容はスレッド数によらず同じです。" << std::endl;
     
     std::cout << "\n[出力]" << std::endl;
     std::cout << "  入力ファイル名にオプションに応じたサフィックスを付与して出力します。" << std::endl;
     std::cout << "  例: run01_reconst_3hits_bc_func_f_goodness.root" << std::endl;
     std::cout << "  run01_reconst_3hits_bc_func_f_goodness.csv" << std::endl;
-    std::cout << "  CSV出力列: fit_x,fit_y,fit_z,t_light,err_x,err_y,err_z,err_t,chi2,ndf,A,B,status" << std::endl;
+    std::cout << "  CSV出力列: fit_x,fit_y,fit_z,t_light,err_x,err_y,err_z,err_t,chi2,ndf,A,B,status,eventID,nhits," << std::endl;
+    std::cout << "             rho_xy,rho_xz,rho_yz,rho_xt,rho_yt,rho_zt (相関係数)" << std::endl;
     std::cout << "  ※計算に使用しなかったパラメータは -9999 が出力されます。" << std::endl;
+    std::cout << "  ROOT出力 (TTree 'fit_results') には上記に加えて以下を保存します:" << std::endl;
+    std::cout << "    eventID, nhits, hit_mask (bit i = CH i がヒット), charge[4] (pC), time[4] (ns)" << std::endl;
+    std::cout << "    cov[5][5] (x,y,z,t,A の共分散), errp[4]/errn[4] (MINOS誤差), cpu_minimize/cpu_error (ms), nfcn" << std::endl;
+    std::cout << "    ※ eventID でインデックス済みのため、processed_hits の friend として結合できます:" << std::endl;
+    std::cout << "       processed_hits->AddFriend(\"fit_results\", \"<出力ROOTファイル>\")" << std::endl;
     
     std::cout << "\n[設定]" << std::endl;
-    std::cout << "  TimeWalk係数やSigma係数、ジオメトリ等は 'fittinginput.hh' で定義されています。" << std::endl;
+    std::cout << "  TimeWalk係数・時間補正値・Sigma係数は時間較正ファイル (-C, make_time_calib) から読みます。" << std::endl;
+    std::cout << "  較正ファイルが無いときの既定値、ジオメトリ等は 'fittinginput.hh' で定義されています。" << std::endl;
    
     std::cout << "\n[必要なもの]" << std::endl;
     std::cout << "  - ROOT形式の入力データファイル" << std::endl;
@@ -82,9 +117,12 @@ int main(int argc, char** argv) {
     int opt;
     std::string inputBinFile;
     bool useAllModels = false;  // allオプション用フラグ
+    std::string chargeTableFile; // -m table 用
+    std::string timeCalibFile;   // -C
+    int nThreads = 1;            // -j
     
     // オプション解析
-    while ((opt = getopt(argc, argv, "u:m:q:t:h")) != -1) {
+    while ((opt = getopt(argc, argv, "u:m:q:t:e:T:C:j:h")) != -1) {
         switch (opt) {
             case 'u': config.useUnhit = (std::stoi(optarg) == 1); break;
             case 'm':
@@ -93,6 +131,8 @@ int main(int argc, char** argv) {
                     config.chargeModel = ChargeModelType::FuncF;  // 初期値をFuncFに設定
                 } else if (std::string(optarg) == "func_g") {
                     config.chargeModel = ChargeModelType::FuncG;
+                } else if (std::string(optarg) == "table") {
+                    config.chargeModel = ChargeModelType::Table;
                 } else {
                     config.chargeModel = ChargeModelType::FuncF;
                 }
@@ -108,6 +148,18 @@ int main(int argc, char** argv) {
                 else if (std::string(optarg) == "none") config.timeType = TimeChi2Type::None;
                 else config.timeType = TimeChi2Type::Gaussian;
                 break;
+            case 'e':
+                if (std::string(optarg) == "none") config.errorMode = ErrorMode::None;
+                else if (std::string(optarg) == "hesse") config.errorMode = ErrorMode::Hesse;
+                else if (std::string(optarg) == "minos") config.errorMode = ErrorMode::Minos;
+                else config.errorMode = ErrorMode::Migrad;
+                break;
+            case 'T': chargeTableFile = optarg; break;
+            case 'C': timeCalibFile = optarg; break;
+            case 'j':
+                nThreads = std::stoi(optarg);
+                if (nThreads <= 0) nThreads = std::max(1u, std::thread::hardware_concurrency());
+                break;
             case 'h':
                 PrintUsage(argv[0]);
                 return 0;
@@ -124,6 +176,9 @@ int main(int argc, char** argv) {
     }
     inputBinFile = argv[optind];
 
+    // 複数スレッドで TMinuit を回すため ROOT のスレッド安全機構を有効にする
+    if (nThreads > 1) ROOT::EnableThreadSafety();
+
     // 処理対象のモデルリストを生成
     std::vector<FitConfig> configList;
     if (useAllModels) {
@@ -152,6 +207,33 @@ int main(int argc, char** argv) {
     size_t pos = baseName.find(suffixToRemove);
     if (pos != std::string::npos) baseName.replace(pos, suffixToRemove.length(), "");
 
+    // 電荷テーブルの準備 (-m table のときのみ)
+    ChargeTable chargeTable;
+    if (config.chargeModel == ChargeModelType::Table && !useAllModels) {
+        if (!chargeTableFile.empty()) {
+            if (!chargeTable.Load(chargeTableFile)) return 1;
+            std::cout << "電荷テーブルを読み込みました: " << chargeTableFile
+                      << " (r_pmt=" << chargeTable.GetPmtRadius() << " cm)" << std::endl;
+        } else {
+            chargeTable.BuildFromAnalytic(ChargeModelType::FuncF);
+            std::cout << "電荷テーブル未指定のため func_f から生成しました" << std::endl;
+        }
+    }
+
+    // 時間較正の準備 (フィットのスレッドを作る前に置き換える)
+    {
+        std::string calibFile = timeCalibFile.empty() ? dirPath + "time_calib.txt" : timeCalibFile;
+        std::ifstream probe(calibFile);
+        if (probe.good() || !timeCalibFile.empty()) {
+            TimeCalibration calib = TimeCalibration::Defaults();
+            if (!calib.Load(calibFile)) return 1;
+            SetTimeCalibration(calib);
+            std::cout << "時間較正ファイルを読み込みました: " << calibFile << std::endl;
+        } else {
+            std::cout << "時間較正ファイルが無いため fittinginput.hh の値を使います (" << calibFile << ")" << std::endl;
+        }
+    }
+
     // ペデスタル読み込み
     std::string pedestalFile = dirPath + "hkelec_pedestal_hithist_means.txt";
     std::map<int, PedestalData> pedMap;
@@ -177,6 +259,7 @@ int main(int argc, char** argv) {
         // 電荷モデル Suffix
         if (currentConfig.chargeType != ChargeChi2Type::None) {
             if (currentConfig.chargeModel == ChargeModelType::FuncG) ss << "_func_g";
+            else if (currentConfig.chargeModel == ChargeModelType::Table) ss << "_table";
             else ss << "_func_f";
         }
 
@@ -186,6 +269,11 @@ int main(int argc, char** argv) {
         else if (currentConfig.timeType == TimeChi2Type::None) ss << "_noT";
         else ss << "_gausT";
 
+        // 誤差モード Suffix (デフォルトの migrad では付けない)
+        if (currentConfig.errorMode == ErrorMode::None) ss << "_noErr";
+        else if (currentConfig.errorMode == ErrorMode::Hesse) ss << "_hesse";
+        else if (currentConfig.errorMode == ErrorMode::Minos) ss << "_minos";
+
         // 出力ファイル名生成
         std::string outputRootFile = dirPath + baseName + ss.str() + ".root";
         std::string outputCsvFile = dirPath + baseName + ss.str() + ".csv";
@@ -196,7 +284,8 @@ int main(int argc, char** argv) {
         std::cout << "出力ファイル: " << outputRootFile << std::endl;
         std::cout << "モデル設定: Charge=" << (int)currentConfig.chargeType 
                   << ", Model=" << (int)currentConfig.chargeModel 
-                  << ", Time=" << (int)currentConfig.timeType << std::endl;
+                  << ", Time=" << (int)currentConfig.timeType
+                  << ", Error=" << (int)currentConfig.errorMode << std::endl;
         std::cout << "------------------------------------------------" << std::endl;
 
         // データリーダー初期化
@@ -206,70 +295,140 @@ int main(int argc, char** argv) {
         TFile *fOut = new TFile(outputRootFile.c_str(), "RECREATE");
         TTree *tOut = new TTree("fit_results", "Fit Results");
         FitResult res;
+
+        // イベント情報 (入力 processed_hits との結合用)
+        int out_eventID = -1;
+        int out_nHits = 0;
+        int out_hitMask = 0;    // bit i が立っていれば CH i が実ヒット
+        double out_charge[4];   // ペデスタル補正済み電荷 (pC)、非ヒットは -9999
+        double out_time[4];     // time_diff (ns)、非ヒットは -9999
         
         // ブランチ設定
         tOut->Branch("fit_x", &res.x, "fit_x/D");
         tOut->Branch("fit_y", &res.y, "fit_y/D");
         tOut->Branch("fit_z", &res.z, "fit_z/D");
         tOut->Branch("t_light", &res.t, "t_light/D");
+        tOut->Branch("err_x", &res.err_x, "err_x/D");
+        tOut->Branch("err_y", &res.err_y, "err_y/D");
+        tOut->Branch("err_z", &res.err_z, "err_z/D");
+        tOut->Branch("err_t", &res.err_t, "err_t/D");
         tOut->Branch("chi2", &res.chi2, "chi2/D");
         tOut->Branch("ndf", &res.ndf, "ndf/I");
         tOut->Branch("A", &res.A, "A/D");
         tOut->Branch("B", &res.B, "B/D");
         tOut->Branch("status", &res.status, "status/I");
+        tOut->Branch("eventID", &out_eventID, "eventID/I");
+        tOut->Branch("nhits", &out_nHits, "nhits/I");
+        tOut->Branch("hit_mask", &out_hitMask, "hit_mask/I");
+        tOut->Branch("charge", out_charge, "charge[4]/D");
+        tOut->Branch("time", out_time, "time[4]/D");
+        tOut->Branch("cov", res.cov, Form("cov[%d][%d]/D", N_COV_PARAMS, N_COV_PARAMS));
+        tOut->Branch("errp", res.errp, "errp[4]/D");
+        tOut->Branch("errn", res.errn, "errn[4]/D");
+        tOut->Branch("cpu_minimize", &res.cpu_minimize, "cpu_minimize/D");
+        tOut->Branch("cpu_error", &res.cpu_error, "cpu_error/D");
+        tOut->Branch("nfcn", &res.nfcn, "nfcn/I");
 
         std::ofstream ofs(outputCsvFile.c_str());
-        ofs << "fit_x,fit_y,fit_z,t_light,err_x,err_y,err_z,err_t,chi2,ndf,A,B,status\n";
+        ofs << "fit_x,fit_y,fit_z,t_light,err_x,err_y,err_z,err_t,chi2,ndf,A,B,status,eventID,nhits,"
+            << "rho_xy,rho_xz,rho_yz,rho_xt,rho_yt,rho_zt\n";
 
-        // フィッター初期化
-        LightSourceFitter fitter;
-        fitter.SetConfig(currentConfig);
+        // フィッター初期化 (ワーカーごとに1つ)
+        // 従来どおりファイル名からの初期値推定は使わない (重心で初期化)
+        ParallelReconstructor reco(currentConfig, nThreads, &chargeTable, "");
 
         // データループ
+        // BLOCK_SIZE イベントずつ読み込み、ブロック内を並列にフィットしてから入力順に書き出す
+        const size_t BLOCK_SIZE = 4096;
+        std::vector<std::vector<PMTData>> block(BLOCK_SIZE);
+        std::vector<FitResult> blockResults(BLOCK_SIZE);
+        std::vector<char> blockConverged(BLOCK_SIZE);
         std::vector<PMTData> eventHits;
         int n_total = 0;
         int n_success = 0;
+        int n_fitted = 0;
+        double sum_cpu_minimize = 0.0;
+        double sum_cpu_error = 0.0;
+        long sum_nfcn = 0;
+        TStopwatch wallClock;
+        wallClock.Start();
+
+        bool moreEvents = true;
+        while (moreEvents) {
+            size_t nBlock = 0;
+            while (nBlock < BLOCK_SIZE) {
+                if (!reader.nextEvent(eventHits)) {
+                    moreEvents = false;
+                    break;
+                }
+                n_total++;
 
-        while (reader.nextEvent(eventHits)) {
-            n_total++;
-
-            if (currentConfig.useUnhit) {
-                if (eventHits.size() < 3) continue;
-                if (eventHits.size() == 3) {
-                    // 欠損CHをUnhit(0)として追加
-                    bool hitFlags[4] = {false, false, false, false};
-                    int eventID = eventHits[0].eventID;
-                    for (const auto& hit : eventHits) hitFlags[hit.ch] = true;
-                    for (int ch = 0; ch < 4; ++ch) {
-                        if (!hitFlags[ch]) {
-                            PMTData unhitData;
-                            unhitData.eventID = eventID;
-                            unhitData.ch = ch;
-                            unhitData.charge = 0.0;
-                            unhitData.time = -9999.0;
-                            unhitData.isHit = false;
-                            unhitData.x = PMT_POSITIONS[ch][0]; 
-                            unhitData.y = PMT_POSITIONS[ch][1];
-                            unhitData.z = PMT_POSITIONS[ch][2];
-                            eventHits.push_back(unhitData);
-                            break;
+                if (currentConfig.useUnhit) {
+                    if (eventHits.size() < 3) continue;
+                    if (eventHits.size() == 3) {
+                        // 欠損CHをUnhit(0)として追加
+                        bool hitFlags[4] = {false, false, false, false};
+                        int eventID = eventHits[0].eventID;
+                        for (const auto& hit : eventHits) hitFlags[hit.ch] = true;
+                        for (int ch = 0; ch < 4; ++ch) {
+                            if (!hitFlags[ch]) {
+                                PMTData unhitData;
+                                unhitData.eventID = eventID;
+                                unhitData.ch = ch;
+                                unhitData.charge = 0.0;
+                                unhitData.time = -9999.0;
+                                unhitData.isHit = false;
+                                unhitData.x = PMT_POSITIONS[ch][0]; 
+                                unhitData.y = PMT_POSITIONS[ch][1];
+                                unhitData.z = PMT_POSITIONS[ch][2];
+                                eventHits.push_back(unhitData);
+                                break;
+                            }
                         }
                     }
+                } else {
+                    if (eventHits.size() < 4) continue;
                 }
-            } else {
-                if (eventHits.size() < 4) continue;
+
+                block[nBlock++] = eventHits;
             }
 
-            if (fitter.FitEvent(eventHits, res)) {
+            reco.FitBlock(block, nBlock, blockResults, blockConverged);
+
+            for (size_t i = 0; i < nBlock; ++i) {
+                const auto& hits = block[i];
+                res = blockResults[i];
+
+                // イベント情報の収集 (Unhit補完分は isHit=false なので数えない)
+                out_eventID = hits.empty() ? -1 : hits[0].eventID;
+                out_nHits = 0;
+                out_hitMask = 0;
+                for (int ch = 0; ch < 4; ++ch) {
+                    out_charge[ch] = -9999;
+                    out_time[ch] = -9999;
+                }
+                for (const auto& hit : hits) {
+                    if (!hit.isHit || hit.ch < 0 || hit.ch >= 4) continue;
+                    out_nHits++;
+                    out_hitMask |= (1 << hit.ch);
+                    out_charge[hit.ch] = hit.charge;
+                    out_time[hit.ch] = hit.time;
+                }
+
+                n_fitted++;
+                sum_cpu_minimize += res.cpu_minimize;
+                sum_cpu_error += res.cpu_error;
+                sum_nfcn += res.nfcn;
+
+                if (!blockConverged[i]) continue;
+
                 // 未計算値のマスク処理 (-9999)
                 if (currentConfig.chargeType == ChargeChi2Type::None) {
                     res.A = -9999;
                     res.B = -9999;
                 } else {
-                    // ChargeFit有効時: Bは今回のモデルで存在しないため -9999 に設定
-                    if (currentConfig.chargeModel == ChargeModelType::FuncF || currentConfig.chargeModel == ChargeModelType::FuncG) {
-                        res.B = -9999;
-                    }
+                    // ChargeFit有効時: Bは今回のモデル (FuncF, FuncG, Table) で存在しないため -9999 に設定
+                    res.B = -9999;
                 }
                 
                 if (currentConfig.timeType == TimeChi2Type::None) {
@@ -280,18 +439,44 @@ int main(int argc, char** argv) {
                 tOut->Fill();
                 ofs << res.x << "," << res.y << "," << res.z << "," << res.t << ","
                     << res.err_x << "," << res.err_y << "," << res.err_z << "," << res.err_t << ","
-                    << res.chi2 << "," << res.ndf << "," << res.A << "," << res.B << "," << res.status << "\n";
+                    << res.chi2 << "," << res.ndf << "," << res.A << "," << res.B << "," << res.status << ","
+                    << out_eventID << "," << out_nHits;
+                // 相関係数 (x,y,z,t の組)。誤差を計算していない場合は -9999
+                const int pairs[6][2] = {{0, 1}, {0, 2}, {1, 2}, {0, 3}, {1, 3}, {2, 3}};
+                for (const auto& p : pairs) {
+                    double vi = res.cov[p[0]][p[0]];
+                    double vj = res.cov[p[1]][p[1]];
+                    double rho = (vi > 0 && vj > 0) ? res.cov[p[0]][p[1]] / std::sqrt(vi * vj) : -9999;
+                    ofs << "," << rho;
+                }
+                ofs << "\n";
                 n_success++;
             }
-            
-            if (n_total % 1000 == 0) std::cout << "処理中... " << n_total << " events" << std::endl;
+
+            if (nBlock > 0) std::cout << "処理中... " << n_total << " events" << std::endl;
         }
+        wallClock.Stop();
+
+        // eventID でインデックスを作成しておく
+        // (processed_hits に AddFriend すると、ヒットごとに同じ eventID のフィット結果が引ける)
+        if (tOut->GetEntries() > 0) tOut->BuildIndex("eventID");
 
         tOut->Write();
         fOut->Close();
         ofs.close();
         
         std::cout << "完了: 全" << n_total << "イベント中、" << n_success << "イベントが収束しました。" << std::endl;
+        if (n_fitted > 0) {
+            const char* modeNames[] = {"none", "migrad", "hesse", "minos"};
+            std::cout << "CPUコスト (誤差モード=" << modeNames[(int)currentConfig.errorMode] << ", "
+                      << n_fitted << "フィット):" << std::endl;
+            std::cout << "  MIGRAD   : " << sum_cpu_minimize / n_fitted << " ms/event" << std::endl;
+            std::cout << "  誤差計算 : " << sum_cpu_error / n_fitted << " ms/event" << std::endl;
+            std::cout << "  FCN呼出し: " << (double)sum_nfcn / n_fitted << " 回/event" << std::endl;
+            std::cout << "  実時間   : " << wallClock.RealTime() << " s (" << reco.GetNThreads() << "スレッド, "
+                      << n_fitted / std::max(wallClock.RealTime(), 1e-9) << " events/s, スティール "
+                      << reco.GetNSteals() << "回)" << std::endl;
+        }
         std::cout << std::endl;
     }
 
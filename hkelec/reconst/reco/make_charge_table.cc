@@ -0,0 +1,127 @@
+/*
+ * id: make_charge_table.cc
+ * Place: /home/daiki/keio/hkelec/reconst/reco/
+ * Author: Gemini (Modified based on user request)
+ * Last Edit: 2026-10-18
+ *
+ * 概要:
+ * reconstructor の電荷モデル "-m table" 用の参照テーブルを作成するプログラム
+ * 既存の解析モデル (func_f / func_g) を格子点で評価するか、
+ * 較正データセット (models/create_dataset.py の出力CSV) から作成してファイルに保存します。
+ *
+ * 使い方:
+ * $ ./make_charge_table -b func_f -o charge_table_func_f.txt
+ * $ ./make_charge_table -d dataset.csv -r 29.0 -o charge_table_data.txt
+ */
+
+#include "chargeTable.hh"
+#include <iostream>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <unistd.h>
+
+void PrintUsage(const char* progName) {
+    std::cout << "======================================================================" << std::endl;
+    std::cout << "  電荷応答テーブル作成プログラム (make_charge_table)" << std::endl;
+    std::cout << "======================================================================" << std::endl;
+    std::cout << "\n[概要]" << std::endl;
+    std::cout << "  各CHについて (PMT球中心からの距離 r, 入射角 cos(alpha)) の格子上で" << std::endl;
+    std::cout << "  光量 A=1 のときの期待電荷を計算し、テキストファイルに保存します。" << std::endl;
+    std::cout << "  reconstructor -m table -T <出力ファイル> で使用します。" << std::endl;
+
+    std::cout << "\n[使い方]" << std::endl;
+    std::cout << "  " << progName << " (-b <model> | -d <dataset.csv>) [オプション]" << std::endl;
+
+    std::cout << "\n[オプション]" << std::endl;
+    std::cout << "  -b <model> : 解析モデルから作成 (func_f / func_g、係数は fittinginput.hh)" << std::endl;
+    std::cout << "  -d <file>  : 較正データセットCSVから作成 (create_dataset.py の出力)" << std::endl;
+    std::cout << "               応答 = Charge(pC) / light_power をカーネル平均で格子に割り付けます" << std::endl;
+    std::cout << "  -r <cm>    : -d 使用時の PMT半径 (球中心 Z = 80.5 - r、デフォルト: " << PMT_RADIUS_F << ")" << std::endl;
+    std::cout << "  -n <nR>    : 距離方向の格子点数 (デフォルト: 450、範囲 20-470 cm)" << std::endl;
+    std::cout << "  -c <nCos>  : cos方向の格子点数 (デフォルト: 201、範囲 -1-1)" << std::endl;
+    std::cout << "  -o <file>  : 出力ファイル (デフォルト: charge_table.txt)" << std::endl;
+
+    std::cout << "\n[出力]" << std::endl;
+    std::cout << "  1行目: r_pmt n_r r_min r_max n_cos cos_min cos_max" << std::endl;
+    std::cout << "  以降 : CH0~CH3 の順に、r 格子ごとに n_cos 個の値" << std::endl;
+    std::cout << "  -b の場合は格子中間点での補間誤差 (解析式との最大相対差) を表示します。" << std::endl;
+    std::cout << "======================================================================" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    std::string baseModel;
+    std::string datasetFile;
+    std::string outputFile = "charge_table.txt";
+    double rPmt = PMT_RADIUS_F;
+    int nR = 450;
+    int nCos = 201;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:d:r:n:c:o:h")) != -1) {
+        switch (opt) {
+            case 'b': baseModel = optarg; break;
+            case 'd': datasetFile = optarg; break;
+            case 'r': rPmt = std::stod(optarg); break;
+            case 'n': nR = std::stoi(optarg); break;
+            case 'c': nCos = std::stoi(optarg); break;
+            case 'o': outputFile = optarg; break;
+            case 'h':
+                PrintUsage(argv[0]);
+                return 0;
+            default:
+                PrintUsage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (baseModel.empty() == datasetFile.empty()) {
+        std::cerr << "エラー: -b と -d のどちらか一方を指定してください。\n" << std::endl;
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    ChargeTable table;
+    if (!baseModel.empty()) {
+        ChargeModelType model = (baseModel == "func_g") ? ChargeModelType::FuncG : ChargeModelType::FuncF;
+        table.BuildFromAnalytic(model, nR, 20.0, 470.0, nCos);
+        std::cout << "解析モデル " << baseModel << " からテーブルを作成しました (r_pmt="
+                  << table.GetPmtRadius() << " cm)" << std::endl;
+
+        // 補間誤差の確認: 格子中間点で解析式と比較 (PMT表面から 5 cm 以上離れた範囲)
+        // epsilon が 0 付近 (同じ距離での最大値の 1% 未満) の点は相対誤差が発散するので除く
+        double dR = (470.0 - 20.0) / (nR - 1);
+        double dC = 2.0 / (nCos - 1);
+        for (int ch = 0; ch < 4; ++ch) {
+            double maxRel = 0.0;
+            for (int ir = 0; ir < nR - 1; ++ir) {
+                double r = 20.0 + (ir + 0.5) * dR;
+                if (r < table.GetPmtRadius() + 5.0) continue;
+                std::vector<double> exact(nCos - 1);
+                double rowMax = 0.0;
+                for (int ic = 0; ic < nCos - 1; ++ic) {
+                    exact[ic] = AnalyticChargeResponse(model, ch, r, r * r, -1.0 + (ic + 0.5) * dC);
+                    rowMax = std::max(rowMax, exact[ic]);
+                }
+                for (int ic = 0; ic < nCos - 1; ++ic) {
+                    if (exact[ic] < 0.01 * rowMax) continue;
+                    double c = -1.0 + (ic + 0.5) * dC;
+                    maxRel = std::max(maxRel, std::fabs(table.Eval(ch, r, c) - exact[ic]) / exact[ic]);
+                }
+            }
+            std::cout << "  CH" << ch << ": 最大相対補間誤差 = " << maxRel << std::endl;
+        }
+    } else {
+        std::cout << "データセットからテーブルを作成します: " << datasetFile
+                  << " (r_pmt=" << rPmt << " cm)" << std::endl;
+        if (!table.BuildFromDataset(datasetFile, rPmt, nR, 20.0, 470.0, nCos)) {
+            std::cerr << "エラー: データ点が無いCHがあります。" << std::endl;
+            return 1;
+        }
+    }
+
+    if (!table.Save(outputFile)) return 1;
+    std::cout << "保存しました: " << outputFile << std::endl;
+    return 0;
+}
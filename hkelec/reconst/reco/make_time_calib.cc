@@ -0,0 +1,211 @@
+/*
+ * id: make_time_calib.cc
+ * Place: /home/daiki/keio/hkelec/reconst/reco/
+ * Author: Gemini (Modified based on user request)
+ * Last Edit: 2026-10-18
+ *
+ * 概要:
+ * reconstructor の時間較正ファイル (TimeWalk・時間補正値・時間分解能) を作成するプログラム
+ * plot_summary が書く summary_all_data.csv (CHごと・電荷ごとの時間分布の Mean/RMS) を読み、
+ * CHごとに Charge vs Mean / Charge vs RMS を f(q) = c0 q^{-1/2} + c1 + c2 q + c3 q^2 でフィットします。
+ * f はパラメータについて線形なので重み付き最小二乗を閉じた形で解き (timeCalib.hh の FitTimeCurve)、
+ * 4 CH x 2 曲線のフィットを -j のスレッドで並列に処理します。
+ *   t_corr = Mean の曲線の最小値、TW = Mean の曲線 - t_corr、
+ *   tw_max = データの電荷の範囲での TW の最大値 (範囲外の小さい電荷への外挿を抑える)
+ * 以前 fittinginput.hh に手で写していた TIME_CORRECTION_VAL / TW_PARAMS / TW_MAX_VALUES / SIGMA_T_PARAMS に当たります。
+ *
+ * 使い方:
+ * $ ./make_time_calib <dir>/summary_all_data.csv -o <dir>/time_calib.txt
+ */
+
+#include "timeCalib.hh"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <unistd.h>
+
+void PrintUsage(const char* progName) {
+    std::cout << "======================================================================" << std::endl;
+    std::cout << "  時間較正ファイル作成プログラム (make_time_calib)" << std::endl;
+    std::cout << "======================================================================" << std::endl;
+    std::cout << "\n[概要]" << std::endl;
+    std::cout << "  plot_summary の summary_all_data.csv から、CHごとに" << std::endl;
+    std::cout << "  Charge vs Mean (TimeWalk・時間補正値) と Charge vs RMS (時間分解能) をフィットし、" << std::endl;
+    std::cout << "  reconstructor -C <出力ファイル> で使う時間較正ファイルを作成します。" << std::endl;
+    std::cout << "  関数形: f(q) = c0 * q^{-1/2} + c1 + c2 * q + c3 * q^2 (重み付き最小二乗、閉じた形で解く)" << std::endl;
+
+    std::cout << "\n[使い方]" << std::endl;
+    std::cout << "  " << progName << " <summary_all_data.csv> [オプション]" << std::endl;
+
+    std::cout << "\n[オプション]" << std::endl;
+    std::cout << "  -o <file>  : 出力ファイル (デフォルト: 入力と同じディレクトリの time_calib.txt)" << std::endl;
+    std::cout << "  -j <N>     : スレッド数 (デフォルト: 全コア、ジョブは 4 CH x 2 曲線)" << std::endl;
+    std::cout << "  -n <N>     : 有効分散 (電荷の誤差 x 傾き) の重みの反復回数 (デフォルト: 3)" << std::endl;
+
+    std::cout << "\n[出力]" << std::endl;
+    std::cout << "  CHごとに1行: ch t_corr tw_c0 tw_c1 tw_c2 tw_c3 tw_max sigma_c0 sigma_c1 sigma_c2 sigma_c3" << std::endl;
+    std::cout << "    t_corr : Mean の曲線の最小値 (範囲 [0, 1.1 x 最大電荷]、plot_summary の min_val と同じ)" << std::endl;
+    std::cout << "    tw_*   : Mean の曲線から t_corr を引いたもの (tw_c1 = c1 - t_corr)" << std::endl;
+    std::cout << "    tw_max : データの電荷の範囲での TW の最大値" << std::endl;
+    std::cout << "    sigma_*: RMS の曲線" << std::endl;
+    std::cout << "  点が足りない (5点未満) CH は fittinginput.hh の値のまま書き、警告を表示します。" << std::endl;
+    std::cout << "======================================================================" << std::endl;
+}
+
+// CSV 1行を分割
+static std::vector<std::string> SplitCsvLine(const std::string& line) {
+    std::vector<std::string> cols;
+    std::string cur;
+    for (char ch : line) {
+        if (ch == ',') { cols.push_back(cur); cur.clear(); }
+        else if (ch != '\r') cur += ch;
+    }
+    cols.push_back(cur);
+    return cols;
+}
+
+// CHごとの点 (電荷, Mean, RMS)
+struct ChannelPoints {
+    std::vector<double> q, qErr, mean, meanErr, rms, rmsErr;
+};
+
+bool LoadSummaryCsv(const std::string& csvFile, ChannelPoints points[4]) {
+    std::ifstream ifs(csvFile);
+    if (!ifs.is_open()) {
+        std::cerr << "エラー: 入力ファイルを開けません: " << csvFile << std::endl;
+        return false;
+    }
+    std::string line;
+    if (!std::getline(ifs, line)) return false;
+    std::vector<std::string> header = SplitCsvLine(line);
+    auto column = [&](const std::string& name) {
+        auto it = std::find(header.begin(), header.end(), name);
+        return (it == header.end()) ? -1 : static_cast<int>(it - header.begin());
+    };
+    int iCh = column("ch"), iQ = column("charge"), iQErr = column("charge_err");
+    int iMean = column("h_mean"), iMeanErr = column("h_mean_err");
+    int iRms = column("h_rms"), iRmsErr = column("h_rms_err");
+    if (iCh < 0 || iQ < 0 || iQErr < 0 || iMean < 0 || iMeanErr < 0 || iRms < 0 || iRmsErr < 0) {
+        std::cerr << "エラー: 入力ファイルに必要な列がありません (ch,charge,charge_err,h_mean,h_mean_err,h_rms,h_rms_err): "
+                  << csvFile << std::endl;
+        return false;
+    }
+    while (std::getline(ifs, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::vector<std::string> cols = SplitCsvLine(line);
+        if (cols.size() < header.size()) continue;
+        try {
+            int ch = std::stoi(cols[iCh]);
+            if (ch < 0 || ch >= 4) continue;
+            ChannelPoints& p = points[ch];
+            p.q.push_back(std::stod(cols[iQ]));
+            p.qErr.push_back(std::stod(cols[iQErr]));
+            p.mean.push_back(std::stod(cols[iMean]));
+            p.meanErr.push_back(std::stod(cols[iMeanErr]));
+            p.rms.push_back(std::stod(cols[iRms]));
+            p.rmsErr.push_back(std::stod(cols[iRmsErr]));
+        } catch (const std::exception&) {
+            continue;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::string outputFile;
+    int nThreads = std::max(1u, std::thread::hardware_concurrency());
+    int nIter = 3;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "o:j:n:h")) != -1) {
+        switch (opt) {
+            case 'o': outputFile = optarg; break;
+            case 'j': nThreads = std::max(1, std::stoi(optarg)); break;
+            case 'n': nIter = std::max(1, std::stoi(optarg)); break;
+            case 'h':
+                PrintUsage(argv[0]);
+                return 0;
+            default:
+                PrintUsage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc) {
+        std::cerr << "エラー: 入力ファイルが指定されていません。\n" << std::endl;
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    std::string inputFile = argv[optind];
+    if (outputFile.empty()) {
+        size_t lastSlash = inputFile.find_last_of("/");
+        outputFile = (lastSlash == std::string::npos ? std::string("") : inputFile.substr(0, lastSlash + 1)) + "time_calib.txt";
+    }
+
+    ChannelPoints points[4];
+    if (!LoadSummaryCsv(inputFile, points)) return 1;
+
+    // 4 CH x 2 曲線 (0: Mean, 1: RMS) のフィットを共有カウンターで各スレッドに配る
+    TimeCurveFit fits[4][2];
+    std::atomic<int> next(0);
+    auto worker = [&]() {
+        for (int job = next++; job < 8; job = next++) {
+            int ch = job / 2;
+            const ChannelPoints& p = points[ch];
+            if (job % 2 == 0) fits[ch][0] = FitTimeCurve(p.q, p.qErr, p.mean, p.meanErr, nIter);
+            else              fits[ch][1] = FitTimeCurve(p.q, p.qErr, p.rms, p.rmsErr, nIter);
+        }
+    };
+    nThreads = std::min(nThreads, 8);
+    std::vector<std::thread> threads;
+    for (int t = 1; t < nThreads; ++t) threads.emplace_back(worker);
+    worker();
+    for (auto& t : threads) t.join();
+
+    // 較正値を組み立てる (フィットできなかった曲線は fittinginput.hh の値のまま)
+    TimeCalibration calib = TimeCalibration::Defaults();
+    std::cout << std::fixed << std::setprecision(4);
+    for (int ch = 0; ch < 4; ++ch) {
+        const TimeCurveFit& m = fits[ch][0];
+        const TimeCurveFit& s = fits[ch][1];
+        if (m.ok) {
+            calib.tCorr[ch] = m.minVal;
+            calib.tw[ch][0] = m.c[0];
+            calib.tw[ch][1] = m.c[1] - m.minVal;
+            calib.tw[ch][2] = m.c[2];
+            calib.tw[ch][3] = m.c[3];
+            // データの電荷の範囲での TW の最大値 (上限を外して評価)
+            double twMax = 0.0;
+            const int nScan = 1000;
+            for (int i = 0; i <= nScan; ++i) {
+                double q = m.qMin + (m.qMax - m.qMin) * i / nScan;
+                twMax = std::max(twMax, TimeCurve(calib.tw[ch], q));
+            }
+            calib.twMax[ch] = twMax;
+            std::cout << "CH" << ch << " Mean: " << m.nPoints << " 点, chi2/ndf = " << m.chi2 << " / " << m.ndf
+                      << ", t_corr = " << m.minVal << " +- " << m.minErr << " ns (q = " << m.atCharge << " pC)"
+                      << ", tw_max = " << twMax << " ns" << std::endl;
+        } else {
+            std::cerr << "警告: CH" << ch << " の Charge vs Mean をフィットできません (" << m.nPoints
+                      << " 点)。fittinginput.hh の値を使います" << std::endl;
+        }
+        if (s.ok) {
+            for (int k = 0; k < N_TIME_CURVE_PARAMS; ++k) calib.sigma[ch][k] = s.c[k];
+            std::cout << "CH" << ch << " RMS : " << s.nPoints << " 点, chi2/ndf = " << s.chi2 << " / " << s.ndf
+                      << ", 最小 " << s.minVal << " ns (q = " << s.atCharge << " pC)" << std::endl;
+        } else {
+            std::cerr << "警告: CH" << ch << " の Charge vs RMS をフィットできません (" << s.nPoints
+                      << " 点)。fittinginput.hh の値を使います" << std::endl;
+        }
+    }
+
+    if (!calib.Save(outputFile)) return 1;
+    std::cout << "保存しました: " << outputFile << std::endl;
+    return 0;
+}
@@ -20,18 +20,40 @@
  * これにより、中心位置(Z = 80.5 - r_pmt)がモデルごとに変化します。
  * 3. パラメータ B は常に 0 に固定されます。
  *
+ * [追加 2026-10-18]
+ * 電荷モデル Table: (距離, cos(alpha)) の参照テーブルを双線形補間で引きます (chargeTable.hh)。
+ * テーブルは補間面の偏微分を返すため、時間モデルが gaus/none のときは
+ * FCN が解析的勾配を返し、MIGRAD は数値微分を行いません (SET GRAD)。
+ *
+ * [追加 2026-10-18]
+ * TimeWalk・時間補正値・時間分解能は GetTimeCalibration() (timeCalib.hh) から引きます。
+ * 起動時に較正ファイル (make_time_calib の出力) を読めばその値、無ければ fittinginput.hh の値です。
+ *
  * @author Gemini (Modified based on user request)
  */
 
 #include "onemPMTfit.hh"
+#include "timeCalib.hh"
 #include <iostream>
 #include <cmath>
 #include <algorithm>
 #include <regex>
 #include <TMath.h> 
+#include <ctime>
 
 // グローバルポインタ
-LightSourceFitter* gFitter = nullptr;
+// 並列再構成 (parallelReco.hh) ではワーカーごとにフィッターを持つため、スレッドごとに保持する
+thread_local LightSourceFitter* gFitter = nullptr;
+// FCN呼び出し回数 (CPUコスト集計用、スレッドごと)
+thread_local long gFcnCallCount = 0;
+
+// 呼び出しスレッドの CPU 時間 (ms)
+// TStopwatch::CpuTime はプロセス全体の値なので、複数スレッドで回すと他スレッド分も含まれてしまう
+static double ThreadCpuMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec * 1e-6;
+}
 
 // =========================================================
 // ファイル名パース関数の実装
@@ -125,6 +147,8 @@ double CalcEMG_NLL(double t, double mu, double sigma, double tau) {
 // Minuit用 目的関数 (Chi2計算)
 // =========================================================
 void fcn_wrapper(int& npar, double* gin, double& f, double* par, int iflag) {
+    gFcnCallCount++;
+
     // フィッティングパラメータ
     double x = par[0];
     double y = par[1];
@@ -137,35 +161,22 @@ void fcn_wrapper(int& npar, double* gin, double& f, double* par, int iflag) {
     const auto& config = gFitter->GetConfig();
 
     // -------------------------------------------------------------
-    // 1. モデルに基づく定数・パラメータ配列の選択
+    // 1. モデルに基づく定数の選択
     // -------------------------------------------------------------
-    double r_pmt_eff = 0.0;
-    const double (*charge_c0_params)[4] = nullptr;   // 距離係数配列へのポインタ (便宜上配列として扱う)
-    const double (*ang_params)[8] = nullptr; // 角度係数配列へのポインタ
-
-    // モデルに応じた選択
-    if (config.chargeModel == ChargeModelType::FuncG) {
-        // --- FuncG ---
-        r_pmt_eff = PMT_RADIUS_G; // 23.5 cm
-        // キャストしてポインタを合わせる
-        // 本来は構造体などでまとめるべきですが、既存コードの延長でポインタ操作で対応
-        // CHARGE_RADIAL_PARAMS_FUNC_G は 1次元配列ですが、アドレスを渡してアクセスします
-        // (ここでは個別アクセスするので単に配列を指すようにします)
-        
-        // 角度パラメータ
-        ang_params = CHARGE_ANGULAR_PARAMS_FUNC_G;
-        
-    } else {
-        // --- FuncF (Default) ---
-        r_pmt_eff = PMT_RADIUS_F; // 28.5 cm
-        ang_params = CHARGE_ANGULAR_PARAMS_FUNC_F;
-    }
+    // テーブルモデルの場合はテーブル作成時の PMT半径 を使用
+    const ChargeTable* table = gFitter->GetChargeTable();
+    bool useTable = (config.chargeModel == ChargeModelType::Table && table != nullptr && table->IsValid());
+    double r_pmt_eff = useTable ? table->GetPmtRadius() : AnalyticPmtRadius(config.chargeModel);
 
     // PMT球の中心Z座標 = 表面(80.5) - 半径
     double pmt_center_z = PMT_SURFACE_Z - r_pmt_eff;
 
     double chi2_total = 0.0;
 
+    // 解析的勾配 (iflag==2 のとき。SET GRAD はテーブルモデル + gaus/none 時間の組合せのみ)
+    bool wantGrad = (iflag == 2);
+    double grad[5] = {0.0, 0.0, 0.0, 0.0, 0.0}; // x, y, z, t0, A
+
     // -------------------------------------------------------------------
     // 2. 電荷 (Charge) に関する Chi2
     // -------------------------------------------------------------------
@@ -189,57 +200,46 @@ void fcn_wrapper(int& npar, double* gin, double& f, double* par, int iflag) {
             // 角度計算 cos(alpha)
             double cos_alpha = CalculateCosAngle(vec_x, vec_y, vec_z, 
                                                  hit.dir_x, hit.dir_y, hit.dir_z);
-            
-            // 角度依存項 epsilon (モデルごとに選択された配列を使用)
-            const double* c_ang = ang_params[hit.ch];
-            double epsilon = c_ang[0] + cos_alpha * (c_ang[1] + cos_alpha * (c_ang[2] + cos_alpha * (c_ang[3] + 
-                             cos_alpha * (c_ang[4] + cos_alpha * (c_ang[5] + cos_alpha * (c_ang[6] + cos_alpha * c_ang[7]))))));
-                            
-            if (epsilon < 0) epsilon = 0.0;
-
-            double mu = 0.0;
-            double f_r = 0.0;
-
-            // --- モデル式計算 ---
-            if (config.chargeModel == ChargeModelType::FuncF) {
-                // [FuncF] r_pmt=28.5
-                // f(r) = c0 * (1 - sqrt(1 - (r_pmt/r)^2))
-                double c0 = CHARGE_RADIAL_PARAMS_FUNC_F[hit.ch];
-
-                // ルート内保護
-                if (dist_center > r_pmt_eff + 0.001) {
-                    double ratio = r_pmt_eff / dist_center;
-                    f_r = c0 * (1.0 - std::sqrt(1.0 - ratio * ratio));
-                } else {
-                    f_r = c0; 
-                }
-                
-                mu = A * f_r * epsilon;
-
-            } else if (config.chargeModel == ChargeModelType::FuncG) {
-                // [FuncG] r_pmt=23.5
-                // f(r) = c0 / r^2
-                double c0 = CHARGE_RADIAL_PARAMS_FUNC_G[hit.ch];
-                
-                // ゼロ除算防止
-                if (dist_center2 < 1.0) dist_center2 = 1.0;
-                
-                f_r = c0 / dist_center2;
-                mu = A * f_r * epsilon;
-            }
-            
-            if (mu < 1e-9) mu = 1e-9; 
+
+            // --- モデル式計算 (A=1 での応答 f(r)*epsilon) ---
+            // FuncF/FuncG は解析式、Table は双線形補間 (偏微分も同時に取得)
+            double dresp_dr = 0.0, dresp_dcos = 0.0;
+            double resp = useTable
+                ? table->Eval(hit.ch, dist_center, cos_alpha,
+                              wantGrad ? &dresp_dr : nullptr, wantGrad ? &dresp_dcos : nullptr)
+                : AnalyticChargeResponse(config.chargeModel, hit.ch, dist_center, dist_center2, cos_alpha);
+
+            double mu = A * resp;
+            bool muClamped = (mu < 1e-9);
+            if (muClamped) mu = 1e-9; 
 
             // --- Chi2 加算 ---
             double n = hit.charge;
+            double dchi2_dmu = 0.0;
             if (config.chargeType == ChargeChi2Type::BakerCousins) {
                 double term = 0.0;
                 if (n > 1e-9) term = mu - n + n * std::log(n / mu);
                 else term = mu; 
                 chi2_total += 2.0 * term;
+                dchi2_dmu = (n > 1e-9) ? 2.0 * (1.0 - n / mu) : 2.0;
             } else {
                 double sigma_q = 1.0; 
                 chi2_total += std::pow(n - mu, 2) / (sigma_q * sigma_q);
+                dchi2_dmu = -2.0 * (n - mu) / (sigma_q * sigma_q);
+            }
+
+            // --- 勾配: mu = A * T(r, cos), r = |P - S|, cos = (P - S)・d / r ---
+            if (wantGrad && !muClamped && dist_center > 0) {
+                double dmag = std::sqrt(hit.dir_x*hit.dir_x + hit.dir_y*hit.dir_y + hit.dir_z*hit.dir_z);
+                if (dmag <= 0) dmag = 1.0;
+                double d[3] = {hit.dir_x / dmag, hit.dir_y / dmag, hit.dir_z / dmag};
+                double v[3] = {vec_x, vec_y, vec_z};
+                for (int k = 0; k < 3; ++k) {
+                    double dr_dS = -v[k] / dist_center;
+                    double dcos_dS = -(d[k] - cos_alpha * v[k] / dist_center) / dist_center;
+                    grad[k] += dchi2_dmu * A * (dresp_dr * dr_dS + dresp_dcos * dcos_dS);
+                }
+                grad[4] += dchi2_dmu * resp;
             }
         }
     }
@@ -249,6 +249,7 @@ void fcn_wrapper(int& npar, double* gin, double& f, double* par, int iflag) {
     // -------------------------------------------------------------------
     if (config.timeType != TimeChi2Type::None) {
         double goodness_sum = 0.0;
+        const TimeCalibration& calib = GetTimeCalibration();
         
         for (const auto& hit : hits) {
             if (!hit.isHit) continue; 
@@ -277,14 +278,14 @@ void fcn_wrapper(int& npar, double* gin, double& f, double* par, int iflag) {
             double t_flight = dist_surface / C_LIGHT;
             
             // 期待時刻
-            double tw_val = CalcParametricValue(hit.ch, hit.charge, TW_PARAMS);
-            double t_corr_val = TIME_CORRECTION_VAL[hit.ch];
+            double tw_val = calib.TimeWalk(hit.ch, hit.charge);
+            double t_corr_val = calib.tCorr[hit.ch];
             
             double t_expected = t0 + t_flight + tw_val + t_corr_val;
             double t_obs = hit.time;
 
             // 時間分解能(Sigma)
-            double sigma_t = CalcParametricValue(hit.ch, hit.charge, SIGMA_T_PARAMS);
+            double sigma_t = calib.SigmaT(hit.ch, hit.charge);
             if (sigma_t < 0.1) sigma_t = 0.1; 
 
             // Chi2加算
@@ -300,6 +301,17 @@ void fcn_wrapper(int& npar, double* gin, double& f, double* par, int iflag) {
             } else {
                 // Gaussian
                 chi2_total += std::pow(t_obs - t_expected, 2) / (sigma_t * sigma_t);
+
+                if (wantGrad) {
+                    double dchi2_dt = -2.0 * (t_obs - t_expected) / (sigma_t * sigma_t);
+                    grad[3] += dchi2_dt;
+                    if (dist_surface > 0.1 && dist_center > 0) {
+                        double k = dchi2_dt / (dist_center * C_LIGHT);
+                        grad[0] += k * dx;
+                        grad[1] += k * dy;
+                        grad[2] += k * dz;
+                    }
+                }
             }
         }
 
@@ -310,6 +322,11 @@ void fcn_wrapper(int& npar, double* gin, double& f, double* par, int iflag) {
     }
 
     f = chi2_total;
+
+    if (wantGrad && gin != nullptr) {
+        for (int i = 0; i < 5; ++i) gin[i] = grad[i];
+        gin[5] = 0.0; // B は常に固定
+    }
 }
 
 // LightSourceFitterクラスの実装
@@ -332,16 +349,63 @@ void LightSourceFitter::SetDataFilename(const std::string& filename) {
     fDataFilename = filename;
 }
 
+void LightSourceFitter::SetChargeTable(const ChargeTable* table) {
+    fChargeTable = table;
+}
+
 bool LightSourceFitter::FitEvent(const std::vector<PMTData>& eventHits, FitResult& res) {
+    // FCN はこのスレッドで最後に FitEvent を呼んだフィッターを参照する
+    gFitter = this;
     fCurrentHits = eventHits;
+    // 前のイベントの内部状態 (共分散行列など) を持ち越さないようにパラメータ定義を消去する
+    // (並列実行時、どのワーカーがどの順でイベントを処理しても結果が同じになる)
+    fMinuit->mncler();
     InitializeParameters(eventHits);
 
     // 最小化実行
     double arglist[10];
     int ierflg = 0;
+    long fcnCallsBefore = gFcnCallCount;
+
+    // 誤差不要なら STRATEGY 0 (MIGRAD終了時の2階微分の再計算を省略)
+    arglist[0] = (fConfig.errorMode == ErrorMode::None) ? 0 : 1;
+    fMinuit->mnexcm("SET STR", arglist, 1, ierflg);
+
+    // 解析的勾配: FCN が全項の微分を返せる組合せ (Table + 時間 gaus/none) のみ
+    // (引数 1 = 数値微分との照合を省略)
+    bool analyticGrad = (fConfig.chargeModel == ChargeModelType::Table && fChargeTable != nullptr && fChargeTable->IsValid() &&
+                         (fConfig.timeType == TimeChi2Type::Gaussian || fConfig.timeType == TimeChi2Type::None));
+    if (analyticGrad) {
+        arglist[0] = 1;
+        fMinuit->mnexcm("SET GRA", arglist, 1, ierflg);
+    } else {
+        fMinuit->mnexcm("SET NOG", arglist, 0, ierflg);
+    }
+
+    double cpuStart = ThreadCpuMs();
     arglist[0] = 100000;
     arglist[1] = 0.1;
     fMinuit->mnexcm("MIGRAD", arglist, 2, ierflg);
+    double cpuMigrad = ThreadCpuMs();
+    res.cpu_minimize = cpuMigrad - cpuStart;
+
+    // 誤差計算 (HESSE / MINOS)
+    if (fConfig.errorMode == ErrorMode::Hesse || fConfig.errorMode == ErrorMode::Minos) {
+        arglist[0] = 100000;
+        fMinuit->mnexcm("HESSE", arglist, 1, ierflg);
+    }
+    if (fConfig.errorMode == ErrorMode::Minos) {
+        // 固定されていない x,y,z,t のみ (Minuitのパラメータ番号は1始まり)
+        int nargs = 1;
+        arglist[0] = 100000;
+        for (int i = 0; i < 4; ++i) {
+            if (i == 3 && fConfig.timeType == TimeChi2Type::None) continue;
+            arglist[nargs++] = i + 1;
+        }
+        fMinuit->mnexcm("MINOS", arglist, nargs, ierflg);
+    }
+    res.cpu_error = ThreadCpuMs() - cpuMigrad;
+    res.nfcn = static_cast<int>(gFcnCallCount - fcnCallsBefore);
 
     // 結果取得
     double val, err;
@@ -352,6 +416,8 @@ bool LightSourceFitter::FitEvent(const std::vector<PMTData>& eventHits, FitResul
     fMinuit->GetParameter(4, val, err); res.A = val;
     fMinuit->GetParameter(5, val, err); res.B = val;
 
+    FillErrors(res);
+
     double fmin, fedm, errdef;
     int npari, nparx, istat;
     fMinuit->mnstat(fmin, fedm, errdef, npari, nparx, istat);
@@ -381,6 +447,46 @@ bool LightSourceFitter::FitEvent(const std::vector<PMTData>& eventHits, FitResul
     // return (istat >= 1);
 }
 
+void LightSourceFitter::FillErrors(FitResult& res) {
+    for (int i = 0; i < N_COV_PARAMS; ++i) {
+        for (int j = 0; j < N_COV_PARAMS; ++j) res.cov[i][j] = 0.0;
+    }
+    for (int i = 0; i < 4; ++i) {
+        res.errp[i] = -9999;
+        res.errn[i] = -9999;
+    }
+
+    if (fConfig.errorMode == ErrorMode::None) {
+        res.err_x = res.err_y = res.err_z = res.err_t = -9999;
+        return;
+    }
+
+    // 自由パラメータの外部番号 (InitializeParametersの固定条件と対応)
+    std::vector<int> freeIndex = {0, 1, 2};
+    if (fConfig.timeType != TimeChi2Type::None) freeIndex.push_back(3);
+    if (fConfig.chargeType != ChargeChi2Type::None) freeIndex.push_back(4);
+
+    // mnemat は自由パラメータのみの行列を内部番号順 (=外部番号の昇順) で返す
+    int nFree = freeIndex.size();
+    std::vector<double> emat(nFree * nFree, 0.0);
+    fMinuit->mnemat(emat.data(), nFree);
+    for (int i = 0; i < nFree; ++i) {
+        for (int j = 0; j < nFree; ++j) {
+            res.cov[freeIndex[i]][freeIndex[j]] = emat[i * nFree + j];
+        }
+    }
+
+    if (fConfig.errorMode == ErrorMode::Minos) {
+        for (int i = 0; i < 4; ++i) {
+            if (i == 3 && fConfig.timeType == TimeChi2Type::None) continue;
+            double eplus, eminus, eparab, globcc;
+            fMinuit->mnerrs(i, eplus, eminus, eparab, globcc);
+            res.errp[i] = eplus;
+            res.errn[i] = eminus;
+        }
+    }
+}
+
 void LightSourceFitter::InitializeParameters(const std::vector<PMTData>& hits) {
     // ファイル名から初期値を取得（設定されている場合）
     FilenameParams fnParams = ParseFilename(fDataFilename);
@@ -15,6 +15,7 @@
 #define ONEMPMTFIT_HH
 
 #include "fittinginput.hh"
+#include "chargeTable.hh"
 #include <vector>
 #include <string>
 #include <TMinuit.h>
@@ -61,6 +62,13 @@ public:
      */
     void SetDataFilename(const std::string& filename);
 
+    /**
+     * @brief 電荷モデル Table で使う参照テーブルを設定する (所有はしない)
+     * Table モデルかつ時間モデルが gaus/none の場合は解析的勾配 (SET GRAD) を使用します。
+     * @param table 読み込み済みのテーブル (nullptr の場合は Table モデルを使えない)
+     */
+    void SetChargeTable(const ChargeTable* table);
+
     /**
      * @brief 1イベント分のフィッティングを実行する
      *
@@ -74,12 +82,14 @@ public:
     // 静的FCN関数からデータへアクセスするためのゲッター
     const std::vector<PMTData>& GetData() const { return fCurrentHits; }
     const FitConfig& GetConfig() const { return fConfig; }
+    const ChargeTable* GetChargeTable() const { return fChargeTable; }
 
 private:
     TMinuit* fMinuit;
     std::vector<PMTData> fCurrentHits;
     FitConfig fConfig;
     std::string fDataFilename; // ファイル名から初期値を取得するために使用 
+    const ChargeTable* fChargeTable = nullptr; // Table モデル用 (所有しない)
 
     /**
      * @brief パラメータの初期値と範囲を設定する
@@ -87,6 +97,12 @@ private:
      * 設定に応じてパラメータBを固定(Fix)するか決定します。
      */
     void InitializeParameters(const std::vector<PMTData>& hits);
+
+    /**
+     * @brief 誤差モードに応じて共分散行列・MINOS誤差を結果に詰める
+     * ErrorMode::None の場合は誤差を -9999 にします。
+     */
+    void FillErrors(FitResult& res);
 };
 
 // Minuitが最小化のために呼び出す関数 (グローバルスコープ)
@@ -0,0 +1,53 @@
+/*
+ * id: parallelReco.cc
+ * Place: /home/daiki/keio/hkelec/reconst/reco/
+ * Author: Gemini (Modified based on user request)
+ * Last Edit: 2026-10-18
+ *
+ * 概要:
+ * ParallelReconstructor の実装
+ * TMinuit の生成は gROOT のリスト操作を伴うため、フィッターは全てコンストラクタ
+ * (呼び出しスレッド) で作り、ワーカースレッドでは FitEvent だけを呼びます。
+ */
+
+#include "parallelReco.hh"
+#include <algorithm>
+
+ParallelReconstructor::ParallelReconstructor(const FitConfig& config, int nThreads, const ChargeTable* table,
+                                             const std::string& dataFilename, int chunkSize)
+    : fScheduler(nThreads), fChunkSize(std::max(chunkSize, 1)), fNSteals(0) {
+    int nWorkers = fScheduler.GetNWorkers();
+    for (int w = 0; w < nWorkers; ++w) {
+        auto fitter = std::make_unique<LightSourceFitter>();
+        fitter->SetConfig(config);
+        fitter->SetChargeTable(table);
+        fitter->SetDataFilename(dataFilename);
+        fFitters.push_back(std::move(fitter));
+    }
+    fStats.resize(nWorkers);
+}
+
+void ParallelReconstructor::ResetStats() {
+    for (auto& s : fStats) s = WorkerStats();
+    fNSteals = 0;
+}
+
+void ParallelReconstructor::FitBlock(const std::vector<std::vector<PMTData>>& events, size_t nEvents,
+                                     std::vector<FitResult>& results, std::vector<char>& converged,
+                                     bool allowSteal) {
+    if (results.size() < nEvents) results.resize(nEvents);
+    if (converged.size() < nEvents) converged.resize(nEvents);
+
+    int nChunks = static_cast<int>((nEvents + fChunkSize - 1) / fChunkSize);
+    fNSteals += fScheduler.Run(nChunks, [&](int w, int chunk) {
+        size_t begin = static_cast<size_t>(chunk) * fChunkSize;
+        size_t end = std::min(begin + fChunkSize, nEvents);
+        WorkerStats& stats = fStats[w];
+        for (size_t i = begin; i < end; ++i) {
+            converged[i] = fFitters[w]->FitEvent(events[i], results[i]) ? 1 : 0;
+            stats.cpuMs += results[i].cpu_minimize + results[i].cpu_error;
+            stats.nEvents++;
+        }
+        stats.nChunks++;
+    }, allowSteal);
+}
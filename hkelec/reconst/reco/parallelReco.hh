@@ -0,0 +1,67 @@
+/*
+ * id: parallelReco.hh
+ * Place: /home/daiki/keio/hkelec/reconst/reco/
+ * Author: Gemini (Modified based on user request)
+ * Last Edit: 2026-10-18
+ *
+ * 概要:
+ * 複数スレッドでイベントをフィットする ParallelReconstructor の定義
+ * イベントのブロックを小さなチャンクに分け、WorkStealingScheduler で各ワーカーに配ります。
+ * フィッター (TMinuit を含む) と統計用バッファはワーカーごとに1つ作って使い回します。
+ * 結果は入力順のスロットに書き込むため、出力順はスレッド数によらず同じです。
+ */
+
+#ifndef PARALLEL_RECO_HH
+#define PARALLEL_RECO_HH
+
+#include "fittinginput.hh"
+#include "onemPMTfit.hh"
+#include "workStealing.hh"
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief ワーカーごとの集計 (ロードバランス確認用)
+ */
+struct WorkerStats {
+    long nEvents = 0;   // 処理したイベント数
+    long nChunks = 0;   // 処理したチャンク数
+    double cpuMs = 0.0; // フィットに使った CPU 時間 (ms)
+};
+
+class ParallelReconstructor {
+public:
+    /**
+     * @param config フィット設定 (全ワーカー共通)
+     * @param nThreads ワーカー数 (1 なら呼び出しスレッドのみで逐次実行)
+     * @param table -m table 用の電荷テーブル (読み取り専用で全ワーカーが共有)
+     * @param dataFilename 初期値推定に使う入力ファイル名
+     * @param chunkSize 1チャンクのイベント数 (小さいほど負荷が均等になる)
+     */
+    ParallelReconstructor(const FitConfig& config, int nThreads, const ChargeTable* table,
+                          const std::string& dataFilename, int chunkSize = 8);
+
+    /**
+     * @brief events[0..nEvents) をフィットし、results/converged の同じ添字に格納する
+     * results, converged は nEvents 以上に自動で拡張します (ブロック間で使い回してください)。
+     * @param allowSteal false で固定範囲分割 (ベンチマーク比較用)
+     */
+    void FitBlock(const std::vector<std::vector<PMTData>>& events, size_t nEvents,
+                  std::vector<FitResult>& results, std::vector<char>& converged,
+                  bool allowSteal = true);
+
+    int GetNThreads() const { return fScheduler.GetNWorkers(); }
+    long GetNSteals() const { return fNSteals; }
+    const std::vector<WorkerStats>& GetWorkerStats() const { return fStats; }
+    void ResetStats();
+
+private:
+    std::vector<std::unique_ptr<LightSourceFitter>> fFitters; // ワーカーごと
+    std::vector<WorkerStats> fStats;                          // ワーカーごと
+    WorkStealingScheduler fScheduler;
+    int fChunkSize;
+    long fNSteals;
+};
+
+#endif // PARALLEL_RECO_HH
@@ -14,9 +14,12 @@
  * - ペデスタルファイル読み込み (CSV形式)
  * - ADC → pC 変換 (High Gain 飽和検出、Low Gain 使用切替)
  * - イベント単位でのヒットデータグルーピング
+ * - processed_events (イベント単位レイアウト) の直接読み込み (グルーピング不要)
+ * - double 以外の列の型 (eventtree2hist --precision compact/float/float16) の読み込み
  */
 
 #include "readData.hh"
+#include <algorithm>
 
 // ADC -> pC 変換係数
 const double K_HGAIN = 0.073; 
@@ -50,8 +53,8 @@ int readPedestals(const std::string &filename, std::map<int, PedestalData> &pede
 }
 
 // コンストラクタ
-DataReader::DataReader(const std::string &filename, const std::map<int, PedestalData> &pedMap) 
-    : pedestalMap(pedMap), currentEntry(0), hasBufferedHit(false) {
+DataReader::DataReader(const std::string &filename, const std::map<int, PedestalData> &pedMap, bool useEventLayout)
+    : eventLayout(false), pedestalMap(pedMap), currentEntry(0), hasBufferedHit(false) {
     
     file = TFile::Open(filename.c_str());
     if (!file || file->IsZombie()) {
@@ -61,19 +64,36 @@ DataReader::DataReader(const std::string &filename, const std::map<int, Pedestal
         return;
     }
 
+    // イベント単位レイアウトがあれば優先して使う (eventtree2hist --layout event/both)
+    tree = useEventLayout ? dynamic_cast<TTree*>(file->Get("processed_events")) : nullptr;
+    if (tree) {
+        eventLayout = true;
+        tree->SetBranchAddress("eventID", &b_eventID);
+        tree->SetBranchAddress("nhits", &e_nhits);
+        tree->SetBranchAddress("hit_mask", &e_hitMask);
+        bindColumn("ch", e_ch, true);
+        bindColumn("hgain", e_hgain, true);
+        bindColumn("lgain", e_lgain, true);
+        bindColumn("tot", e_tot, true);
+        bindColumn("time_diff", e_time_diff, true);
+        nEntries = tree->GetEntries();
+        std::cout << "Reading 'processed_events' (event layout): " << nEntries << " events" << std::endl;
+        return;
+    }
+
     tree = dynamic_cast<TTree*>(file->Get("processed_hits"));
     if (!tree) {
-        std::cerr << "Error: Cannot find 'processed_hits' tree" << std::endl;
+        std::cerr << "Error: Cannot find 'processed_events' or 'processed_hits' tree" << std::endl;
         nEntries = 0;
         return;
     }
 
     tree->SetBranchAddress("eventID", &b_eventID);
-    tree->SetBranchAddress("ch", &b_ch);
-    tree->SetBranchAddress("hgain", &b_hgain);
-    tree->SetBranchAddress("lgain", &b_lgain);
-    tree->SetBranchAddress("tot", &b_tot);
-    tree->SetBranchAddress("time_diff", &b_time_diff);
+    bindColumn("ch", &b_ch, false);
+    bindColumn("hgain", &b_hgain, false);
+    bindColumn("lgain", &b_lgain, false);
+    bindColumn("tot", &b_tot, false);
+    bindColumn("time_diff", &b_time_diff, false);
 
     nEntries = tree->GetEntries();
 }
@@ -82,18 +102,42 @@ DataReader::~DataReader() {
     if (file) file->Close();
 }
 
+// 列の型が変数と同じなら直接読み込み、違えば GetEntry 後の変換に回す
+void DataReader::bindColumn(const char *name, double *dst, bool isArray) {
+    TLeaf *leaf = tree->GetLeaf(name);
+    if (leaf && std::string(leaf->GetTypeName()) != "Double_t") {
+        convertedColumns.push_back({leaf, dst, nullptr, isArray});
+        return;
+    }
+    tree->SetBranchAddress(name, dst);
+}
+
+void DataReader::bindColumn(const char *name, int *dst, bool isArray) {
+    TLeaf *leaf = tree->GetLeaf(name);
+    if (leaf && std::string(leaf->GetTypeName()) != "Int_t") {
+        convertedColumns.push_back({leaf, nullptr, dst, isArray});
+        return;
+    }
+    tree->SetBranchAddress(name, dst);
+}
+
+void DataReader::readEntry(long entry) {
+    tree->GetEntry(entry);
+    for (const auto &c : convertedColumns) {
+        int n = c.isArray ? std::min(e_nhits, MAX_HITS_PER_EVENT) : 1;
+        for (int i = 0; i < n; ++i) {
+            if (c.dstD) c.dstD[i] = c.leaf->GetValue(i);
+            else c.dstI[i] = static_cast<int>(c.leaf->GetValue(i));
+        }
+    }
+}
+
 // データ変換ロジック
 PMTData DataReader::createPMTData() {
     PMTData data;
     data.eventID = b_eventID;
     data.ch = b_ch;
     data.time = b_time_diff;
-    if (data.charge <= 0) {
-        data.charge = 0;
-        data.isHit = false; // 電荷がなければHitとみなさない
-    } else {
-        data.isHit = true;
-    }
 
     // ペデスタル取得
     double ped_h = 0, ped_l = 0;
@@ -109,7 +153,14 @@ PMTData DataReader::createPMTData() {
     } else {
         data.charge = (b_hgain - ped_h) * K_HGAIN;
     }
-    if (data.charge < 0) data.charge = 0;
+    // 電荷がなければHitとみなさない
+    // (電荷計算の後で判定する。計算前の未初期化値で判定しないこと)
+    if (data.charge <= 0) {
+        data.charge = 0;
+        data.isHit = false;
+    } else {
+        data.isHit = true;
+    }
 
     // 座標セット
     if (b_ch >= 0 && b_ch < 4) {
@@ -127,10 +178,67 @@ PMTData DataReader::createPMTData() {
     return data;
 }
 
+// ヒットの無いチャンネルに空データ(Unhit)を追加
+void DataReader::addUnhitChannels(std::vector<PMTData> &eventHits, const bool hasHit[4]) {
+    int currentID = eventHits[0].eventID;
+    for (int ch = 0; ch < 4; ++ch) {
+        if (!hasHit[ch]) {
+            PMTData unhitData;
+            unhitData.eventID = currentID;
+            unhitData.ch = ch;
+            unhitData.time = 0.0;     // 時間は無意味なので0
+            unhitData.charge = 0.0;   // 電荷0 (Unhitの証)
+            unhitData.isHit = false;  // フラグもfalseに
+
+            // 座標情報のセット (PMT_POSITIONS等はreadData.hhにある前提)
+            unhitData.x = PMT_POSITIONS[ch][0];
+            unhitData.y = PMT_POSITIONS[ch][1];
+            unhitData.z = PMT_POSITIONS[ch][2];
+            unhitData.dir_x = PMT_DIR[0];
+            unhitData.dir_y = PMT_DIR[1];
+            unhitData.dir_z = PMT_DIR[2];
+
+            eventHits.push_back(unhitData);
+        }
+    }
+}
+
+// processed_events からの読み出し (1エントリー = 1イベントなので先読みは不要)
+// processed_hits 版と同じヒットの並びを返す: CH 0-3 のヒットが1つも無いイベントは読み飛ばし、
+// 未ヒット CH の空データは processed_hits 版と同じくファイルの最後のエントリーのイベントにだけ追加する
+// (processed_hits 版は次のイベントを先読みした時点で返すので、最後のイベント以外には追加しない)
+bool DataReader::nextEventFromEventLayout(std::vector<PMTData> &eventHits) {
+    while (currentEntry < nEntries) {
+        readEntry(currentEntry);
+        currentEntry++;
+
+        int n = std::min(e_nhits, MAX_HITS_PER_EVENT);
+        for (int i = 0; i < n; ++i) {
+            b_ch = e_ch[i];
+            if (b_ch < 0 || b_ch >= 4) continue; // 有効なチャンネル(0-3)のみ追加
+            b_hgain = e_hgain[i];
+            b_lgain = e_lgain[i];
+            b_tot = e_tot[i];
+            b_time_diff = e_time_diff[i];
+            eventHits.push_back(createPMTData());
+        }
+        if (eventHits.empty()) continue;
+
+        if (currentEntry == nEntries) {
+            bool hasHit[4] = {false, false, false, false};
+            for (const auto &hit : eventHits) hasHit[hit.ch] = true;
+            addUnhitChannels(eventHits, hasHit);
+        }
+        return true;
+    }
+    return false;
+}
+
 // 次のイベント読み出し
 bool DataReader::nextEvent(std::vector<PMTData> &eventHits) {
     eventHits.clear();
     if (!tree) return false;
+    if (eventLayout) return nextEventFromEventLayout(eventHits);
 
     // バッファ分を処理
     if (hasBufferedHit) {
@@ -152,7 +260,7 @@ bool DataReader::nextEvent(std::vector<PMTData> &eventHits) {
     if (!eventHits.empty()) currentEventID = eventHits[0].eventID;
 
     while (currentEntry < nEntries) {
-        tree->GetEntry(currentEntry);
+        readEntry(currentEntry);
         currentEntry++;
 
         // まだヒットリストが空なら、現在のIDをイベントIDとする
@@ -180,8 +288,6 @@ bool DataReader::nextEvent(std::vector<PMTData> &eventHits) {
     
     // イベントIDが確定し、ヒットデータの収集が終わった段階でチェック
     if (!eventHits.empty()) {
-        int currentID = eventHits[0].eventID;
-
         // 1. どのチャンネルがHitしたかを記録するフラグを用意
         bool hasHit[4] = {false, false, false, false};
         for (const auto& hit : eventHits) {
@@ -191,26 +297,7 @@ bool DataReader::nextEvent(std::vector<PMTData> &eventHits) {
         }
 
         // 2. Hitしていないチャンネルについて、空データ(Unhit)を作成して追加
-        for (int ch = 0; ch < 4; ++ch) {
-            if (!hasHit[ch]) {
-                PMTData unhitData;
-                unhitData.eventID = currentID;
-                unhitData.ch = ch;
-                unhitData.time = 0.0;     // 時間は無意味なので0
-                unhitData.charge = 0.0;   // 電荷0 (Unhitの証)
-                unhitData.isHit = false;  // フラグもfalseに
-                
-                // 座標情報のセット (PMT_POSITIONS等はreadData.hhにある前提)
-                unhitData.x = PMT_POSITIONS[ch][0];
-                unhitData.y = PMT_POSITIONS[ch][1];
-                unhitData.z = PMT_POSITIONS[ch][2];
-                unhitData.dir_x = PMT_DIR[0];
-                unhitData.dir_y = PMT_DIR[1];
-                unhitData.dir_z = PMT_DIR[2];
-
-                eventHits.push_back(unhitData);
-            }
-        }
+        addUnhitChannels(eventHits, hasHit);
     }
     
     // --- ここまで追加 ---
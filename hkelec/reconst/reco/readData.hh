@@ -8,6 +8,9 @@
  * データ読み込み機能のヘッダーファイル
  * DataReader クラスとペデスタル読み込み関数の宣言を含みます。
  * イベント単位での逐次的なデータアクセスを提供します。
+ * 入力は processed_events (1エントリー = 1イベント) があればそれを、
+ * なければ従来の processed_hits (1エントリー = 1ヒット) を読みます。
+ * 列の型は double 以外 (eventtree2hist --precision compact/float/float16) でも読めます。
  */
 
 #ifndef READ_DATA_HH
@@ -22,6 +25,10 @@
 #include <sstream>
 #include <TFile.h> // ROOTファイルの操作用
 #include <TTree.h> // TTreeの操作用
+#include <TLeaf.h> // 型の異なる列の読み出し用
+
+// processed_events の1エントリーあたりの最大ヒット数 (eventtree2hist.C の MAX_HITS_PER_EVENT と同じ値)
+const int MAX_HITS_PER_EVENT = 64;
 
 // ペデスタル情報をテキストファイルから読み込み、マップに格納する関数
 int readPedestals(const std::string &filename, std::map<int, PedestalData> &pedestalMap);
@@ -30,7 +37,8 @@ int readPedestals(const std::string &filename, std::map<int, PedestalData> &pede
 class DataReader {
 public:
     // コンストラクタ: ファイル名とペデスタルマップを受け取って初期化
-    DataReader(const std::string &filename, const std::map<int, PedestalData> &pedMap);
+    // useEventLayout = false の時は processed_events があっても processed_hits を読む (check_layouts で比較する時)
+    DataReader(const std::string &filename, const std::map<int, PedestalData> &pedMap, bool useEventLayout = true);
     // デストラクタ: ファイルを閉じるなどの後処理
     ~DataReader();
 
@@ -42,10 +50,13 @@ public:
     long getTotalEntries() const { return nEntries; }
     // 現在の読み込み位置を返す関数
     long getCurrentEntry() const { return currentEntry; }
+    // イベント単位レイアウト (processed_events) を読んでいるか
+    bool isEventLayout() const { return eventLayout; }
 
 private:
     TFile *file; // ROOTファイルポインタ
     TTree *tree; // TTreeポインタ
+    bool eventLayout; // true: processed_events, false: processed_hits
     long nEntries; // TTreeの総エントリー数
     long currentEntry; // 現在読んでいるエントリー番号
     
@@ -57,6 +68,15 @@ private:
     double b_tot;
     double b_time_diff; // ns単位
 
+    // processed_events 用のブランチ変数 (1イベント分のヒット配列)
+    int e_nhits;
+    int e_hitMask; // bit i が立っていれば CH i にヒットあり
+    int e_ch[MAX_HITS_PER_EVENT];
+    double e_hgain[MAX_HITS_PER_EVENT];
+    double e_lgain[MAX_HITS_PER_EVENT];
+    double e_tot[MAX_HITS_PER_EVENT];
+    double e_time_diff[MAX_HITS_PER_EVENT]; // ns単位
+
     // ペデスタルマップへの参照 (コピーせず参照を持つ)
     const std::map<int, PedestalData> &pedestalMap;
 
@@ -69,8 +89,28 @@ private:
     double buf_tot;
     double buf_time_diff;
 
+    // double/int 以外の型で保存された列 (eventtree2hist --precision compact 等)
+    // SetBranchAddress では型が合わないので、GetEntry の後に TLeaf::GetValue で変換してブランチ変数に書き込む
+    struct ConvertedColumn {
+        TLeaf *leaf;
+        double *dstD; // 書き込み先 (double の変数なら dstD, int の変数なら dstI)
+        int *dstI;
+        bool isArray; // true: processed_events の可変長配列 (要素数 e_nhits)
+    };
+    std::vector<ConvertedColumn> convertedColumns;
+
+    // ブランチ name を変数に結び付ける (型が同じなら SetBranchAddress, 違えば convertedColumns に登録)
+    void bindColumn(const char *name, double *dst, bool isArray);
+    void bindColumn(const char *name, int *dst, bool isArray);
+    // entry を読み、型の異なる列を変換する
+    void readEntry(long entry);
+
     // 現在のブランチ変数の値からPMTData構造体を作成する内部関数
     PMTData createPMTData();
+    // processed_events から次のイベントを読む内部関数
+    bool nextEventFromEventLayout(std::vector<PMTData> &eventHits);
+    // ヒットの無いチャンネル (0-3) に空データ(Unhit)を追加する内部関数
+    void addUnhitChannels(std::vector<PMTData> &eventHits, const bool hasHit[4]);
 };
 
 #endif // READ_DATA_HH
\ No newline at end of file
@@ -26,10 +26,12 @@
 #                     -u <0/1>        : 0=4本必須(default), 1=3本許容(Unhit補完)
 #                     -m <model>      : func_f=半径28.5cmモデル(default)
 #                                      func_g=半径23.5cmモデル(1/r^2)
+#                                      table=参照テーブル (-T <file> で指定)
 #                     -q <model>      : gaus=ガウス(default), bc=Baker-Cousins
 #                                      none=電荷情報を使用しない (時間のみでフィット)
 #                     -t <model>      : gaus=ガウス(default), emg=EMG, goodness=SK Goodness
 #                                      none=時間情報を使用しない (電荷のみでフィット)
+#                     -j <N>          : フィットのスレッド数 (0=全コア)
 #
 # 前提条件:
 # 1. 指定ディレクトリに 'hkelec_pedestal_hithist_means.txt' が存在すること
@@ -55,10 +57,14 @@ usage() {
     echo "   -m <model>      : func_f=半径28.5cmモデル(default)"
     echo "                     func_g=半径23.5cmモデル(1/r^2)"
     echo "                     all=func_f と func_g の両方で解析"
+    echo "                     table=(距離,cos)参照テーブルを補間 (-T <file>、make_charge_table で作成)"
     echo "   -q <model>      : gaus=ガウス(default), bc=Baker-Cousins"
     echo "                     none=電荷情報を使用しない (時間のみでフィット)"
     echo "   -t <model>      : gaus=ガウス(default), emg=EMG, goodness=SK Goodness"
     echo "                     none=時間情報を使用しない (電荷のみでフィット)"
+    echo "   -e <mode>       : migrad=MIGRAD近似誤差(default), none=誤差なし(最速)"
+    echo "                     hesse=HESSE共分散, minos=HESSE+MINOS非対称誤差(最も高コスト)"
+    echo "   -j <N>          : フィットのスレッド数 (default 1, 0=全コア)"
     echo ""
     echo " [実行例]"
     echo " 1. デフォルト設定 (4本, FuncF, Gaussian):"
@@ -73,6 +79,13 @@ usage() {
     echo " 4. 時間情報のみを使ってフィット (電荷不使用):"
     echo "    $0 ./data -q none"
     echo ""
+    echo " 5. 大量データは誤差なしで高速に、較正用サブセットはMINOSで:"
+    echo "    $0 ./bulk -e none"
+    echo "    $0 ./calib -e minos"
+    echo ""
+    echo " 6. 較正データセットから作成した電荷テーブルで解析:"
+    echo "    $0 ./data -m table -T \$(pwd)/charge_table_data.txt"
+    echo ""
     echo " [前提条件]"
     echo " 1. ディレクトリ内に 'hkelec_pedestal_hithist_means.txt' が存在すること。"
     echo " 2. このスクリプトと同じディレクトリに実行ファイル 'reconstructor' が存在すること。"
@@ -0,0 +1,245 @@
+/*
+ * id: timeCalib.cc
+ * Place: /home/daiki/keio/hkelec/reconst/reco/
+ * Author: Gemini (Modified based on user request)
+ * Last Edit: 2026-10-18
+ *
+ * 概要:
+ * 時間較正 (TimeCalibration) の実装
+ * 較正ファイルの入出力、再構成で使う較正の保持、曲線の重み付き最小二乗フィットを行います。
+ */
+
+#include "timeCalib.hh"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+
+// =========================================================
+// 再構成で使う較正 (既定値は fittinginput.hh)
+// =========================================================
+static TimeCalibration gTimeCalibration = TimeCalibration::Defaults();
+
+const TimeCalibration& GetTimeCalibration() { return gTimeCalibration; }
+void SetTimeCalibration(const TimeCalibration& calib) { gTimeCalibration = calib; }
+
+// =========================================================
+// TimeCalibration
+// =========================================================
+TimeCalibration TimeCalibration::Defaults() {
+    TimeCalibration c;
+    for (int ch = 0; ch < 4; ++ch) {
+        c.tCorr[ch] = TIME_CORRECTION_VAL[ch];
+        c.twMax[ch] = TW_MAX_VALUES[ch];
+        for (int k = 0; k < N_TIME_CURVE_PARAMS; ++k) {
+            c.tw[ch][k] = TW_PARAMS[ch][k];
+            c.sigma[ch][k] = SIGMA_T_PARAMS[ch][k];
+        }
+    }
+    return c;
+}
+
+bool TimeCalibration::Load(const std::string& filename) {
+    std::ifstream ifs(filename);
+    if (!ifs.is_open()) {
+        std::cerr << "エラー: 時間較正ファイルを開けません: " << filename << std::endl;
+        return false;
+    }
+
+    // 読めた CH だけ置き換え、4 CH 揃っていなければエラー
+    TimeCalibration c = *this;
+    bool seen[4] = {false, false, false, false};
+    std::string line;
+    while (std::getline(ifs, line)) {
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line = line.substr(0, hash);
+        std::stringstream ss(line);
+        std::vector<double> v;
+        double x;
+        while (ss >> x) v.push_back(x);
+        if (v.empty()) continue;
+        if (v.size() != 11 || v[0] < 0 || v[0] >= 4) {
+            std::cerr << "エラー: 時間較正ファイルの行が不正です: " << filename << std::endl;
+            return false;
+        }
+        int ch = static_cast<int>(v[0]);
+        c.tCorr[ch] = v[1];
+        for (int k = 0; k < N_TIME_CURVE_PARAMS; ++k) c.tw[ch][k] = v[2 + k];
+        c.twMax[ch] = v[6];
+        for (int k = 0; k < N_TIME_CURVE_PARAMS; ++k) c.sigma[ch][k] = v[7 + k];
+        seen[ch] = true;
+    }
+    for (int ch = 0; ch < 4; ++ch) {
+        if (!seen[ch]) {
+            std::cerr << "エラー: 時間較正ファイルに CH" << ch << " がありません: " << filename << std::endl;
+            return false;
+        }
+    }
+    *this = c;
+    return true;
+}
+
+bool TimeCalibration::Save(const std::string& filename) const {
+    std::ofstream ofs(filename);
+    if (!ofs.is_open()) {
+        std::cerr << "エラー: 時間較正ファイルを書き込めません: " << filename << std::endl;
+        return false;
+    }
+    ofs << "# time calibration for reconstructor (make_time_calib)\n";
+    ofs << "# f(q) = c0*q^{-1/2} + c1 + c2*q + c3*q^2, TW(q) = min(f_tw(q), tw_max)\n";
+    ofs << "# ch t_corr tw_c0 tw_c1 tw_c2 tw_c3 tw_max sigma_c0 sigma_c1 sigma_c2 sigma_c3\n";
+    ofs.precision(10);
+    for (int ch = 0; ch < 4; ++ch) {
+        ofs << ch << " " << tCorr[ch];
+        for (int k = 0; k < N_TIME_CURVE_PARAMS; ++k) ofs << " " << tw[ch][k];
+        ofs << " " << twMax[ch];
+        for (int k = 0; k < N_TIME_CURVE_PARAMS; ++k) ofs << " " << sigma[ch][k];
+        ofs << "\n";
+    }
+    return true;
+}
+
+// =========================================================
+// 重み付き最小二乗
+// =========================================================
+// 基底関数 (q^{-1/2}, 1, q, q^2) と f'(q)
+static void TimeCurveBasis(double q, double b[N_TIME_CURVE_PARAMS]) {
+    b[0] = 1.0 / std::sqrt(q);
+    b[1] = 1.0;
+    b[2] = q;
+    b[3] = q * q;
+}
+static double TimeCurveDerivative(const double c[N_TIME_CURVE_PARAMS], double q) {
+    return -0.5 * c[0] / (q * std::sqrt(q)) + c[2] + 2.0 * c[3] * q;
+}
+
+// 対称正定値行列 A (n x n) の逆行列をコレスキー分解で求める (正定値でなければ false)
+static bool InvertSymmetric(const double A[N_TIME_CURVE_PARAMS][N_TIME_CURVE_PARAMS],
+                            double inv[N_TIME_CURVE_PARAMS][N_TIME_CURVE_PARAMS]) {
+    const int n = N_TIME_CURVE_PARAMS;
+    // 列のスケールを揃える (q^{-1/2} と q^2 で大きさが桁違いになるため)
+    double s[n];
+    for (int i = 0; i < n; ++i) {
+        if (!(A[i][i] > 0)) return false;
+        s[i] = 1.0 / std::sqrt(A[i][i]);
+    }
+    double L[n][n] = {};
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j <= i; ++j) {
+            double sum = A[i][j] * s[i] * s[j];
+            for (int k = 0; k < j; ++k) sum -= L[i][k] * L[j][k];
+            if (i == j) {
+                if (sum <= 1e-14) return false;
+                L[i][i] = std::sqrt(sum);
+            } else {
+                L[i][j] = sum / L[j][j];
+            }
+        }
+    }
+    // L^{-1}
+    double Li[n][n] = {};
+    for (int i = 0; i < n; ++i) {
+        Li[i][i] = 1.0 / L[i][i];
+        for (int j = 0; j < i; ++j) {
+            double sum = 0.0;
+            for (int k = j; k < i; ++k) sum -= L[i][k] * Li[k][j];
+            Li[i][j] = sum / L[i][i];
+        }
+    }
+    // A^{-1} = S (L^{-T} L^{-1}) S
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            double sum = 0.0;
+            for (int k = std::max(i, j); k < n; ++k) sum += Li[k][i] * Li[k][j];
+            inv[i][j] = sum * s[i] * s[j];
+        }
+    }
+    return true;
+}
+
+TimeCurveFit FitTimeCurve(const std::vector<double>& q, const std::vector<double>& qErr,
+                          const std::vector<double>& y, const std::vector<double>& yErr, int nIter) {
+    const int n = N_TIME_CURVE_PARAMS;
+    TimeCurveFit fit;
+
+    // 使う点 (q > 0, y_err > 0)
+    std::vector<size_t> use;
+    for (size_t i = 0; i < q.size(); ++i) {
+        if (q[i] > 0 && yErr[i] > 0 && std::isfinite(y[i])) use.push_back(i);
+    }
+    fit.nPoints = static_cast<int>(use.size());
+    if (fit.nPoints <= n) return fit;
+    fit.qMin = q[use[0]];
+    fit.qMax = q[use[0]];
+    for (size_t i : use) {
+        fit.qMin = std::min(fit.qMin, q[i]);
+        fit.qMax = std::max(fit.qMax, q[i]);
+    }
+
+    for (int iter = 0; iter < std::max(nIter, 1); ++iter) {
+        double A[n][n] = {};
+        double rhs[n] = {};
+        double b[n];
+        for (size_t i : use) {
+            double var = yErr[i] * yErr[i];
+            if (iter > 0) {
+                double d = TimeCurveDerivative(fit.c, q[i]) * qErr[i];
+                var += d * d;
+            }
+            double w = 1.0 / var;
+            TimeCurveBasis(q[i], b);
+            for (int r = 0; r < n; ++r) {
+                rhs[r] += w * b[r] * y[i];
+                for (int c = 0; c <= r; ++c) A[r][c] += w * b[r] * b[c];
+            }
+        }
+        for (int r = 0; r < n; ++r) {
+            for (int c = r + 1; c < n; ++c) A[r][c] = A[c][r];
+        }
+        if (!InvertSymmetric(A, fit.cov)) return TimeCurveFit{false, fit.nPoints};
+        for (int r = 0; r < n; ++r) {
+            fit.c[r] = 0.0;
+            for (int c = 0; c < n; ++c) fit.c[r] += fit.cov[r][c] * rhs[c];
+        }
+    }
+
+    // chi2 (最後の重みで)
+    fit.chi2 = 0.0;
+    for (size_t i : use) {
+        double d = TimeCurveDerivative(fit.c, q[i]) * qErr[i];
+        double r = y[i] - TimeCurve(fit.c, q[i]);
+        fit.chi2 += r * r / (yErr[i] * yErr[i] + d * d);
+    }
+    fit.ndf = fit.nPoints - n;
+    for (int k = 0; k < n; ++k) fit.cErr[k] = std::sqrt(std::max(fit.cov[k][k], 0.0));
+
+    // 最小値: 格子で探してから黄金分割で詰める (範囲は plot_summary と同じ [1e-6, 1.1 qMax])
+    double lo = 1e-6, hi = 1.1 * fit.qMax;
+    const int nScan = 2000;
+    int best = 0;
+    double bestVal = TimeCurve(fit.c, lo);
+    for (int i = 1; i <= nScan; ++i) {
+        double v = TimeCurve(fit.c, lo + (hi - lo) * i / nScan);
+        if (v < bestVal) { bestVal = v; best = i; }
+    }
+    double a = lo + (hi - lo) * std::max(best - 1, 0) / nScan;
+    double bb = lo + (hi - lo) * std::min(best + 1, nScan) / nScan;
+    const double gr = 0.5 * (std::sqrt(5.0) - 1.0);
+    for (int it = 0; it < 100 && bb - a > 1e-9 * (1.0 + std::fabs(bb)); ++it) {
+        double x1 = bb - gr * (bb - a), x2 = a + gr * (bb - a);
+        if (TimeCurve(fit.c, x1) < TimeCurve(fit.c, x2)) bb = x2; else a = x1;
+    }
+    fit.atCharge = 0.5 * (a + bb);
+    fit.minVal = TimeCurve(fit.c, fit.atCharge);
+    // 包絡線定理: d(最小値)/dc_k = 基底関数 (最小値の位置)
+    double g[n];
+    TimeCurveBasis(std::max(fit.atCharge, 1e-3), g);
+    double var = 0.0;
+    for (int r = 0; r < n; ++r) {
+        for (int c = 0; c < n; ++c) var += g[r] * g[c] * fit.cov[r][c];
+    }
+    fit.minErr = (var > 0) ? std::sqrt(var) : 0.0;
+    fit.ok = true;
+    return fit;
+}
@@ -0,0 +1,102 @@
+/*
+ * id: timeCalib.hh
+ * Place: /home/daiki/keio/hkelec/reconst/reco/
+ * Author: Gemini (Modified based on user request)
+ * Last Edit: 2026-10-18
+ *
+ * 概要:
+ * 時間較正 (TimeWalk, 時間補正値, 時間分解能) の定義
+ * 以前は plot_summary のフィット結果を fittinginput.hh の TIME_CORRECTION_VAL / TW_PARAMS /
+ * TW_MAX_VALUES / SIGMA_T_PARAMS に手で写していましたが、make_time_calib で作った較正ファイルを
+ * reconstructor が起動時に読み込みます (fittinginput.hh の値は較正ファイルが無いときの既定値)。
+ *
+ * 関数形: f(q) = c0 * q^{-1/2} + c1 + c2 * q + c3 * q^2 (q: 電荷 [pC])
+ *   t_corr   : Charge vs Mean の曲線の最小値 (ケーブル遅延・T0オフセット)
+ *   TW(q)    : Charge vs Mean の曲線 - t_corr (最小値が 0)。tw_max を上限とする
+ *   Sigma(q) : Charge vs RMS の曲線
+ * パラメータについて線形なので、重み付き最小二乗は正規方程式で閉じた形に解けます (FitTimeCurve)。
+ *
+ * 較正ファイル形式 (テキスト、'#' 以降はコメント):
+ *   CHごとに1行: ch t_corr tw_c0 tw_c1 tw_c2 tw_c3 tw_max sigma_c0 sigma_c1 sigma_c2 sigma_c3
+ */
+
+#ifndef TIME_CALIB_HH
+#define TIME_CALIB_HH
+
+#include "fittinginput.hh"
+#include <cmath>
+#include <string>
+#include <vector>
+
+const int N_TIME_CURVE_PARAMS = 4;
+
+/**
+ * @brief f(q) = c0 * q^{-1/2} + c1 + c2 * q + c3 * q^2 (q は 1e-3 pC で下限を取る)
+ */
+inline double TimeCurve(const double c[N_TIME_CURVE_PARAMS], double charge) {
+    double q = (charge > 1e-3) ? charge : 1e-3;
+    return c[0] / std::sqrt(q) + c[1] + c[2] * q + c[3] * q * q;
+}
+
+struct TimeCalibration {
+    double tCorr[4];
+    double tw[4][N_TIME_CURVE_PARAMS];
+    double twMax[4];
+    double sigma[4][N_TIME_CURVE_PARAMS];
+
+    /**
+     * @brief fittinginput.hh の値 (較正ファイルが無いときの既定値)
+     */
+    static TimeCalibration Defaults();
+
+    bool Load(const std::string& filename);
+    bool Save(const std::string& filename) const;
+
+    // TimeWalk補正 (上限 tw_max を適用)
+    double TimeWalk(int ch, double charge) const {
+        if (ch < 0 || ch >= 4) return 1.0;
+        double val = TimeCurve(tw[ch], charge);
+        return (val > twMax[ch]) ? twMax[ch] : val;
+    }
+    // 時間分解能 (下限はフィット側で適用)
+    double SigmaT(int ch, double charge) const {
+        if (ch < 0 || ch >= 4) return 1.0;
+        return TimeCurve(sigma[ch], charge);
+    }
+};
+
+/**
+ * @brief 再構成で使う時間較正
+ * 起動時 (フィットのスレッドを作る前) に SetTimeCalibration で置き換え、フィット中は読むだけにします。
+ */
+const TimeCalibration& GetTimeCalibration();
+void SetTimeCalibration(const TimeCalibration& calib);
+
+/**
+ * @brief 1本の曲線の重み付き最小二乗フィットの結果
+ */
+struct TimeCurveFit {
+    bool ok = false;
+    int nPoints = 0;
+    double c[N_TIME_CURVE_PARAMS] = {0, 0, 0, 0};
+    double cErr[N_TIME_CURVE_PARAMS] = {0, 0, 0, 0};
+    double cov[N_TIME_CURVE_PARAMS][N_TIME_CURVE_PARAMS] = {};
+    double chi2 = 0;
+    int ndf = 0;
+    double qMin = 0, qMax = 0;   // データの電荷の範囲
+    double minVal = 0;           // [~0, 1.1 * qMax] での最小値 (plot_summary の min_val と同じ範囲)
+    double minErr = 0;           // 最小値の誤差 (包絡線定理: 最小値の位置での ∂f/∂c の誤差伝播)
+    double atCharge = 0;         // 最小値の位置
+};
+
+/**
+ * @brief f(q) を重み付き最小二乗でフィットする
+ *
+ * 重みは 1/(y_err^2 + (f'(q) q_err)^2) (有効分散)。f' は前の解から求め、nIter 回解き直します
+ * (1回目は y_err のみ)。y_err <= 0 の点は使いません。
+ * 各回は 4x4 の正規方程式をコレスキー分解で解くだけなので、反復の最小化は行いません。
+ */
+TimeCurveFit FitTimeCurve(const std::vector<double>& q, const std::vector<double>& qErr,
+                          const std::vector<double>& y, const std::vector<double>& yErr, int nIter = 3);
+
+#endif // TIME_CALIB_HH
@@ -0,0 +1,53 @@
+/*
+ * id: workStealing.hh
+ * Place: /home/daiki/keio/hkelec/reconst/reco/
+ * Author: Gemini (Modified based on user request)
+ * Last Edit: 2026-10-18
+ *
+ * 概要:
+ * 小さなチャンク単位のワークスティーリング型タスクスケジューラ
+ * イベントごとのフィット時間は光源位置や MIGRAD の収束具合で 1 桁以上ばらつくため、
+ * イベント範囲を固定分割するとコアが遊んでしまいます。
+ * 各ワーカーは自分の両端キューの先頭からチャンクを取り、空になったら
+ * 他のワーカーのキューの末尾から盗みます。
+ */
+
+#ifndef WORK_STEALING_HH
+#define WORK_STEALING_HH
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+class WorkStealingScheduler {
+public:
+    explicit WorkStealingScheduler(int nWorkers);
+
+    int GetNWorkers() const { return fNWorkers; }
+
+    /**
+     * @brief チャンク 0..nChunks-1 を全ワーカーで処理し、全て終わるまで待つ
+     *
+     * 呼び出し元スレッドもワーカー 0 として働きます (nWorkers=1 ならスレッドを作りません)。
+     * 初期割り当ては連続範囲 (局所性のため)。以後の偏りはスティールで吸収します。
+     * @param task task(worker, chunk)。同じ worker 番号は同時に1スレッドからしか呼ばれません
+     * @param allowSteal false にすると固定範囲分割 (ベンチマークでの比較用)
+     * @return スティール回数の合計
+     */
+    long Run(int nChunks, const std::function<void(int worker, int chunk)>& task, bool allowSteal = true);
+
+private:
+    struct Queue {
+        std::mutex mtx;
+        std::deque<int> chunks;
+    };
+
+    int fNWorkers;
+    std::vector<Queue> fQueues;
+
+    bool PopLocal(int worker, int& chunk);
+    bool Steal(int thief, int& chunk);
+};
+
+#endif // WORK_STEALING_HH